@@ -50,6 +50,11 @@ function(compile_definitions)
   message(STATUS "Creating compile definitions...")
   add_compile_definitions(ASSET_PATH="${CMAKE_SOURCE_DIR}/../assets/")
   add_compile_definitions(CMAKE_SOURCE_PATH="${CMAKE_SOURCE_DIR}")
+
+  option(SHADER_ENGINE_PROFILING "Compile profiler zones into the engine" ON)
+  if (SHADER_ENGINE_PROFILING)
+    add_compile_definitions(SHADER_ENGINE_PROFILING)
+  endif()
   message(STATUS "Compile definitions created.")
 endfunction()
 
@@ -57,15 +62,31 @@ function(create_source_libraries)
   message(STATUS "Creating source libraries...")
 
   set(ENGINE_DIRS
+    src/Core/Engine/AssetStreamer
     src/Core/Engine/Camera
+    src/Core/Engine/ClusterCuller
+    src/Core/Engine/CommandLine
     src/Core/Engine/ElementBuffer
     src/Core/Engine/Engine
+    src/Core/Engine/FrameArena
+    src/Core/Engine/FramePacer
+    src/Core/Engine/GpuHeap
+    src/Core/Engine/InputRecorder
+    src/Core/Engine/JobSystem
     src/Core/Engine/Logger
     src/Core/Engine/Mesh
+    src/Core/Engine/MeshCache
+    src/Core/Engine/MeshOptimizer
     src/Core/Engine/Model
+    src/Core/Engine/ModelBatch
+    src/Core/Engine/OffscreenContext
     src/Core/Engine/Physics
+    src/Core/Engine/Profiler
+    src/Core/Engine/RenderThread
+    src/Core/Engine/Scene
     src/Core/Engine/Shader
     src/Core/Engine/Texture2D
+    src/Core/Engine/TextureRegistry
     src/Core/Engine/UI
     src/Core/Engine/VertexArray
     src/Core/Engine/VertexBuffer
@@ -86,6 +107,7 @@ function(create_executables)
   message(STATUS "Creating executables...")
 
   add_executable(ShaderExe "${CMAKE_SOURCE_DIR}/src/Core/main.cpp")
+  add_executable(ShaderBench "${CMAKE_SOURCE_DIR}/src/Core/bench.cpp")
 
   message(STATUS "Executabled created.")
 endfunction()
@@ -96,16 +118,33 @@ function(link_all)
   message(STATUS "Bullet include dirs: ${BULLET_INCLUDE_DIRS}")
   message(STATUS "Bullet libraries: ${BULLET_LIBRARIES}")
 
-  target_link_libraries(ShaderExe PUBLIC spdlog::spdlog SDL2::SDL2 Engine)
+  target_link_libraries(ShaderExe PUBLIC spdlog::spdlog SDL2::SDL2 Engine CommandLine)
+  target_link_libraries(ShaderBench PUBLIC spdlog::spdlog SDL2::SDL2 Engine CommandLine)
 
-  target_link_libraries(Engine PUBLIC SDL2::SDL2 glad UI Physics Logger)
+  target_link_libraries(Engine PUBLIC SDL2::SDL2 glad UI Physics Logger JobSystem RenderThread OffscreenContext FramePacer Profiler Scene InputRecorder FrameArena AssetStreamer GpuHeap ModelBatch TextureRegistry)
+  target_link_libraries(AssetStreamer PUBLIC glad glm::glm JobSystem Model Texture2D Profiler)
   target_link_libraries(Camera PUBLIC SDL2::SDL2 glad glm::glm)
+  target_link_libraries(ClusterCuller PUBLIC glm::glm Profiler)
+  target_link_libraries(CommandLine PUBLIC Engine Logger)
+  target_link_libraries(FrameArena PUBLIC Threads::Threads)
+  target_link_libraries(FramePacer PUBLIC SDL2::SDL2 Profiler)
+  target_link_libraries(GpuHeap PUBLIC glad Profiler)
   target_link_libraries(imgui PUBLIC SDL2::SDL2)
-  target_link_libraries(Mesh PUBLIC assimp::assimp glm::glm glad Shader )
-  target_link_libraries(Model PUBLIC glm::glm glad stb_image assimp::assimp Mesh)
+  target_link_libraries(InputRecorder PUBLIC SDL2::SDL2)
+  target_link_libraries(JobSystem PUBLIC Threads::Threads Profiler)
+  target_link_libraries(Mesh PUBLIC assimp::assimp glm::glm glad ClusterCuller ElementBuffer GpuHeap Shader Profiler)
+  target_link_libraries(MeshCache PUBLIC glm::glm Mesh Profiler)
+  target_link_libraries(MeshOptimizer PUBLIC glm::glm Mesh Profiler)
+  target_link_libraries(Model PUBLIC glm::glm glad assimp::assimp JobSystem Mesh MeshCache MeshOptimizer ModelBatch TextureRegistry Profiler)
+  target_link_libraries(ModelBatch PUBLIC glm::glm glad ElementBuffer Mesh Shader Profiler)
+  target_link_libraries(OffscreenContext PUBLIC glad)
+  target_link_libraries(Profiler PUBLIC glad Threads::Threads)
+  target_link_libraries(RenderThread PUBLIC SDL2::SDL2 glad imgui Threads::Threads Profiler Scene)
+  target_link_libraries(Scene PUBLIC glm::glm glad Camera Model Shader Physics Profiler AssetStreamer)
   target_link_libraries(Shader PUBLIC glad glm::glm)
-  target_link_libraries(Texture2D PUBLIC stb_image glad glm::glm)
-  target_link_libraries(UI PUBLIC SDL2::SDL2 glad imgui nfd)
+  target_link_libraries(Texture2D PUBLIC stb_image glad glm::glm TextureRegistry)
+  target_link_libraries(TextureRegistry PUBLIC stb_image glad Profiler)
+  target_link_libraries(UI PUBLIC SDL2::SDL2 glad imgui nfd Profiler FrameArena GpuHeap Model)
   target_link_libraries(VertexBuffer PUBLIC glad)
   target_link_libraries(VertexArray PUBLIC glad)
 
@@ -117,14 +156,17 @@ function(link_all)
 
   if (WIN32)
     target_link_libraries(Logger PUBLIC spdlog::spdlog_header_only)
+    target_link_libraries(FramePacer PRIVATE winmm)
+    target_link_libraries(ShaderBench PRIVATE psapi)
   endif()
 
   if (UNIX)
-    target_link_libraries(Physics PUBLIC BulletDynamics BulletCollision LinearMath)
+    target_link_libraries(Physics PUBLIC BulletDynamics BulletCollision LinearMath Profiler)
   elseif(WIN32)
     target_link_libraries(Physics PUBLIC
 	$<$<CONFIG:Debug>:BulletCollision BulletDynamics LinearMath>
         $<$<CONFIG:Release>:BulletCollision BulletDynamics LinearMath>
+        Profiler
     )
   endif()
 
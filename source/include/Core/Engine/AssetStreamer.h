@@ -0,0 +1,134 @@
+#pragma once
+#include "JobSystem.h"
+#include "Model.h"
+#include "Texture2D.h"
+#include "UploadBudget.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class AssetState { Loading, Uploading, Ready, Failed };
+
+// Handles stay valid until AssetStreamer::free(); 0 is never a valid id
+struct ModelHandle {
+  uint32_t id = 0;
+  bool isValid() const { return id != 0; }
+};
+
+struct TextureHandle {
+  uint32_t id = 0;
+  bool isValid() const { return id != 0; }
+};
+
+// How a streamed model is imported and kept, see the Model fields of the
+// same names. Loads of one path share a model only if these match
+struct ModelLoadSettings {
+  VertexLayout vertexLayout = VertexLayout::Float;
+  ImportProfile importProfile = ImportProfile::RuntimeOptimized;
+  GeometryResidency residency = GeometryResidency::GpuOnly;
+  bool mergeMeshes = false;
+};
+
+struct AssetStreamerStats {
+  int loading;
+  int uploading;
+  int ready;
+  int failed;
+  size_t lastFrameUploadBytes;
+  double lastFrameUploadMs;
+};
+
+// Loads models and textures in the background. load*() returns a handle
+// right away and queues the file on a small dedicated pool, kept apart from
+// the frame job system so long imports never end up on the main thread
+// while it helps with frame tasks. Decoded data is uploaded by update() on
+// the GL thread within a per-frame time and byte budget; until then the
+// getters hand out a placeholder cube and a checkerboard texture.
+class AssetStreamer {
+public:
+  static constexpr unsigned int DEFAULT_WORKER_COUNT = 2;
+
+  AssetStreamer();
+  ~AssetStreamer();
+
+  AssetStreamer(const AssetStreamer &) = delete;
+  AssetStreamer &operator=(const AssetStreamer &) = delete;
+
+  // Starts the workers, any thread. The placeholders are created by the
+  // first update(). A zero budget is unlimited
+  bool init(double budgetMs, double budgetMB,
+            unsigned int workerCount = DEFAULT_WORKER_COUNT);
+  // Needs the GL context, drops queued loads and waits for running ones
+  void free();
+  // Settings of models loaded without their own
+  void setModelSettings(const ModelLoadSettings &settings);
+
+  // Thread-safe; loading the same path twice returns the same handle
+  ModelHandle loadModel(const std::string &path);
+  ModelHandle loadModel(const std::string &path,
+                        const ModelLoadSettings &settings);
+  TextureHandle loadTexture(const std::string &path);
+
+  AssetState getState(ModelHandle handle) const;
+  AssetState getState(TextureHandle handle) const;
+  // The loaded model once ready, the placeholder cube until then or if
+  // loading failed
+  Model &getModel(ModelHandle handle);
+  // GL texture id once ready, the placeholder's otherwise
+  unsigned int getTexture(TextureHandle handle) const;
+
+  // GL thread, once per frame
+  void update();
+  // GL thread. Waits for every queued load, helping with it, then uploads
+  // all of them whatever the budget; false if any failed
+  bool flush();
+
+  AssetStreamerStats getStats() const;
+
+private:
+  struct ModelSlot {
+    std::string path;
+    Model model;
+    std::atomic<AssetState> state{AssetState::Loading};
+  };
+
+  struct TextureSlot {
+    std::string path;
+    Texture2D texture;
+    std::atomic<AssetState> state{AssetState::Loading};
+  };
+
+  JobSystem loadJobs;
+  // Every load job, for flush()
+  JobCounter loadCounter;
+  double budgetMs;
+  size_t budgetBytes;
+
+  mutable std::mutex slotMutex;
+  ModelLoadSettings modelSettings;
+  // unique_ptr keeps slots in place while the vectors grow
+  std::vector<std::unique_ptr<ModelSlot>> models;
+  std::vector<std::unique_ptr<TextureSlot>> textures;
+  // Keyed by path and settings, see getModelKey()
+  std::unordered_map<std::string, uint32_t> modelIds;
+  std::unordered_map<std::string, uint32_t> textureIds;
+  // Decoded and waiting for update(), oldest first
+  std::deque<ModelSlot *> modelUploads;
+  std::deque<TextureSlot *> textureUploads;
+
+  Model placeholderModel;
+  unsigned int placeholderTexture;
+
+  size_t lastFrameUploadBytes;
+  double lastFrameUploadMs;
+
+  ModelSlot *findModel(ModelHandle handle) const;
+  TextureSlot *findTexture(TextureHandle handle) const;
+  void upload(UploadBudget &budget);
+  void createPlaceholders();
+};
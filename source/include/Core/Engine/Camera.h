@@ -33,7 +33,12 @@ public:
 
   void processMouseMotion(SDL_Event &event);
 
-  void update();
+  // Without grabMouse the relative mouse mode is left alone, for replays
+  // and runs without a window
+  void update(bool grabMouse = true);
+
+  // Places the camera directly, used by scripted camera paths
+  void setPose(const glm::vec3 &position, float yaw, float pitch);
 
   float getFOV() const;
 
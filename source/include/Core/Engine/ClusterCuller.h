@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <type_traits>
+#include <vector>
+
+// A contiguous run of a mesh's index buffer, small enough to be culled on
+// its own. Bounds are in the mesh's model space
+struct Meshlet {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  glm::vec3 center;
+  float radius;
+  // Every triangle normal lies within the cone around coneAxis; coneCutoff
+  // is the sine of its half angle, NO_CONE when it cannot be backface culled
+  glm::vec3 coneAxis;
+  float coneCutoff;
+
+  static constexpr float NO_CONE = 2.0f;
+};
+
+static_assert(std::is_trivially_copyable<Meshlet>::value,
+              "Meshlets are stored raw in the mesh cache");
+
+// World-space frustum planes and eye position of the frame being drawn
+struct CullView {
+  glm::vec4 planes[6]; // xyz normal pointing inside, w distance
+  glm::vec3 position;
+  // Normal cones only hold while back faces are culled by GL as well
+  bool backfaces;
+
+  static CullView fromViewProjection(const glm::mat4 &viewProjection,
+                                     const glm::vec3 &position,
+                                     bool backfaces);
+};
+
+// Frustum and backface cone culling of a mesh's meshlets. Bounds are kept as
+// structure of arrays so four meshlets are tested at once with SSE, with a
+// scalar fallback elsewhere. Survivors next to each other in the index
+// buffer are merged into one range for glMultiDrawElements.
+class ClusterCuller {
+public:
+  ClusterCuller();
+
+  void build(const std::vector<Meshlet> &meshlets);
+  bool isEmpty() const;
+  size_t getMeshletCount() const;
+
+  // Fills counts and byte offsets of the visible index ranges, false if
+  // nothing is visible. indexStride is the size of one index in bytes,
+  // baseOffset where the mesh's indices start in the element buffer
+  bool cull(const glm::mat4 &model, const CullView &view, size_t indexStride,
+            size_t baseOffset = 0);
+  const std::vector<int> &getCounts() const;
+  const std::vector<const void *> &getOffsets() const;
+  // Meshlets that passed the last cull()
+  size_t getVisibleCount() const;
+
+private:
+  size_t meshletCount;
+  // Padded to a multiple of four with meshlets that never pass
+  std::vector<float> centerX, centerY, centerZ, radius;
+  std::vector<float> axisX, axisY, axisZ, cutoff;
+  std::vector<uint32_t> firstIndex, indexCount;
+
+  std::vector<int> counts;
+  std::vector<const void *> offsets;
+  size_t visibleCount;
+
+  void addRange(uint32_t first, uint32_t count, size_t indexStride,
+                size_t baseOffset, uint32_t &rangeEnd);
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include "Engine.h"
+#include <cstdio>
+
+enum class ArgumentResult {
+  Parsed,
+  // Not an engine flag, the caller may know it
+  Unknown,
+  // An engine flag with a bad value, already logged
+  Invalid
+};
+
+// Parses the EngineConfig flag at argv[i], shared by ShaderExe and
+// ShaderBench, and moves i past its value. Programs check their own flags
+// first and fall back to this
+ArgumentResult parseEngineArgument(int argc, char *argv[], int &i,
+                                   EngineConfig &config);
+// Help lines of every flag parseEngineArgument() knows
+void printEngineUsage(FILE *file);
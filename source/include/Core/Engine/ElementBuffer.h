@@ -1,12 +1,16 @@
 #pragma once
 #include <glad/glad.h>
+#include <cstddef>
+#include <vector>
 
 class ElementBuffer {
 private:
   unsigned int rendererID;
   unsigned int count;
+  GLenum type;
 
 public:
+  // Stores the indices in the smallest type that holds the largest of them
   ElementBuffer(const GLuint *data, GLuint pCount);
   ~ElementBuffer();
 
@@ -14,4 +18,12 @@ public:
   void Unbind() const;
 
   inline GLuint getCount() const;
+  // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for glDraw*
+  GLenum getType() const;
+
+  static GLenum chooseType(const GLuint *data, size_t count);
+  static size_t getTypeSize(GLenum type);
+  // Copies the indices narrowed to type, which must hold all of them
+  static std::vector<unsigned char> narrow(const GLuint *data, size_t count,
+                                           GLenum type);
 };
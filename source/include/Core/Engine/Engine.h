@@ -1,5 +1,94 @@
 #pragma once
+#include "AssetStreamer.h"
+#include "FramePacer.h"
+#include "InputRecorder.h"
+#include "JobSystem.h"
+#include "OffscreenContext.h"
+#include "Physics.h"
+#include "RenderThread.h"
+#include "Scene.h"
+#include "Shader.h"
+#include "TaskGraph.h"
 #include <SDL2/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class RunMode {
+  Windowed,
+  // No window or GL: physics and scene update only
+  HeadlessSimulation,
+  // Renders into an FBO through a window-less software-capable GL context
+  HeadlessOffscreen
+};
+
+struct EngineConfig {
+  RunMode runMode = RunMode::Windowed;
+  // Stops the game loop after this many frames, 0 runs until quit
+  int maxFrames = 0;
+  int width = 1600;
+  int height = 920;
+
+  // Submits GL work from a dedicated render thread that owns the context, so
+  // simulating frame N+1 overlaps submitting frame N
+  bool pipelinedRendering = false;
+
+  FramePacingMode pacingMode = FramePacingMode::VSync;
+  // 0 follows the display refresh rate where the mode needs a target
+  double targetFps = 0.0;
+
+  // Scene description to load, see Scene.h for the format
+  std::string scenePath;
+  // Steps the simulation by this many seconds per frame instead of the
+  // measured frame time, so scripted runs are reproducible. 0 disables it
+  float fixedDeltaTime = 0.0f;
+  // Physics tick rate and catch-up budget. Deterministic mode steps one
+  // tick per frame whatever the frame time, for performance comparisons
+  PhysicsStepSettings physicsStep = {true, 60.0f, 5, false};
+  // GL time and bytes per frame the asset streamer spends uploading scene
+  // models and other streamed assets, which draw as placeholders until
+  // then. Without either limit the scene is loaded before the first frame
+  double uploadBudgetMs = 0.0;
+  double uploadBudgetMB = 0.0;
+  // Size of the GpuHeap blocks mesh geometry is sub-allocated from, and the
+  // bytes compaction may move per frame, 0 turns it off
+  double gpuHeapBlockMB = 32.0;
+  double gpuHeapCompactMB = 1.0;
+  // GPU vertex format of imported and streamed models
+  VertexLayout vertexLayout = VertexLayout::Float;
+  // Assimp post-processing of imported and streamed models
+  ImportProfile importProfile = ImportProfile::RuntimeOptimized;
+  // CPU geometry scene models keep after upload, unless the scene sets it
+  GeometryResidency geometryResidency = GeometryResidency::GpuOnly;
+  // One vertex and index buffer per scene model, drawn with multi-draw
+  // indirect; needs GL 4.3
+  bool mergedDraws = false;
+  // Per-meshlet frustum culling, and GL backface culling together with the
+  // meshlet normal cone test
+  bool clusterCulling = true;
+  bool backfaceCulling = false;
+  // Screen-space error, in pixels, mesh LODs may show; 0 disables LODs
+  float lodPixelError = 1.0f;
+  // Keeps a FrameSample for every frame, for benchmark reports, and totals
+  // the profiler zones of every frame after the first statsWarmupFrames,
+  // see Profiler::getTotals()
+  bool collectFrameStats = false;
+  int statsWarmupFrames = 0;
+
+  // Input events and frame delta times are written to, or replayed from,
+  // this file. Replays stop the engine once the recording runs out
+  std::string recordInputPath;
+  std::string replayInputPath;
+};
+
+struct FrameSample {
+  double frameMs;  // start to start of consecutive frames, pacing included
+  double cpuMs;    // frame task graph execution
+  double updateMs; // physics and scene update tasks
+  double renderMs; // render task, GL submission on the main thread
+};
 
 class Engine {
   // Constructors & Destructors
@@ -23,32 +112,106 @@ public:
   int m_WindowWidth;
   int m_WindowHeight;
 
+  EngineConfig m_Config;
+  JobSystem m_JobSystem;
+  TaskGraph m_FrameGraph;
+  RenderThread m_RenderThread;
+  OffscreenContext m_OffscreenContext;
+  FramePacer m_FramePacer;
+  InputRecorder m_InputRecorder;
+  AssetStreamer m_AssetStreamer;
+  int m_FrameCount;
+
+  // Startup runs as a task graph so thread-safe work overlaps window and GL
+  // context creation on the main thread
+  TaskGraph m_StartupGraph;
+  std::atomic<bool> m_StartupFailed;
+  std::chrono::steady_clock::time_point m_StartupStart;
+  double m_TimeToFirstFrameMs;
+
+  Scene m_Scene;
+  std::unique_ptr<Shader> m_SceneShader;
+  SceneView m_SceneView;
+  float m_SceneTime;
+
+  std::vector<FrameSample> m_FrameSamples;
+  std::vector<double> m_GpuFrameSamples;
+  uint64_t m_LastGpuFrameIndex;
+
   // Class Public Methods
 public:
-  void run();
+  void run(const EngineConfig &config = EngineConfig());
+
+  JobSystem &getJobSystem();
+  // Subsystems may add tasks depending on these stages before run(). Update
+  // finishes the simulation: physics, the camera path and the scene models
+  TaskGraph &getFrameGraph();
+  TaskID getInputTask() const;
+  TaskID getUpdateTask() const;
+  TaskID getRenderTask() const;
+  const std::vector<TaskTiming> &getFrameTaskTimings() const;
+  // Timings of the startup steps, kept for the whole run
+  const std::vector<TaskTiming> &getStartupTimings() const;
+  // From run() until the first frame finished, 0 before that
+  double getTimeToFirstFrameMs() const;
+  Scene &getScene();
+  // Background model and texture loading, needs a GL run mode
+  AssetStreamer &getAssetStreamer();
+  const std::vector<FrameSample> &getFrameSamples() const;
+  // GPU time of each frame whose timestamp queries came back, in ms
+  const std::vector<double> &getGpuFrameSamples() const;
 
   // Class Private Methods
 private:
   // Initializers
   void initEverything();
+  void buildStartupGraph();
+  void logStartupTrace();
   bool initLoggers();
   void setOpenGLAttributes();
   bool initSDL();
   bool initWindow();
   bool initOpenGLContext();
+  bool initOffscreenContext();
+  bool initFramePacer();
+  bool initFrameArena();
   bool loadGLAD();
   bool initUI();
   bool initPhysics();
+  bool initJobSystem();
+  bool initRenderThread();
+  bool loadScene();
+  bool loadSceneShaderSource();
+  bool uploadScene();
+  bool initInputRecorder();
+  bool initAssetStreamer();
   void initGLViewPort();
 
   // Engine Loop
+  void buildFrameGraph();
   void gameLoop();
 
   void handleInput();
+  void processEvent(SDL_Event &event);
+  // The scene camera flies with the keyboard and mouse unless the scene
+  // scripts it
+  bool isSceneCameraControlled() const;
+  void updateCameraPath();
   void update();
+  // ImGui frame, built on the main thread while the simulation runs
+  void buildUI();
   void render();
 
   // Others
   void calculateDeltaTime();
+  void recordFrameSample(Uint64 frameStart);
   void free();
+
+private:
+  TaskID m_InputTask;
+  TaskID m_PhysicsTask;
+  TaskID m_CameraTask;
+  TaskID m_UpdateTask;
+  TaskID m_UITask;
+  TaskID m_RenderTask;
 };
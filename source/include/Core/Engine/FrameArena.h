@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct FrameArenaStats {
+  size_t capacity;
+  size_t lastFrameBytes;         // bump allocated during the last frame
+  size_t lastFrameOverflowBytes; // heap fallbacks during the last frame
+  size_t highWaterBytes;         // largest frame so far, overflow included
+  uint64_t overflowAllocations;  // heap fallbacks since init
+};
+
+// Bump allocator for data that lives until the end of the frame at most.
+// allocate() is lock-free and may be called from any frame graph task;
+// reset() releases everything at once and must run on the main thread after
+// the frame graph has finished. Requests that do not fit fall back to the
+// heap until the next reset and show up in the overflow stats, so the
+// capacity can be raised. Memory must not be handed to the render thread.
+class FrameArena {
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+  FrameArena(FrameArena &&) = delete;
+  FrameArena &operator=(FrameArena &&) = delete;
+
+  static FrameArena *getInstance();
+
+  bool init(size_t capacity = DEFAULT_CAPACITY);
+  void free();
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  void reset();
+
+  FrameArenaStats getStats() const;
+
+private:
+  FrameArena();
+
+  struct OverflowBlock {
+    void *memory;
+    size_t alignment;
+  };
+
+  char *buffer;
+  size_t capacity;
+  std::atomic<size_t> offset;
+
+  mutable std::mutex overflowMutex;
+  std::vector<OverflowBlock> overflowBlocks;
+  size_t overflowBytes;
+  uint64_t overflowAllocations;
+
+  size_t lastFrameBytes;
+  size_t lastFrameOverflowBytes;
+  size_t highWaterBytes;
+};
+
+// STL allocator drawing from the FrameArena; deallocation is a no-op since
+// the arena releases everything on reset
+template <typename T> class FrameAllocator {
+public:
+  using value_type = T;
+
+  FrameAllocator() noexcept = default;
+  template <typename U> FrameAllocator(const FrameAllocator<U> &) noexcept {}
+
+  T *allocate(size_t count) {
+    return static_cast<T *>(
+        FrameArena::getInstance()->allocate(count * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, size_t) noexcept {}
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T> &, const FrameAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T> &, const FrameAllocator<U> &) {
+  return false;
+}
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+using FrameString =
+    std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
@@ -0,0 +1,77 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <vector>
+
+enum class FramePacingMode {
+  // No swap interval, no waiting
+  Uncapped,
+  // No swap interval, waits at the end of the frame until the target time
+  Capped,
+  VSync,
+  // Late swaps tear instead of waiting a whole refresh, falls back to VSync
+  AdaptiveVSync,
+  // Waits before input is sampled so the frame starts as late as possible
+  // and finishes just in time for its deadline
+  LowLatency
+};
+
+struct FramePacingStats {
+  double targetMs;
+  double averageMs;
+  double jitterMs;           // standard deviation of frame times
+  double averageDeviationMs; // mean |frame time - target|
+  double worstDeviationMs;
+  int missedFrames;          // frames more than 1 ms over target
+  int sampleCount;
+};
+
+class FramePacer {
+public:
+  static constexpr int HISTORY_SIZE = 240;
+
+  FramePacer();
+  ~FramePacer();
+
+  FramePacer(const FramePacer &) = delete;
+  FramePacer &operator=(const FramePacer &) = delete;
+
+  // targetFps <= 0 means no explicit cap: the display refresh rate in the
+  // vsync and low-latency modes, nothing otherwise
+  void configure(FramePacingMode mode, double targetFps);
+  void setDisplayRefreshRate(int refreshRate);
+  // Needs the GL context current on the calling thread
+  void applySwapInterval();
+
+  void beginFrame();
+  void endFrame();
+
+  FramePacingMode getMode() const;
+  double getTargetMs() const;
+  FramePacingStats getStats() const;
+
+  static const char *getModeName(FramePacingMode mode);
+  static bool parseMode(const char *name, FramePacingMode &mode);
+
+private:
+  FramePacingMode mode;
+  double targetFps;
+  int displayRefreshRate;
+
+  double frequency;
+  Uint64 targetTicks;
+  Uint64 nextDeadline;
+  Uint64 frameBegin;
+  Uint64 lastFrameBegin;
+
+  // Exponential moving averages used to place the waits
+  double workEstimateMs;
+  double spinThresholdMs;
+
+  std::vector<double> frameTimes;
+  int historyIndex;
+  int historyCount;
+
+  void updateTargetTicks();
+  void waitUntil(Uint64 deadline);
+  double toMs(Uint64 ticks) const;
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Handle of a GpuHeap allocation, 0 is none
+using GpuAllocation = uint32_t;
+
+struct GpuHeapStats {
+  size_t blockCount;
+  size_t reservedBytes;    // GL buffer memory of all blocks
+  size_t usedBytes;        // held by allocations, alignment included
+  size_t allocationCount;
+  size_t freeRangeCount;   // gaps between allocations and block tails
+  size_t largestFreeBytes; // largest allocation that fits without a block
+  size_t movedBytes;       // copied by compact() since init
+};
+
+// Engine-wide geometry memory. A few large GL buffers, the blocks, are
+// split by a first-fit free list with neighbouring free ranges merged, so
+// meshes share a handful of buffer objects instead of creating their own.
+// compact() slides allocations down over the gaps in front of them a
+// budget at a time, so allocations move: holders look getOffset() up again
+// before drawing. GL thread only, except getStats().
+class GpuHeap {
+public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 32 * 1024 * 1024;
+  // Offsets stay aligned to this, enough for vertex attributes and every
+  // index type
+  static constexpr size_t ALIGNMENT = 16;
+
+  GpuHeap(const GpuHeap &) = delete;
+  GpuHeap &operator=(const GpuHeap &) = delete;
+
+  static GpuHeap *getInstance();
+
+  // Size of blocks created from now on; larger allocations get a block of
+  // their own
+  void setBlockSize(size_t bytes);
+  // Copies size bytes of data into the heap, data may be null to fill it
+  // later. 0 when size is 0
+  GpuAllocation allocate(const void *data, size_t size);
+  void release(GpuAllocation allocation);
+  // Overwrites size bytes at offset within the allocation
+  void update(GpuAllocation allocation, size_t offset, const void *data,
+              size_t size);
+  // Block buffer and byte offset within it, 0 for released allocations
+  unsigned int getBuffer(GpuAllocation allocation) const;
+  size_t getOffset(GpuAllocation allocation) const;
+
+  // Moves allocations until maxBytes were copied or every block is packed,
+  // then deletes empty blocks but one; call once a frame, 0 skips it
+  void compact(size_t maxBytes);
+  GpuHeapStats getStats() const;
+  // Deletes every block, allocations still held become invalid
+  void free();
+
+private:
+  struct Block {
+    unsigned int buffer;
+    size_t size;
+    size_t usedBytes;
+    // Offset to size of the free ranges, never adjacent to each other
+    std::map<size_t, size_t> freeRanges;
+    // Offset to the allocation starting there
+    std::map<size_t, GpuAllocation> allocations;
+  };
+
+  struct Slot {
+    size_t block;
+    size_t offset;
+    size_t size;
+    bool live;
+  };
+
+  size_t blockSize;
+  // Deleted blocks keep their place with a 0 buffer, so slots keep their
+  // block index
+  std::vector<Block> blocks;
+  std::vector<Slot> slots;
+  std::vector<GpuAllocation> freeSlots;
+  // Staging for moves whose source and destination overlap
+  unsigned int scratchBuffer;
+  size_t scratchSize;
+  size_t movedBytes;
+
+  // Copy of the stats for other threads, refreshed after every change
+  mutable std::mutex statsMutex;
+  GpuHeapStats stats;
+
+  GpuHeap();
+
+  const Slot *findSlot(GpuAllocation allocation) const;
+  size_t createBlock(size_t size);
+  void deleteBlock(Block &block);
+  void insertFreeRange(Block &block, size_t offset, size_t size);
+  void move(Block &block, Slot &slot, size_t offset);
+  void publishStats();
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include "Profiler.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct GpuPassTiming {
+  const char *name;
+  double startMs; // relative to the first pass of the frame
+  double durationMs;
+  uint32_t depth;
+};
+
+struct GpuFrameTiming {
+  uint64_t frameIndex;
+  double totalMs;
+  std::vector<GpuPassTiming> passes;
+};
+
+// Times GL passes with GL_TIMESTAMP queries. Queries rotate through a ring
+// of FRAME_LATENCY frames and are read back that many frames later, only
+// once GL_QUERY_RESULT_AVAILABLE says so, so reading never stalls the
+// pipeline. All methods except getLatestFrame() must run on the thread that
+// owns the GL context.
+class GpuProfiler {
+public:
+  static constexpr int FRAME_LATENCY = 4;
+  static constexpr int MAX_PASSES = 32;
+
+  GpuProfiler(const GpuProfiler &) = delete;
+  GpuProfiler &operator=(const GpuProfiler &) = delete;
+  GpuProfiler(GpuProfiler &&) = delete;
+  GpuProfiler &operator=(GpuProfiler &&) = delete;
+
+  static GpuProfiler *getInstance();
+
+  bool init();
+  void free();
+  bool isAvailable() const;
+
+  void beginFrame();
+  void endFrame();
+  void beginPass(const char *name);
+  void endPass();
+
+  // Thread-safe copy of the most recent frame whose results came back
+  GpuFrameTiming getLatestFrame() const;
+  // Frames whose queries were still pending when their slot was reused
+  uint64_t getSkippedFrameCount() const;
+
+private:
+  GpuProfiler();
+
+  struct Pass {
+    const char *name;
+    unsigned int beginQuery;
+    unsigned int endQuery;
+    uint32_t depth;
+  };
+
+  struct FrameSlot {
+    std::array<Pass, MAX_PASSES> passes;
+    int passCount = 0;
+    bool pending = false;
+    uint64_t frameIndex = 0;
+    // Last query issued this frame, results come back in issue order
+    unsigned int lastQuery = 0;
+    // CPU minus GPU clock when the frame was recorded, in nanoseconds
+    int64_t clockOffsetNs = 0;
+  };
+
+  std::array<FrameSlot, FRAME_LATENCY> slots;
+  std::vector<unsigned int> queries;
+  bool available;
+  bool frameOpen;
+  uint64_t frameIndex;
+  std::atomic<uint64_t> skippedFrames;
+
+  std::array<int, MAX_PASSES> passStack;
+  int passStackSize;
+  // Passes past MAX_PASSES are ignored along with everything nested inside
+  int overflowDepth;
+
+  mutable std::mutex latestMutex;
+  GpuFrameTiming latestFrame;
+
+  void collect(FrameSlot &slot);
+};
+
+class GpuProfileScope {
+public:
+  explicit GpuProfileScope(const char *name) {
+    GpuProfiler::getInstance()->beginPass(name);
+  }
+  ~GpuProfileScope() { GpuProfiler::getInstance()->endPass(); }
+
+  GpuProfileScope(const GpuProfileScope &) = delete;
+  GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+};
+
+#ifdef SHADER_ENGINE_PROFILING
+#define GPU_PROFILE_SCOPE(name)                                                \
+  GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define GPU_PROFILE_FRAME_BEGIN() GpuProfiler::getInstance()->beginFrame()
+#define GPU_PROFILE_FRAME_END() GpuProfiler::getInstance()->endFrame()
+#else
+#define GPU_PROFILE_SCOPE(name) ((void)0)
+#define GPU_PROFILE_FRAME_BEGIN() ((void)0)
+#define GPU_PROFILE_FRAME_END() ((void)0)
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class InputRecorderMode { Off, Record, Replay };
+
+// Records the input events and delta time of every frame into a compact
+// binary file, and feeds them back frame by frame so a session replays
+// exactly. Only input events (keyboard, text, mouse, quit) are kept; window
+// events always come from the live window.
+//
+// File layout, host byte order:
+//   header: "SEIR", uint32 version, uint32 scene path length, scene path
+//   frame:  float deltaTime, uint16 event count, events
+//   event:  uint32 type, uint32 timestamp, type specific payload
+class InputRecorder {
+public:
+  static constexpr uint32_t VERSION = 1;
+
+  InputRecorder();
+  ~InputRecorder();
+
+  InputRecorder(const InputRecorder &) = delete;
+  InputRecorder &operator=(const InputRecorder &) = delete;
+
+  // The scene path is stored so replays can warn when the scene differs
+  bool startRecording(const std::string &path, const std::string &scenePath);
+  bool startReplay(const std::string &path, const std::string &scenePath);
+  void stop();
+
+  InputRecorderMode getMode() const;
+  uint64_t getFrameCount() const;
+
+  // Recording: events are buffered until the frame is written
+  void recordEvent(const SDL_Event &event);
+  void recordFrame(float deltaTime);
+
+  // Replay: loads the next frame, false once the recording is exhausted
+  bool nextFrame();
+  std::vector<SDL_Event> &getFrameEvents();
+  float getFrameDeltaTime() const;
+  // Replayed events are addressed to this window
+  void setWindowID(Uint32 windowID);
+
+  // Keyboard, text, mouse and quit events, the ones that are recorded
+  static bool isInputEvent(const SDL_Event &event);
+
+private:
+  InputRecorderMode mode;
+  std::string path;
+  std::ofstream output;
+  std::ifstream input;
+
+  std::vector<SDL_Event> frameEvents;
+  float frameDeltaTime;
+  uint64_t frameCount;
+  Uint32 windowID;
+
+  void writeEvent(const SDL_Event &event);
+  bool readEvent(SDL_Event &event);
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Job = std::function<void()>;
+
+// Tracks a group of submitted jobs; JobSystem::wait() blocks until it drains
+struct JobCounter {
+  std::atomic<int> pending{0};
+};
+
+class JobSystem {
+public:
+  JobSystem();
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+  JobSystem(JobSystem &&) = delete;
+  JobSystem &operator=(JobSystem &&) = delete;
+
+  // workerCount = 0 picks hardware_concurrency - 1, leaving a core for the
+  // calling (main) thread, which also executes jobs while it waits. Workers
+  // are named "<name> <index>" in the profiler
+  bool init(unsigned int workerCount = 0,
+            const std::string &name = "Worker");
+  void free();
+
+  void submit(Job job, JobCounter *counter = nullptr);
+  void wait(const JobCounter &counter);
+  void parallelFor(size_t count, size_t grainSize,
+                   const std::function<void(size_t begin, size_t end)> &fn);
+
+  // Runs one queued job on the calling thread, returns false if none found
+  bool runPendingJob();
+
+  unsigned int getWorkerCount() const;
+  // Index of the worker running the calling thread in whichever job system
+  // owns it, -1 for non-workers
+  static int getCurrentWorkerIndex();
+
+private:
+  struct QueuedJob {
+    Job job;
+    JobCounter *counter;
+  };
+
+  // Owner pushes and pops at the back, thieves steal from the front
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<QueuedJob> jobs;
+  };
+
+  // One queue per worker plus a trailing injection queue for non-worker
+  // threads
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::vector<std::thread> workers;
+  std::vector<std::string> workerNames;
+  std::atomic<bool> running;
+  std::atomic<int> queuedJobs;
+
+  std::mutex sleepMutex;
+  std::condition_variable sleepCondition;
+
+  // Calling thread's worker index in this job system, -1 otherwise
+  int getLocalWorkerIndex() const;
+  void workerLoop(unsigned int index);
+  bool popLocal(unsigned int index, QueuedJob &out);
+  bool steal(unsigned int thief, QueuedJob &out);
+  bool findJob(int index, QueuedJob &out);
+  void execute(QueuedJob &queuedJob);
+};
@@ -3,20 +3,35 @@
 #include <spdlog/spdlog.h>
 
 namespace Logger {
+extern std::shared_ptr<spdlog::logger> assetStreamer;
 extern std::shared_ptr<spdlog::logger> camera;
 extern std::shared_ptr<spdlog::logger> elementBuffer;
 extern std::shared_ptr<spdlog::logger> engine;
+extern std::shared_ptr<spdlog::logger> frameArena;
+extern std::shared_ptr<spdlog::logger> framePacer;
+extern std::shared_ptr<spdlog::logger> gpuHeap;
+extern std::shared_ptr<spdlog::logger> inputRecorder;
+extern std::shared_ptr<spdlog::logger> jobSystem;
 extern std::shared_ptr<spdlog::logger> logger;
 extern std::shared_ptr<spdlog::logger> mesh;
+extern std::shared_ptr<spdlog::logger> meshCache;
 extern std::shared_ptr<spdlog::logger> model;
+extern std::shared_ptr<spdlog::logger> modelBatch;
+extern std::shared_ptr<spdlog::logger> offscreenContext;
 extern std::shared_ptr<spdlog::logger> physics;
+extern std::shared_ptr<spdlog::logger> profiler;
+extern std::shared_ptr<spdlog::logger> renderThread;
 extern std::shared_ptr<spdlog::logger> rigidBody;
+extern std::shared_ptr<spdlog::logger> scene;
 extern std::shared_ptr<spdlog::logger> shader;
 extern std::shared_ptr<spdlog::logger> texture2D;
+extern std::shared_ptr<spdlog::logger> textureRegistry;
 extern std::shared_ptr<spdlog::logger> ui;
 extern std::shared_ptr<spdlog::logger> vertexArray;
 extern std::shared_ptr<spdlog::logger> vertexBuffer;
 
-void init();
+// Logs go to stderr instead of stdout when toStderr is set, such as for
+// tools that print their results on stdout
+void init(bool toStderr = false);
 void free();
 }; // namespace Logger
@@ -1,7 +1,13 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
+#include "ClusterCuller.h"
+#include "GpuHeap.h"
 #include "Shader.h"
 
 struct Vertex {
@@ -12,27 +18,181 @@ struct Vertex {
   glm::vec3 Bitangent;
 };
 
+// GPU vertex format of a mesh. The compact layouts store normals and
+// tangents octahedron-encoded in two snorm16 each, with the bitangent sign
+// folded into the tangent's second component, and texture coordinates as
+// half floats. The quantized layout also stores positions as unorm16 within
+// the mesh bounds, undone by the mesh's positionOffset and positionScale.
+enum class VertexLayout {
+  Float,           // Vertex, 56 bytes
+  Compact,         // CompactVertex, 24 bytes
+  CompactQuantized // QuantizedVertex, 20 bytes
+};
+
+struct CompactVertex {
+  float Position[3];
+  int16_t Normal[2];
+  int16_t Tangent[2];
+  uint16_t TexCoords[2];
+};
+
+struct QuantizedVertex {
+  uint16_t Position[4]; // w is padding, attributes stay 4-byte aligned
+  int16_t Normal[2];
+  int16_t Tangent[2];
+  uint16_t TexCoords[2];
+};
+
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex must be packed");
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must be packed");
+
+// Index range of one detail level, drawn with the mesh's vertices
+struct MeshLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Quadric error estimate of how far the level strays from the full mesh,
+  // in model units, see MeshOptimizer::simplify(); not a strict bound
+  float error;
+};
+
+static_assert(std::is_trivially_copyable<MeshLod>::value,
+              "MeshLods are stored raw in the mesh cache");
+
+// Camera state detail levels are picked from
+struct LodView {
+  glm::vec3 position;
+  // Pixels covered by one unit at distance 1, the viewport height over
+  // 2 tan(fov / 2)
+  float pixelScale;
+  // Largest error a level may show on screen, in pixels
+  float maxPixelError;
+};
+
+class SharedTexture;
+
 struct Texture {
   unsigned int id;
   std::string type;
   std::string path;
+  // Keeps the image in the TextureRegistry, null for textures made
+  // elsewhere
+  std::shared_ptr<SharedTexture> shared;
 };
 
+// Move-only, it owns its VAO and GpuHeap allocations and frees them when
+// destroyed, so a mesh must go before the GL context does
 class Mesh {
 public:
   std::vector<Vertex> vertices;
   std::vector<unsigned int> indices;
   std::vector<Texture> textures;
   glm::mat4 transform;
+  // Set before pack() or upload(). Quantized positions decode as
+  // positionOffset + position * positionScale
+  VertexLayout vertexLayout;
+  glm::vec3 positionOffset;
+  glm::vec3 positionScale;
+  // vertices encoded in vertexLayout, empty for the float layout and again
+  // once uploaded
+  std::vector<unsigned char> packedVertices;
+  // Culling clusters covering the first detail level, empty to always draw
+  // the whole level
+  std::vector<Meshlet> meshlets;
+  // Detail levels stored one after another in indices, finest first; empty
+  // when indices only hold the full mesh
+  std::vector<MeshLod> lods;
+  // Bounding sphere in model space, for picking detail levels
+  glm::vec3 boundsCenter;
+  float boundsRadius;
+  // Empty mesh filled in by an importer, GL objects come with upload()
+  Mesh();
   Mesh(std::vector<Vertex> verts, std::vector<unsigned int> inds,
        std::vector<Texture> texs);
+  ~Mesh();
+  Mesh(const Mesh &) = delete;
+  Mesh &operator=(const Mesh &) = delete;
+  Mesh(Mesh &&other) noexcept;
+  Mesh &operator=(Mesh &&other) noexcept;
+  // Encodes vertices into packedVertices, needs no GL so importers run it on
+  // their workers
+  void pack();
+  // Decodes vertexCount vertices in vertexLayout, such as a mapped mesh
+  // cache's, into vertices; the inverse of pack() within its precision
+  void unpack(const void *vertexData, size_t vertexCount);
+  // Copies the geometry into the GpuHeap and creates the VAO, needs the GL
+  // context. Packs first if that has not happened yet
+  void upload();
+  // Uploads from memory the mesh does not own, such as a mapped mesh cache,
+  // already in vertexLayout; vertices and indices are left as they are
+  void upload(const void *vertexData, size_t vertexCount,
+              const unsigned int *indexData, size_t indexCount);
+  // Marks the mesh uploaded into buffers it does not own, such as a
+  // ModelBatch's; Draw() then skips it. indexType is the buffer's
+  void attach(unsigned int indexType, size_t indexCount);
+  bool isUploaded() const;
+  // Deletes the VAO and releases the heap memory, needs the GL context. The
+  // CPU data stays, so the mesh can be uploaded again
+  void free();
+  // Frees vertices and indices, for uploaded meshes nobody reads back
+  void releaseGeometry();
+  size_t getVertexStride() const;
+  // Bytes per index on the GPU, known once uploaded
+  size_t getIndexStride() const;
+  // With a cull view, only meshlets that survive culling are drawn. With a
+  // LOD view, the coarsest level within its pixel error is drawn instead of
+  // the full mesh; meshlets are only culled at full detail
   void Draw(Shader &shader, const glm::mat4 &transform,
-            const glm::vec3 &ambient, const float &shininess);
+            const glm::vec3 &ambient, const float &shininess,
+            const CullView *cullView = nullptr,
+            const LodView *lodView = nullptr);
+  // Detail level picked by the last Draw()
+  size_t getCurrentLod() const;
+  // What Draw() draws with this model matrix, false when culled. Clustered
+  // draws take the ranges left in getClusterCuller(), as byte offsets into
+  // the heap block; others drawCount indices from the mesh's firstIndex
+  bool selectDraw(const glm::mat4 &model, const CullView *cullView,
+                  const LodView *lodView, bool &clustered, size_t &firstIndex,
+                  size_t &drawCount);
+  const ClusterCuller &getClusterCuller() const;
+  void bindTextures(Shader &shader) const;
 
-  // Optionally remove this, only used for soft body physics
+  // Optionally remove this, only used for soft body physics. Float layout
+  // only
   void updateVertices(const std::vector<float> &newVertices);
 
+  static size_t getVertexStride(VertexLayout layout);
+  // Points the attributes of the bound VAO at the bound array buffer, with
+  // the first vertex at baseOffset bytes
+  static void setupAttributes(VertexLayout layout, size_t baseOffset = 0);
+  static const char *getLayoutName(VertexLayout layout);
+  static bool parseLayout(const char *name, VertexLayout &layout);
+
 private:
-  unsigned int vao, vbo, ebo;
-  void setupMesh();
+  unsigned int vao;
+  GpuAllocation vertexAllocation, indexAllocation;
+  // Where the VAO's attributes point, compared against the heap on draw
+  // since compaction moves allocations
+  size_t vertexOffset;
+  size_t indexCount;
+  // Smallest GL index type holding every index, picked on upload
+  unsigned int indexType;
+  bool uploaded;
+  ClusterCuller clusterCuller;
+  size_t currentLod;
+  // "material.<type><n>" sampler name of each texture, built once instead of
+  // on every draw
+  std::vector<std::string> textureUniforms;
+  void setupMesh(const void *vertexData, size_t vertexCount,
+                 const unsigned int *indexData, size_t indexCount);
+  // Binds the heap blocks to the bound VAO and points its attributes at
+  // the vertices' current offset
+  void bindGeometry();
+  static void setupCompactAttributes(unsigned int positionType,
+                                     unsigned char positionNormalized,
+                                     size_t stride, size_t baseOffset,
+                                     size_t normalOffset,
+                                     size_t texCoordsOffset,
+                                     size_t tangentOffset);
+  void setupTextureUniforms();
+  size_t selectLod(const glm::mat4 &model, const LodView &view);
 };
@@ -0,0 +1,97 @@
+#pragma once
+#include "Mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+struct MeshCacheTexture {
+  std::string type;
+  std::string path;
+  // Compressed bytes of an embedded ('*n') texture, null for external files
+  const unsigned char *data;
+  size_t size;
+};
+
+struct MeshCacheMesh {
+  glm::mat4 transform;
+  // In the cache's vertex layout
+  const void *vertices;
+  uint32_t vertexCount;
+  glm::vec3 positionOffset;
+  glm::vec3 positionScale;
+  const unsigned int *indices;
+  uint32_t indexCount;
+  const Meshlet *meshlets;
+  uint32_t meshletCount;
+  const MeshLod *lods;
+  uint32_t lodCount;
+  glm::vec3 boundsCenter;
+  float boundsRadius;
+  // Indices into the cache's texture table
+  std::vector<uint32_t> textures;
+};
+
+// Cooked model written after the first Assimp import and memory-mapped on
+// later loads. Vertex and index blobs are stored exactly as uploaded, so
+// meshes go to the GPU straight from the mapped pages. A cache is stale once
+// the source hash, import flags, vertex layout or mesh optimizer flags
+// differ.
+//
+// File layout, host byte order, offsets from the start of the file:
+//   header:   "SEMC", uint32 version, uint64 source hash, uint32 import
+//             flags, uint32 vertex stride, uint32 mesh count, uint32
+//             texture count, uint32 texture reference count, uint32
+//             VertexLayout, uint32 MeshOptimizer flags
+//   meshes:   float[16] transform, uint64 vertex offset, uint64 index
+//             offset, uint32 vertex count, uint32 index count, uint32 first
+//             texture reference, uint32 texture reference count, float[3]
+//             position offset, float[3] position scale, uint64 meshlet
+//             offset, uint32 meshlet count, uint32 LOD count, uint64 LOD
+//             offset, float[3] bounds centre, float bounds radius
+//   textures: uint64 string offset, uint32 type length, uint32 path length,
+//             uint64 embedded data offset, uint64 embedded data size
+//   uint32 texture references, then strings, embedded textures, Meshlets,
+//   MeshLods, vertices and indices
+class MeshCache {
+public:
+  static constexpr uint32_t VERSION = 5;
+
+  MeshCache();
+  ~MeshCache();
+
+  MeshCache(const MeshCache &) = delete;
+  MeshCache &operator=(const MeshCache &) = delete;
+
+  // Cache file belonging to a source model
+  static std::string getCachePath(const std::string &sourcePath);
+  static bool hashFile(const std::string &path, uint64_t &hash);
+  static bool write(const std::string &path, uint64_t sourceHash,
+                    uint32_t importFlags, VertexLayout vertexLayout,
+                    uint32_t optimizeFlags,
+                    const std::vector<MeshCacheTexture> &textures,
+                    const std::vector<MeshCacheMesh> &meshes);
+
+  // Maps the cache, false if it is missing, malformed or stale
+  bool open(const std::string &path, uint64_t sourceHash,
+            uint32_t importFlags, VertexLayout vertexLayout,
+            uint32_t optimizeFlags);
+  void close();
+  bool isOpen() const;
+
+  size_t getMeshCount() const;
+  MeshCacheMesh getMesh(size_t index) const;
+  size_t getTextureCount() const;
+  MeshCacheTexture getTexture(size_t index) const;
+
+private:
+  const unsigned char *data;
+  size_t size;
+#ifdef _WIN32
+  void *file;
+  void *mapping;
+#endif
+
+  bool validate() const;
+};
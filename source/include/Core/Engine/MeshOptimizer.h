@@ -0,0 +1,113 @@
+#pragma once
+#include "Mesh.h"
+#include <cstddef>
+#include <vector>
+
+// Post-transform cache behaviour of an index buffer, simulated with a FIFO
+// cache. ACMR is transformed vertices per triangle (0.5 at best, 3 at
+// worst), ATVR transformed vertices per referenced vertex (1 at best)
+struct VertexCacheStats {
+  size_t transformedVertices = 0;
+  size_t triangles = 0;
+  size_t vertices = 0;
+
+  float getAcmr() const;
+  float getAtvr() const;
+  VertexCacheStats &operator+=(const VertexCacheStats &other);
+};
+
+struct MeshPart {
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+};
+
+// Import-time reordering of triangle lists for the GPU. Everything is plain
+// CPU work on a single mesh, safe to run on import workers.
+class MeshOptimizer {
+public:
+  enum Flags : unsigned int {
+    // Tipsify triangle order for the post-transform cache
+    VertexCache = 1 << 0,
+    // Draws outward-facing clusters of the cache order first, so they
+    // occlude the rest; needs VertexCache
+    Overdraw = 1 << 1,
+    // Renumbers vertices in first-use order for fetch locality
+    VertexFetch = 1 << 2,
+    // Splits meshes too large for 16-bit indices, see splitForShortIndices()
+    ShortIndices = 1 << 3,
+    // Builds culling meshlets, see buildMeshlets()
+    Meshlets = 1 << 4,
+    // Appends simplified detail levels, see buildLods()
+    Lods = 1 << 5,
+    All = VertexCache | Overdraw | VertexFetch | ShortIndices | Meshlets |
+          Lods
+  };
+
+  static constexpr unsigned int CACHE_SIZE = 16;
+  // Vertices addressable with 16-bit indices
+  static constexpr size_t SHORT_INDEX_VERTICES = 65536;
+  static constexpr size_t MESHLET_VERTICES = 64;
+  static constexpr size_t MESHLET_TRIANGLES = 126;
+  // Detail levels including the full mesh; each aims for half the triangles
+  // of the one before
+  static constexpr size_t MAX_LODS = 4;
+  static constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+  // Runs the passes in flags in order. The vertex count never changes,
+  // unreferenced vertices move to the end
+  static void optimize(std::vector<Vertex> &vertices,
+                       std::vector<unsigned int> &indices, unsigned int flags);
+
+  // clusters, when given, receives the first index of every cluster, split
+  // wherever the order had to jump to an unrelated part of the mesh
+  static void optimizeVertexCache(std::vector<unsigned int> &indices,
+                                  size_t vertexCount,
+                                  std::vector<size_t> *clusters = nullptr);
+  static void optimizeOverdraw(std::vector<unsigned int> &indices,
+                               const std::vector<Vertex> &vertices,
+                               const std::vector<size_t> &clusters);
+  static void optimizeVertexFetch(std::vector<Vertex> &vertices,
+                                  std::vector<unsigned int> &indices);
+
+  // Cuts a mesh into parts of at most maxVertices vertices, following the
+  // triangle order so each part keeps its cache locality. Vertices on a cut
+  // are duplicated. Empty if the mesh already fits
+  static std::vector<MeshPart>
+  splitForShortIndices(const std::vector<Vertex> &vertices,
+                       const std::vector<unsigned int> &indices,
+                       size_t maxVertices = SHORT_INDEX_VERTICES);
+
+  // Cuts the triangle order into runs of at most maxVertices distinct
+  // vertices and maxTriangles triangles, so each meshlet is a contiguous
+  // index range; run after the cache passes to keep them compact
+  static std::vector<Meshlet>
+  buildMeshlets(const std::vector<Vertex> &vertices,
+                const std::vector<unsigned int> &indices,
+                size_t maxVertices = MESHLET_VERTICES,
+                size_t maxTriangles = MESHLET_TRIANGLES);
+
+  // Quadric error edge collapse (Garland and Heckbert) towards
+  // targetIndexCount, keeping the vertices: collapses move a vertex onto a
+  // neighbour, so the result indexes the same vertex buffer. Vertices on
+  // borders and attribute seams stay put. error receives the square root
+  // of the largest collapse cost, in model units: the root mean square of a
+  // vertex's distances to its original planes, area-weighted. It estimates
+  // how far the surface moved, it does not bound the largest distance
+  static std::vector<unsigned int>
+  simplify(const std::vector<Vertex> &vertices,
+           const std::vector<unsigned int> &indices, size_t targetIndexCount,
+           float &error);
+  // Appends up to maxLods - 1 simplified copies of the triangles to indices
+  // and returns the ranges, the full mesh first. Empty when the mesh is too
+  // small or will not simplify. Run after buildMeshlets(), which covers all
+  // of indices
+  static std::vector<MeshLod> buildLods(const std::vector<Vertex> &vertices,
+                                        std::vector<unsigned int> &indices,
+                                        size_t maxLods = MAX_LODS);
+  static void computeBounds(const std::vector<Vertex> &vertices,
+                            glm::vec3 &center, float &radius);
+
+  static VertexCacheStats
+  analyzeVertexCache(const std::vector<unsigned int> &indices,
+                     size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+};
@@ -3,8 +3,11 @@
 #include <glad/glad.h>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <glm/gtc/matrix_transform.hpp>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -12,7 +15,62 @@
 #include <assimp/scene.h>
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "ModelBatch.h"
 #include "Shader.h"
+#include "UploadBudget.h"
+
+class JobSystem;
+struct JobCounter;
+class MeshCache;
+
+// Assimp post-processing of imported models. Both weld identical vertices,
+// which Assimp otherwise leaves one per face corner
+enum class ImportProfile {
+  // Keeps meshes, materials and the node graph as authored, for quick
+  // iteration on assets
+  EditorFast,
+  // Also drops duplicate materials, merges meshes sharing a material and
+  // collapses the node graph, for fewer and larger draws
+  RuntimeOptimized
+};
+
+// CPU copies of its geometry a model keeps once its meshes are on the GPU
+enum class GeometryResidency {
+  // Frees every CPU copy after upload
+  GpuOnly,
+  // Keeps Model::collisionPositions and collisionIndices. Nothing in the
+  // engine reads them; callers build their own collision shapes from them
+  GpuAndPositions,
+  // Keeps Mesh::vertices and Mesh::indices, and fills flatVertices and
+  // flatIndices for soft bodies
+  Full
+};
+
+// Geometry bytes of a model, see Model::getGeometryMemory()
+struct GeometryMemory {
+  size_t gpuBytes = 0;
+  size_t cpuBytes = 0;
+  // CPU copies the residency policy freed after upload
+  size_t releasedBytes = 0;
+
+  GeometryMemory &operator+=(const GeometryMemory &other);
+};
+
+// What Model::Draw() submitted, see Model::getDrawStats()
+struct DrawStats {
+  size_t meshes = 0;
+  // Meshes drawn at each level, 0 is full detail
+  size_t lodMeshes[MeshOptimizer::MAX_LODS] = {};
+  // Meshlets of full-detail meshes the cluster culler tested and kept
+  size_t meshlets = 0;
+  size_t visibleMeshlets = 0;
+  // Meshes in the ModelBatch and its materials, one multi-draw each
+  size_t batchedMeshes = 0;
+  size_t batchMaterials = 0;
+
+  DrawStats &operator+=(const DrawStats &other);
+};
 
 class Model {
 public:
@@ -20,31 +78,134 @@ public:
   std::vector<Mesh> meshes;
   std::string directory;
 
-  // Optionally remove this two, only used for soft body physics
+  // Optionally remove this two, only used for soft body physics. Empty
+  // unless residency is GeometryResidency::Full
   std::vector<float> flatVertices;
   std::vector<int> flatIndices;
+  // Model-space positions and full-detail triangles of every mesh, filled
+  // on upload with GeometryResidency::GpuAndPositions. Kept for callers,
+  // the engine builds no shapes from them
+  std::vector<glm::vec3> collisionPositions;
+  std::vector<unsigned int> collisionIndices;
 
   glm::mat4 transform;
   glm::vec3 ambient;
   float shininess;
   bool gammaCorrection;
+  // GPU vertex format of imported meshes, set before importing. Meshes are
+  // packed on the import workers and cached in this layout
+  VertexLayout vertexLayout;
+  // MeshOptimizer passes run on imported meshes, all of them by default
+  unsigned int optimizeFlags;
+  // Set before importing, runtime-optimized by default. Cooked caches are
+  // only reused by imports with the same profile
+  ImportProfile importProfile;
+  // Set before importing, GPU-only by default
+  GeometryResidency residency;
+  // Set before uploading. Packs the meshes into one ModelBatch, drawn with
+  // one multi-draw per material; needs ModelBatch::isSupported()
+  bool mergeMeshes;
 
   Model(bool gamma = false);
   Model(std::string const &path, bool gamma = false);
   void loadModel(std::string const &path);
+  // Imports into staging buffers without touching GL, so it may run on any
+  // thread. With a job system, each mesh is converted and each texture
+  // decoded as a separate job. A cooked mesh cache next to the source is
+  // mapped instead of running Assimp, and written when missing or stale
+  bool importModel(std::string const &path, JobSystem *jobSystem = nullptr);
+  // Creates the GL objects of imported textures and meshes, textures first,
+  // until the budget is spent. Returns true once nothing is left to upload
+  bool uploadPending();
+  bool uploadPending(UploadBudget &budget);
+  bool isUploaded() const;
+  // GPU bytes of the uploaded meshes, CPU bytes still held and CPU bytes
+  // freed after upload
+  GeometryMemory getGeometryMemory() const;
   void Draw(Shader &shader);
-  void syncSoftBodyVertices(); // Optionally remove this, only used for soft
-                               // body physics
+  // Draws with transform instead of the model's own, see Mesh::Draw()
+  void Draw(Shader &shader, const glm::mat4 &transform,
+            const CullView *cullView = nullptr,
+            const LodView *lodView = nullptr);
+  // Counters of the last Draw()
+  const DrawStats &getDrawStats() const;
+  // Optionally remove this, only used for soft body physics. Needs
+  // GeometryResidency::Full, otherwise it warns and does nothing
+  void syncSoftBodyVertices();
   void setPosition(const glm::vec3 &position);
   void setRotation(float angleDegrees, const glm::vec3 &axis);
   void setRotation(const glm::quat &quaternion);
   void setTransform(const glm::mat4 &transform);
 
+  static const char *getResidencyName(GeometryResidency residency);
+  static bool parseResidency(const char *name, GeometryResidency &residency);
+  static const char *getImportProfileName(ImportProfile profile);
+  static bool parseImportProfile(const char *name, ImportProfile &profile);
+
 private:
+  // Where a texture of textures_loaded is read from, indexed alike
+  struct TextureStaging {
+    // Compressed bytes of an embedded texture, valid during the import
+    const unsigned char *embeddedData;
+    size_t embeddedSize;
+  };
+
+  struct MeshImport {
+    const aiMesh *mesh;
+    glm::mat4 transform;
+    size_t flatVertexOffset; // in vertices
+    size_t flatIndexOffset;
+    // Post-transform cache before and after optimizing
+    VertexCacheStats originalCache;
+    VertexCacheStats optimizedCache;
+    // Split off to fit 16-bit indices, appended to meshes after the import
+    std::vector<Mesh> parts;
+  };
+
+  // Mapped cache data a mesh uploads from, indexed like meshes; empty for
+  // meshes converted from Assimp
+  struct MeshSource {
+    std::shared_ptr<MeshCache> cache;
+    const void *vertices; // in the mesh's layout
+    size_t vertexCount;
+    const unsigned int *indices;
+    size_t indexCount;
+  };
+
+  std::vector<TextureStaging> stagedTextures;
+  // Index into textures_loaded of every material texture path
+  std::unordered_map<std::string, size_t> loadedTextureIndices;
+  // Model file of the running import, names its embedded textures
+  std::string sourcePath;
+  std::vector<MeshSource> meshSources;
+  size_t uploadedTextures;
+  size_t uploadedMeshes;
+  // GPU and released bytes, counted as meshes upload
+  GeometryMemory geometryMemory;
+  ModelBatch batch;
+  DrawStats drawStats;
+
+  // Assimp post-processing steps of importProfile
+  unsigned int getImportFlags() const;
+  bool importCache(const std::string &path, uint64_t sourceHash,
+                   JobSystem *jobSystem);
+  void cookCache(const std::string &cachePath, uint64_t sourceHash,
+                 const aiScene *scene, size_t firstMesh);
+  // Decodes textures from firstTexture on, as jobs on the counter when a
+  // job system is given
+  void decodeTextures(size_t firstTexture, JobSystem *jobSystem,
+                      JobCounter &counter);
+  // Sizes the batch for every mesh in the model's vertex layout
+  void allocateBatch();
+  // Uploads a mesh into the batch, false if it gets its own buffers
+  bool addToBatch(Mesh &mesh, const MeshSource &source);
+  // Appends a just uploaded mesh to collisionPositions and collisionIndices
+  void keepCollisionGeometry(const Mesh &mesh, const MeshSource &source);
+
   void processNode(aiNode *node, const aiScene *scene,
-                   const glm::mat4 &parentTransform);
-  Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+                   const glm::mat4 &parentTransform,
+                   std::vector<MeshImport> &imports);
+  void processMesh(MeshImport &import, const aiScene *scene, Mesh &result);
   std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                            std::string typeName,
-                                            const aiScene *scene);
+                                            std::string typeName);
 };
@@ -0,0 +1,98 @@
+#pragma once
+#include "Mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Shader;
+
+// Every mesh of a model in one vertex and one index buffer, each mesh at
+// its own base vertex. Meshes sharing a material are drawn by a single
+// glMultiDrawElementsIndirect call; their model matrices and position
+// decoding come from a shader storage buffer indexed by a per-draw
+// attribute (location 5) that the commands' base instance selects. Needs
+// GL 4.3, see isSupported().
+class ModelBatch {
+public:
+  ModelBatch();
+  ~ModelBatch();
+  ModelBatch(const ModelBatch &) = delete;
+  ModelBatch &operator=(const ModelBatch &) = delete;
+  ModelBatch(ModelBatch &&other) noexcept;
+  ModelBatch &operator=(ModelBatch &&other) noexcept;
+
+  // GL thread, after GLAD. Loads the GL 4.3 entry points GLAD leaves out
+  static void loadFunctions(GLADloadproc loader);
+  static bool isSupported();
+
+  // Creates the buffers for meshCount meshes of one layout, vertexCount
+  // vertices and indexCount indices in all; indexType must hold the
+  // largest index of every mesh
+  void allocate(VertexLayout layout, size_t meshCount, size_t vertexCount,
+                size_t indexCount, unsigned int indexType);
+  bool isAllocated() const;
+  // Copies one mesh of meshes[meshIndex] into the buffers and attaches it.
+  // False when it does not fit, the mesh is then left alone
+  bool add(Mesh &mesh, size_t meshIndex, const void *vertexData,
+           size_t vertexCount, const unsigned int *indexData,
+           size_t indexCount);
+  // Draws the added meshes of meshes, one call per material
+  void draw(Shader &shader, std::vector<Mesh> &meshes,
+            const glm::mat4 &transform, const glm::vec3 &ambient,
+            float shininess, const CullView *cullView,
+            const LodView *lodView);
+  void free();
+
+  size_t getMeshCount() const;
+  size_t getMaterialCount() const;
+
+private:
+  // glMultiDrawElementsIndirect command layout
+  struct DrawCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+  };
+
+  // std430 layout of DrawBuffer in main.glsl
+  struct DrawData {
+    glm::mat4 model;
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+  };
+
+  struct Entry {
+    size_t meshIndex;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+  };
+
+  // Entries with the same textures, next to each other in entries
+  struct Material {
+    size_t firstEntry;
+    size_t entryCount;
+  };
+
+  unsigned int vao, vbo, ebo, drawIdBuffer, commandBuffer, drawBuffer;
+  VertexLayout layout;
+  unsigned int indexType;
+  size_t meshCapacity;
+  size_t vertexCapacity;
+  size_t indexCapacity;
+  size_t vertexCount;
+  size_t indexCount;
+  std::vector<Entry> entries;
+  std::vector<Material> materials;
+  bool materialsDirty;
+
+  // Rebuilt every draw, kept to reuse their memory
+  std::vector<DrawCommand> commands;
+  std::vector<DrawData> drawData;
+  std::vector<size_t> materialCommands;
+
+  void groupMaterials(const std::vector<Mesh> &meshes);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+
+// Window-less OpenGL context for headless rendering. Uses an EGL surfaceless
+// context (Mesa llvmpipe works on GPU-less machines) and renders into a
+// framebuffer object instead of a window back buffer.
+class OffscreenContext {
+public:
+  OffscreenContext();
+  ~OffscreenContext();
+
+  OffscreenContext(const OffscreenContext &) = delete;
+  OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+  static bool isSupported();
+  static void *getProcAddress(const char *name);
+
+  bool createContext();
+  // Needs loaded GL function pointers, call after gladLoadGLLoader
+  bool createFramebuffer(int width, int height);
+  void bindFramebuffer() const;
+  // Blocks until the frame is done, standing in for SwapWindow
+  void present() const;
+  bool readPixels(std::vector<unsigned char> &rgba) const;
+  void free();
+
+  int getWidth() const;
+  int getHeight() const;
+
+private:
+  void *display;
+  void *context;
+  unsigned int framebuffer;
+  unsigned int colorRenderbuffer;
+  unsigned int depthRenderbuffer;
+  int width;
+  int height;
+};
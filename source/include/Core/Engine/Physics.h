@@ -1,3 +1,4 @@
+#pragma once
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "LinearMath/btDefaultMotionState.h"
 #include "LinearMath/btQuaternion.h"
@@ -10,9 +11,23 @@
 #include <LinearMath/btVector3.h>
 #include <btBulletCollisionCommon.h>
 #include <btBulletDynamicsCommon.h>
+#include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/vector_float3.hpp>
+#include <unordered_map>
 #include <vector>
 
+struct PhysicsStepSettings {
+  // When false, falls back to Bullet's variable step with the raw frame delta
+  bool fixedStep;
+  // Simulation ticks per second
+  float tickRate;
+  // Catch-up budget; accumulated time beyond this many ticks is dropped
+  int maxTicksPerFrame;
+  // Advances exactly one tick per frame regardless of wall-clock time, so runs
+  // are reproducible for performance comparisons
+  bool deterministic;
+};
+
 class Physics {
 private:
   Physics();
@@ -29,6 +44,8 @@ public:
   btSequentialImpulseConstraintSolver *solver;
   btDiscreteDynamicsWorld *dynamicsWorld;
 
+  PhysicsStepSettings stepSettings;
+
 public:
   Physics(const Physics &) = delete;
   Physics &operator=(const Physics &) = delete;
@@ -40,6 +57,14 @@ public:
   bool init(const btVector3 &gravity = btVector3(0.0f, -9.8f, 0.0f));
 
   void setGravity(const btVector3 &gravity);
+  // False, keeping the current settings, for a tick rate of 0 or less or a
+  // catch-up budget below one tick
+  bool setStepSettings(const PhysicsStepSettings &settings);
+
+  void stepSimulation(float deltaTime);
+  float getInterpolationAlpha() const;
+  int getLastTickCount() const;
+  glm::mat4 getInterpolatedTransform(const btCollisionObject *object) const;
 
   void addPrimitiveRigidBody(PrimitiveRigidBody &rigidBody);
   void addConvexHullRigidBody(ConvexHullRigidBody &rigidBody,
@@ -49,6 +74,13 @@ public:
   void free();
 
 private:
+  float accumulator;
+  float interpolationAlpha;
+  int lastTickCount;
+  std::unordered_map<const btCollisionObject *, btTransform> previousTransforms;
+
+private:
+  void storePreviousTransforms();
   void createRigidBody(PrimitiveRigidBody &rigidBody);
   btDefaultMotionState *createDefaultMotionState(btQuaternion &rotation,
                                                  btVector3 &position);
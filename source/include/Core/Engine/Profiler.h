@@ -0,0 +1,175 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Zone names are stored by pointer and must outlive the profiler: string
+// literals, __func__ or strings owned by long-lived objects
+
+struct ProfileZone {
+  const char *name;
+  uint64_t startNs;
+  uint64_t endNs;
+  uint32_t threadIndex;
+  uint32_t depth;
+};
+
+struct ProfileFrame {
+  uint64_t index;
+  uint64_t startNs;
+  uint64_t endNs;
+  std::vector<ProfileZone> zones;
+};
+
+struct ProfileZoneStats {
+  const char *name;
+  int calls;
+  double totalMs;
+  double averageMs;
+  double minMs;
+  double maxMs;
+  bool gpu;
+};
+
+class Profiler {
+public:
+  static constexpr int MAX_THREADS = 64;
+  static constexpr int FRAME_HISTORY = 240;
+  static constexpr size_t EVENT_BUFFER_SIZE = 1 << 14;
+  // Pseudo thread index of the lane fed by GpuProfiler
+  static constexpr uint32_t GPU_THREAD_INDEX = MAX_THREADS;
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+  Profiler(Profiler &&) = delete;
+  Profiler &operator=(Profiler &&) = delete;
+
+  static Profiler *getInstance();
+  static uint64_t now();
+
+  // Hot path: wait-free, only touches the calling thread's buffer
+  void beginZone(const char *name);
+  void endZone();
+
+  // Labels the calling thread in the timeline
+  void setThreadName(const char *name);
+
+  // Main thread only: drains every thread buffer and closes the frame
+  void markFrame();
+
+  // Thread-safe. Zones arrive frames late and are filed under the recorded
+  // frame they started in, dropped if it already left the history
+  void addGpuZone(const ProfileZone &zone);
+
+  void setPaused(bool paused);
+  bool isPaused() const;
+
+  // 0 is the most recently completed frame, nullptr if not recorded
+  const ProfileFrame *getFrame(int framesAgo) const;
+  int getFrameCount() const;
+  int getThreadCount() const;
+  const char *getThreadName(uint32_t threadIndex) const;
+  uint64_t getDroppedZoneCount() const;
+
+  // Aggregates zones over the last frameCount frames, slowest total first
+  std::vector<ProfileZoneStats> computeStats(int frameCount) const;
+  // Main thread only. Starts aggregating the zones of every frame from the
+  // next one on, GPU zones included as they arrive, however many frames
+  // that is; getTotals() returns them like computeStats()
+  void resetTotals();
+  std::vector<ProfileZoneStats> getTotals() const;
+
+private:
+  Profiler();
+
+  enum class EventType : uint8_t { Begin, End };
+
+  // Zone name and whether it ran on the GPU
+  using ZoneKey = std::pair<const char *, bool>;
+
+  struct Event {
+    const char *name;
+    uint64_t timestamp;
+    EventType type;
+  };
+
+  struct OpenZone {
+    const char *name;
+    uint64_t startNs;
+  };
+
+  // Single producer (owning thread), single consumer (markFrame)
+  struct ThreadBuffer {
+    std::array<Event, EVENT_BUFFER_SIZE> events;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    uint32_t threadIndex = 0;
+    std::atomic<const char *> name{nullptr};
+
+    // Producer side: begins that were recorded but not yet ended, and
+    // begins skipped because the buffer was full (their whole subtree is
+    // skipped too so ends stay paired)
+    uint32_t recordedDepth = 0;
+    uint32_t skippedDepth = 0;
+
+    // Consumer side
+    std::vector<OpenZone> openZones;
+  };
+
+  std::array<std::unique_ptr<ThreadBuffer>, MAX_THREADS> buffers;
+  std::atomic<int> threadCount;
+  std::mutex registerMutex;
+  std::atomic<uint64_t> droppedZones;
+
+  std::mutex gpuZoneMutex;
+  std::vector<ProfileZone> pendingGpuZones;
+  std::vector<ProfileZone> gpuZoneScratch;
+
+  std::vector<ProfileFrame> frames;
+  uint64_t frameIndex;
+  uint64_t frameStart;
+  int frameCount;
+  bool paused;
+
+  bool collectingTotals;
+  // Index of the first frame counted in the totals
+  uint64_t totalsFirstFrame;
+  std::map<ZoneKey, ProfileZoneStats> totals;
+
+  ThreadBuffer *getThreadBuffer();
+  void push(ThreadBuffer &buffer, EventType type, const char *name);
+  void drain(ThreadBuffer &buffer, ProfileFrame *frame);
+  void fileGpuZones();
+};
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name) {
+    Profiler::getInstance()->beginZone(name);
+  }
+  ~ProfileScope() { Profiler::getInstance()->endZone(); }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+#ifdef SHADER_ENGINE_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)                                                    \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_FRAME_MARK() Profiler::getInstance()->markFrame()
+#define PROFILE_THREAD_NAME(name) Profiler::getInstance()->setThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FRAME_MARK() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+#include "Scene.h"
+#include "imgui.h"
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything the render thread needs to submit one frame. Draw lists are deep
+// copies so the main thread can build the next frame while this one is
+// submitted.
+struct RenderSnapshot {
+  uint64_t frameIndex;
+  int viewportWidth;
+  int viewportHeight;
+  float clearColor[4];
+
+  bool hasScene;
+  SceneView sceneView;
+
+  ImDrawData drawData;
+  std::vector<ImDrawList *> drawLists; // Owned, reused across frames
+
+  RenderSnapshot();
+  ~RenderSnapshot();
+
+  RenderSnapshot(const RenderSnapshot &) = delete;
+  RenderSnapshot &operator=(const RenderSnapshot &) = delete;
+
+  void captureDrawData(const ImDrawData *source);
+  void releaseDrawLists();
+};
+
+class RenderThread {
+public:
+  RenderThread();
+  ~RenderThread();
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread &operator=(const RenderThread &) = delete;
+
+  // Called on the render thread for snapshots that carry a scene view, set
+  // before start()
+  void setSceneRenderer(std::function<void(const SceneView &)> renderer);
+  // Called on the render thread before every submitted frame, for GL
+  // uploads; set before start()
+  void setUploader(std::function<void()> uploader);
+
+  // The GL context must not be current on the calling thread
+  bool start(SDL_Window *window, SDL_GLContext glContext);
+  void stop();
+  bool isRunning() const;
+
+  // Main thread: blocks until the back snapshot is no longer being submitted
+  RenderSnapshot &acquireSnapshot();
+  void publishSnapshot();
+
+  // Main thread: ImGui texture updates of the last published frame are
+  // uploaded by the render thread, so the next ImGui::NewFrame must wait
+  // for them before touching the font atlas
+  void waitForTextureSync();
+
+  double getLastSubmitMs() const;
+
+private:
+  SDL_Window *window;
+  SDL_GLContext glContext;
+  std::function<void(const SceneView &)> sceneRenderer;
+  std::function<void()> uploader;
+
+  std::thread thread;
+  mutable std::mutex mutex;
+  std::condition_variable condition;
+
+  RenderSnapshot snapshots[2];
+  bool snapshotBusy[2];
+  int writeIndex;
+  int pendingIndex;
+  bool texturesSynced;
+  bool running;
+  uint64_t publishedFrames;
+  double lastSubmitMs;
+
+  void threadLoop();
+  void submit(RenderSnapshot &snapshot);
+};
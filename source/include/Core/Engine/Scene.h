@@ -0,0 +1,175 @@
+#pragma once
+#include "AssetStreamer.h"
+#include "Camera.h"
+#include "Model.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class btRigidBody;
+
+enum class SceneLightType { Directional, Point, Spot };
+
+struct SceneLight {
+  SceneLightType type;
+  glm::vec3 position;
+  glm::vec3 direction;
+  glm::vec3 ambient;
+  glm::vec3 diffuse;
+  glm::vec3 specular;
+  float constant;
+  float linear;
+  float quadratic;
+  float innerCutoffDegrees;
+  float outerCutoffDegrees;
+};
+
+enum class SceneBodyShape { Box, Sphere, Capsule, Cylinder, Cone, Plane };
+
+struct SceneBody {
+  SceneBodyShape shape;
+  glm::vec3 dimension; // box and cylinder half extents
+  float radius;
+  float height; // capsule and cone height, plane constant
+  glm::vec3 normal;
+  float mass;
+  glm::vec3 position;
+  // Index into the scene's models driven by this body, -1 for none
+  int model;
+
+  btRigidBody *rigidBody;
+};
+
+struct CameraKeyframe {
+  float time;
+  glm::vec3 position;
+  float yaw;
+  float pitch;
+};
+
+// Linearly interpolated camera keyframes, sorted by time
+class CameraPath {
+public:
+  void addKeyframe(const CameraKeyframe &keyframe);
+  bool isEmpty() const;
+  float getDuration() const;
+  // Past the last keyframe the path holds its last pose, or wraps if looping
+  void apply(float time, Camera &camera) const;
+
+  bool loop = false;
+
+private:
+  std::vector<CameraKeyframe> keyframes;
+};
+
+// Everything a frame needs to draw the scene, captured on the thread that
+// updates it so another thread can draw without touching live state
+struct SceneView {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 viewPosition;
+  // Pixels covered by one unit at distance 1, for LOD selection
+  float pixelScale;
+  std::vector<glm::mat4> modelTransforms;
+};
+
+// Loads a line based scene description:
+//
+//   # comment
+//   model <path> [position x y z] [rotation deg ax ay az] [scale s]
+//         [residency gpu|positions|full]
+//   light directional|point|spot [position x y z] [direction x y z]
+//         [ambient r g b] [diffuse r g b] [specular r g b]
+//         [attenuation constant linear quadratic] [cutoff inner outer]
+//   body box|sphere|capsule|cylinder|cone|plane [dimension x y z]
+//        [radius r] [height h] [normal x y z] [mass m] [position x y z]
+//        [model index]
+//   camera <time> position x y z [yaw deg] [pitch deg]
+//   camera_loop
+//
+// Relative model paths resolve against the scene file's directory. A body's
+// model index refers to the model lines above it, in order.
+class Scene {
+public:
+  Scene();
+
+  bool loadFromFile(const std::string &path);
+  // GPU vertex format models are imported in, see VertexLayout
+  void setVertexLayout(VertexLayout layout);
+  // Assimp post-processing models are imported with, see ImportProfile
+  void setImportProfile(ImportProfile profile);
+  // CPU geometry models keep after upload, unless their scene line sets
+  // one; applies to scenes loaded afterwards
+  void setGeometryResidency(GeometryResidency residency);
+  // Merges each model's meshes into shared buffers drawn with multi-draw
+  // indirect, see Model::mergeMeshes
+  void setMergedDraws(bool merged);
+  // Meshlet frustum culling per draw. Backface culling enables GL_CULL_FACE
+  // and with it the meshlet normal cone test
+  void setCulling(bool clusters, bool backfaces);
+  // Screen-space error, in pixels, mesh LODs may show; 0 always draws full
+  // detail
+  void setLodPixelError(float pixels);
+  // Queues every model on the streamer, which imports them in the
+  // background and uploads them within its budget. Models draw as the
+  // streamer's placeholder until then; the streamer outlives the scene
+  void streamModels(AssetStreamer &streamer);
+  // Needs Physics to be initialized
+  void createRigidBodies();
+  void free();
+
+  bool isLoaded() const;
+  const std::string &getPath() const;
+
+  // Copies rigid body poses into the models they drive
+  void update();
+  void captureView(const Camera &camera, float aspectRatio,
+                   int viewportHeight, SceneView &view) const;
+  void draw(Shader &shader, const SceneView &view);
+
+  Camera &getCamera();
+  const CameraPath &getCameraPath() const;
+  size_t getModelCount() const;
+  size_t getLightCount() const;
+  size_t getBodyCount() const;
+  // Summed over every streamed model
+  GeometryMemory getGeometryMemory() const;
+  // Summed over the models of the last draw(), safe from any thread
+  DrawStats getDrawStats() const;
+
+private:
+  struct ModelEntry {
+    std::string path;
+    glm::mat4 transform;
+    glm::vec3 scale;
+    GeometryResidency residency;
+    // Entries of one file and residency share a model
+    ModelHandle handle;
+  };
+
+  std::string path;
+  std::string directory;
+  bool loaded;
+  VertexLayout vertexLayout;
+  ImportProfile importProfile;
+  GeometryResidency residency;
+  bool mergedDraws;
+  bool clusterCulling;
+  bool backfaceCulling;
+  float lodPixelError;
+  AssetStreamer *streamer;
+  // Written by draw(), which may run on the render thread
+  mutable std::mutex drawStatsMutex;
+  DrawStats drawStats;
+
+  std::vector<ModelEntry> models;
+  std::vector<SceneLight> lights;
+  std::vector<SceneBody> bodies;
+  Camera camera;
+  CameraPath cameraPath;
+
+  bool parseLine(const std::string &line, int lineNumber);
+  void applyLights(Shader &shader) const;
+};
@@ -14,6 +14,8 @@ private:
   std::string parseShaderSource(const char *sourcePath, Shader_Type type);
   GLuint compileShader(GLuint shader_type, const char *source);
   bool usable;
+  std::string vertexSource;
+  std::string fragmentSource;
 
 private:
   void createProgram(GLuint &vertexShader, GLuint &fragmentShader);
@@ -27,6 +29,11 @@ public:
   ~Shader();
 
   void init(const char *sourcePath);
+  // Reading and splitting the source file needs no GL context, so it may
+  // run on a worker thread ahead of compile()
+  void loadSource(const char *sourcePath);
+  void compile();
+  bool isUsable() const;
   void bind() const;
   void unbind() const;
   void setBool(const std::string &name, bool value);
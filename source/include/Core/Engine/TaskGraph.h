@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+using TaskID = unsigned int;
+
+enum class TaskAffinity { AnyThread, MainThread };
+
+struct TaskTiming {
+  std::string name;
+  double startMs;    // relative to the start of TaskGraph::execute
+  double durationMs;
+  int workerIndex;   // -1 when executed on the main thread
+};
+
+// Dependency graph of named tasks executed on a JobSystem. Dependencies must
+// refer to tasks added earlier, so the graph is acyclic by construction. The
+// graph is built once and may be executed any number of times; tasks must not
+// be added while it executes.
+class TaskGraph {
+public:
+  TaskGraph();
+
+  TaskGraph(const TaskGraph &) = delete;
+  TaskGraph &operator=(const TaskGraph &) = delete;
+
+  TaskID addTask(const std::string &name, std::function<void()> function,
+                 const std::vector<TaskID> &dependencies = {},
+                 TaskAffinity affinity = TaskAffinity::AnyThread);
+  void clear();
+
+  // Blocks until every task has finished; MainThread tasks run on the caller
+  void execute(JobSystem &jobSystem);
+
+  size_t getTaskCount() const;
+  const std::vector<TaskTiming> &getTimings() const;
+  double getLastExecutionMs() const;
+
+private:
+  struct Task {
+    std::string name;
+    std::function<void()> function;
+    TaskAffinity affinity;
+    std::vector<TaskID> dependents;
+    int dependencyCount;
+  };
+
+  std::vector<Task> tasks;
+  std::unique_ptr<std::atomic<int>[]> pendingDependencies;
+  size_t pendingCapacity;
+  std::vector<TaskTiming> timings;
+  double lastExecutionMs;
+
+  std::atomic<int> remainingTasks;
+  std::mutex mainQueueMutex;
+  std::condition_variable mainQueueCondition;
+  std::deque<TaskID> mainQueue;
+  std::chrono::steady_clock::time_point executionStart;
+
+  void schedule(TaskID id, JobSystem &jobSystem);
+  void runTask(TaskID id, JobSystem &jobSystem);
+};
@@ -1,15 +1,18 @@
 #pragma once
 
+#include "TextureRegistry.h"
 #include <string>
 #include <vector>
 
 enum class TextureType { Texture2D, Cubemap };
 
+// 2D textures come from the TextureRegistry and are shared with every other
+// user of the same image; cubemaps are owned
 class Texture2D {
 private:
   unsigned int rendererID;
   TextureType type;
-  unsigned char *localBuffer;
+  TextureRef shared;
   int width;
   int height;
   int bpp;
@@ -21,11 +24,16 @@ public:
   ~Texture2D();
 
   bool load2D(const std::string &path);
+  // load2D split in two: decode2D only reads and decodes the image, so it
+  // may run on a worker, upload2D then creates the GL texture from it
+  bool decode2D(const std::string &path);
+  bool upload2D();
   bool loadCubemap(const std::vector<std::string> &faces);
 
   void bind(unsigned int slot = 0) const;
   void unbind() const;
 
+  inline unsigned int getRendererID() const { return rendererID; }
   inline int getWidth() const { return width; }
   inline int getHeight() const { return height; }
 };
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One 2D image on the GPU, shared by every model and Texture2D that loaded
+// it. Handles are shared_ptrs handed out by TextureRegistry
+class SharedTexture {
+public:
+  // Resolved path, or the key of an in-memory image
+  const std::string &getPath() const;
+  uint64_t getContentHash() const;
+  // 0 until uploaded
+  unsigned int getId() const;
+  int getWidth() const;
+  int getHeight() const;
+  int getComponents() const;
+  // Valid once TextureRegistry::decode() returned
+  bool hasFailed() const;
+
+private:
+  friend class TextureRegistry;
+
+  std::string path;
+  uint64_t contentHash;
+  // Set once on insert, so content matches can be checked while another
+  // thread decodes: encoded length and the size the image header declares
+  size_t encodedSize;
+  int headerWidth;
+  int headerHeight;
+  int headerComponents;
+  // Encoded image until decoded, then the pixels until uploaded
+  std::vector<unsigned char> encoded;
+  std::shared_ptr<unsigned char> pixels;
+  int width;
+  int height;
+  int components;
+  bool failed;
+  unsigned int id;
+  std::once_flag decoded;
+  std::once_flag uploaded;
+
+  SharedTexture();
+};
+
+using TextureRef = std::shared_ptr<SharedTexture>;
+
+// Engine-wide texture cache. Lookups go by resolved path first and then by
+// a hash of the file contents, so the same image reached through another
+// path or embedded in another model is decoded and uploaded once. The
+// registry only keeps weak references: once the last handle is released,
+// the texture leaves the maps and its GL texture is deleted by the next
+// deleteReleased() on the GL thread.
+class TextureRegistry {
+public:
+  static TextureRegistry *getInstance();
+
+  TextureRegistry(const TextureRegistry &) = delete;
+  TextureRegistry &operator=(const TextureRegistry &) = delete;
+
+  // Thread-safe. A file that cannot be read still gets a texture, which
+  // fails to decode
+  TextureRef acquire(const std::string &path);
+  // Compressed image bytes held in memory, such as a texture embedded in a
+  // model; key stands in for the path and must be unique to the source
+  TextureRef acquire(const std::string &key, const unsigned char *data,
+                     size_t size);
+
+  // Thread-safe and done once per texture, later callers wait for the
+  // first. Images are flipped vertically for GL
+  void decode(SharedTexture &texture);
+  // GL thread. Creates the GL texture once, decoding first if nobody has;
+  // returns the bytes uploaded by this call. Failed textures still get an
+  // empty GL texture so materials keep their slots
+  size_t upload(SharedTexture &texture);
+  // GL thread, deletes the GL textures of released textures
+  void deleteReleased();
+
+  // Textures with live handles and the GPU memory of the uploaded ones
+  size_t getTextureCount() const;
+  size_t getMemoryBytes() const;
+
+private:
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::weak_ptr<SharedTexture>> paths;
+  std::unordered_map<uint64_t, std::weak_ptr<SharedTexture>> hashes;
+  std::vector<unsigned int> releasedIds;
+  size_t textureCount;
+  std::atomic<size_t> memoryBytes;
+
+  TextureRegistry();
+
+  TextureRef find(const std::string &path);
+  TextureRef insert(const std::string &path,
+                    std::vector<unsigned char> encoded);
+  void release(SharedTexture *texture);
+};
@@ -1,8 +1,11 @@
 #pragma once
 #include "UIVisibility.h"
 #include <SDL.h>
+#include <functional>
 #include <glad/glad.h>
 
+struct DrawStats;
+
 class UI {
 private:
   UI();
@@ -20,6 +23,8 @@ public:
   static UIVisibility uiVisibility;
 
   bool init(SDL_Window *window, SDL_GLContext glContext) const;
+  // Renderer backend only, for offscreen runs without an SDL window
+  bool initHeadless(const int &width, const int &height);
   bool initImGuiWindowRenderSpace(const int &width, const int &height);
   void resizeFramebuffer(const int &width, const int &height);
 
@@ -28,6 +33,20 @@ public:
   void resetLayout();
   void resetBitFieldsValues();
   void render();
+  void buildFrame();
+  void submitFrame();
+  void prepareForRenderThread();
+  // Counters of the last scene draw shown in the profiler window; called on
+  // the UI thread while it builds
+  void setDrawStatsSource(std::function<DrawStats()> source);
   void renderImGuiWindows();
   void free();
+
+private:
+  bool headless;
+  std::function<DrawStats()> drawStatsSource;
+
+  void renderProfilerWindow();
+  void renderMemoryStats();
+  void renderDrawStats();
 };
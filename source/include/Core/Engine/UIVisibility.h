@@ -8,4 +8,5 @@ struct UIVisibility {
   unsigned int right_panel : 1;
   unsigned int right_panel_2 : 1;
   unsigned int bottom_panel : 1;
+  unsigned int profiler : 1;
 };
@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+// Time and byte allowance for GL uploads within one frame, shared by
+// everything uploading in it. A zero limit is unlimited. The first upload
+// always goes through, so a single asset larger than the budget still lands.
+class UploadBudget {
+public:
+  explicit UploadBudget(double milliseconds = 0.0, size_t bytes = 0)
+      : start(std::chrono::steady_clock::now()), milliseconds(milliseconds),
+        bytes(bytes), spentBytes(0) {}
+
+  bool isSpent() const {
+    if (bytes > 0 && spentBytes >= bytes)
+      return true;
+    return milliseconds > 0.0 && getElapsedMs() >= milliseconds;
+  }
+
+  void spend(size_t uploadedBytes) { spentBytes += uploadedBytes; }
+
+  size_t getSpentBytes() const { return spentBytes; }
+
+  double getElapsedMs() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+  double milliseconds;
+  size_t bytes;
+  size_t spentBytes;
+};
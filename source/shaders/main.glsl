@@ -1,29 +1,72 @@
 #shader vertex
-#version 410 core
+#version 430 core
 
 layout(location = 0) in vec3 L_coordinate;
 layout(location = 1) in vec3 L_normal;
 layout(location = 2) in vec2 L_texCoord;
+// Per instance; ModelBatch commands select their draw with base instance
+layout(location = 5) in uint L_drawId;
 
 uniform mat4 u_Projection;
 uniform mat4 u_View;
 uniform mat4 u_Model;
+// VertexLayout of the mesh: 0 is float, the compact layouts carry
+// octahedron-encoded normals in L_normal.xy
+uniform int u_VertexLayout;
+// Undoes position quantization, identity for unquantized layouts
+uniform vec3 u_PositionOffset;
+uniform vec3 u_PositionScale;
+
+// Matches ModelBatch::DrawData
+struct DrawData {
+    mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+// Set by ModelBatch, which takes the per-mesh uniforms from draws
+uniform bool u_Batched;
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
 out vec3 v_Normal;
 out vec2 v_TexCoord;
 out vec3 v_FragPos;
 
-void main() {
-    mat4 mvp = u_Projection * u_View * u_Model;
-    gl_Position = mvp * vec4(L_coordinate, 1.0f);
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 vector = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-vector.z, 0.0f);
+    vector.x += vector.x >= 0.0f ? -fold : fold;
+    vector.y += vector.y >= 0.0f ? -fold : fold;
+    return normalize(vector);
+}
 
-    v_Normal = mat3(transpose(inverse(u_Model))) * L_normal;
+void main() {
+    mat4 model = u_Model;
+    vec3 positionOffset = u_PositionOffset;
+    vec3 positionScale = u_PositionScale;
+    if (u_Batched) {
+        model = draws[L_drawId].model;
+        positionOffset = draws[L_drawId].positionOffset.xyz;
+        positionScale = draws[L_drawId].positionScale.xyz;
+    }
+
+    vec3 position = positionOffset + L_coordinate * positionScale;
+    vec3 normal = L_normal;
+    if (u_VertexLayout != 0)
+        normal = decodeOctahedral(L_normal.xy);
+
+    mat4 mvp = u_Projection * u_View * model;
+    gl_Position = mvp * vec4(position, 1.0f);
+
+    v_Normal = mat3(transpose(inverse(model))) * normal;
     v_TexCoord = L_texCoord;
-    v_FragPos = vec3(u_Model * vec4(L_coordinate, 1.0f));
+    v_FragPos = vec3(model * vec4(position, 1.0f));
 }
 
 #shader fragment
-#version 410 core
+#version 430 core
 
 struct Material {
     vec3 ambient;
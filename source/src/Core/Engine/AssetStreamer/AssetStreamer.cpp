@@ -0,0 +1,341 @@
+#include "AssetStreamer.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <glad/glad.h>
+
+static constexpr int CHECKER_SIZE = 8;
+
+static std::string getModelKey(const std::string &path,
+                               const ModelLoadSettings &settings);
+
+AssetStreamer::AssetStreamer()
+    : budgetMs(0.0), budgetBytes(0), placeholderTexture(0),
+      lastFrameUploadBytes(0), lastFrameUploadMs(0.0) {}
+
+AssetStreamer::~AssetStreamer() { loadJobs.free(); }
+
+bool AssetStreamer::init(double budgetMs, double budgetMB,
+                         unsigned int workerCount) {
+  Logger::assetStreamer->info("Initializing asset streamer...");
+
+  if (!loadJobs.init(workerCount, "Streaming")) {
+    Logger::assetStreamer->error("Failed to start the streaming workers.");
+    return false;
+  }
+
+  this->budgetMs = budgetMs;
+  budgetBytes = static_cast<size_t>(budgetMB * 1024.0 * 1024.0);
+
+  Logger::assetStreamer->info(
+      "Successfully initialized asset streamer ({:.2f} ms, {:.2f} MB per "
+      "frame).",
+      budgetMs, budgetMB);
+  return true;
+}
+
+void AssetStreamer::free() {
+  // Running loads finish first, their slots must outlive them
+  loadJobs.free();
+
+  std::lock_guard<std::mutex> lock(slotMutex);
+  if (!models.empty() || !textures.empty())
+    Logger::assetStreamer->info("Destroying {} streamed models and {} "
+                                "streamed textures.",
+                                models.size(), textures.size());
+
+  loadCounter.pending = 0;
+  modelUploads.clear();
+  textureUploads.clear();
+  models.clear();
+  textures.clear();
+  modelIds.clear();
+  textureIds.clear();
+
+  placeholderModel = Model();
+  if (placeholderTexture) {
+    glDeleteTextures(1, &placeholderTexture);
+    placeholderTexture = 0;
+  }
+}
+
+void AssetStreamer::setModelSettings(const ModelLoadSettings &settings) {
+  std::lock_guard<std::mutex> lock(slotMutex);
+  modelSettings = settings;
+}
+
+ModelHandle AssetStreamer::loadModel(const std::string &path) {
+  ModelLoadSettings settings;
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    settings = modelSettings;
+  }
+  return loadModel(path, settings);
+}
+
+ModelHandle AssetStreamer::loadModel(const std::string &path,
+                                     const ModelLoadSettings &settings) {
+  std::string key = getModelKey(path, settings);
+  ModelSlot *slot;
+  ModelHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    auto found = modelIds.find(key);
+    if (found != modelIds.end())
+      return ModelHandle{found->second};
+
+    models.push_back(std::make_unique<ModelSlot>());
+    slot = models.back().get();
+    slot->path = path;
+    slot->model.vertexLayout = settings.vertexLayout;
+    slot->model.importProfile = settings.importProfile;
+    slot->model.residency = settings.residency;
+    slot->model.mergeMeshes = settings.mergeMeshes;
+    handle.id = static_cast<uint32_t>(models.size());
+    modelIds[key] = handle.id;
+  }
+
+  Logger::assetStreamer->info("Streaming model: {}", path);
+  loadJobs.submit([this, slot] {
+    PROFILE_SCOPE("AssetStreamer::loadModel");
+    if (!slot->model.importModel(slot->path, &loadJobs) ||
+        slot->model.meshes.empty()) {
+      Logger::assetStreamer->error("Failed to stream model: {}", slot->path);
+      slot->state = AssetState::Failed;
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(slotMutex);
+    slot->state = AssetState::Uploading;
+    modelUploads.push_back(slot);
+  }, &loadCounter);
+  return handle;
+}
+
+TextureHandle AssetStreamer::loadTexture(const std::string &path) {
+  TextureSlot *slot;
+  TextureHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    auto found = textureIds.find(path);
+    if (found != textureIds.end())
+      return TextureHandle{found->second};
+
+    textures.push_back(std::make_unique<TextureSlot>());
+    slot = textures.back().get();
+    slot->path = path;
+    handle.id = static_cast<uint32_t>(textures.size());
+    textureIds[path] = handle.id;
+  }
+
+  Logger::assetStreamer->info("Streaming texture: {}", path);
+  loadJobs.submit([this, slot] {
+    PROFILE_SCOPE("AssetStreamer::loadTexture");
+    if (!slot->texture.decode2D(slot->path)) {
+      Logger::assetStreamer->error("Failed to stream texture: {}",
+                                   slot->path);
+      slot->state = AssetState::Failed;
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(slotMutex);
+    slot->state = AssetState::Uploading;
+    textureUploads.push_back(slot);
+  }, &loadCounter);
+  return handle;
+}
+
+AssetState AssetStreamer::getState(ModelHandle handle) const {
+  ModelSlot *slot = findModel(handle);
+  return slot ? slot->state.load() : AssetState::Failed;
+}
+
+AssetState AssetStreamer::getState(TextureHandle handle) const {
+  TextureSlot *slot = findTexture(handle);
+  return slot ? slot->state.load() : AssetState::Failed;
+}
+
+Model &AssetStreamer::getModel(ModelHandle handle) {
+  ModelSlot *slot = findModel(handle);
+  if (slot && slot->state == AssetState::Ready)
+    return slot->model;
+  return placeholderModel;
+}
+
+unsigned int AssetStreamer::getTexture(TextureHandle handle) const {
+  TextureSlot *slot = findTexture(handle);
+  if (slot && slot->state == AssetState::Ready)
+    return slot->texture.getRendererID();
+  return placeholderTexture;
+}
+
+void AssetStreamer::update() {
+  PROFILE_FUNCTION();
+
+  UploadBudget budget(budgetMs, budgetBytes);
+  upload(budget);
+}
+
+bool AssetStreamer::flush() {
+  PROFILE_FUNCTION();
+
+  loadJobs.wait(loadCounter);
+  UploadBudget unlimited;
+  upload(unlimited);
+
+  std::lock_guard<std::mutex> lock(slotMutex);
+  for (const std::unique_ptr<ModelSlot> &slot : models) {
+    if (slot->state == AssetState::Failed)
+      return false;
+  }
+  for (const std::unique_ptr<TextureSlot> &slot : textures) {
+    if (slot->state == AssetState::Failed)
+      return false;
+  }
+  return true;
+}
+
+AssetStreamerStats AssetStreamer::getStats() const {
+  std::lock_guard<std::mutex> lock(slotMutex);
+
+  AssetStreamerStats stats{0, 0, 0, 0, lastFrameUploadBytes,
+                           lastFrameUploadMs};
+  auto count = [&stats](AssetState state) {
+    switch (state) {
+    case AssetState::Loading:
+      stats.loading++;
+      break;
+    case AssetState::Uploading:
+      stats.uploading++;
+      break;
+    case AssetState::Ready:
+      stats.ready++;
+      break;
+    case AssetState::Failed:
+      stats.failed++;
+      break;
+    }
+  };
+  for (const std::unique_ptr<ModelSlot> &slot : models)
+    count(slot->state);
+  for (const std::unique_ptr<TextureSlot> &slot : textures)
+    count(slot->state);
+  return stats;
+}
+
+AssetStreamer::ModelSlot *AssetStreamer::findModel(ModelHandle handle) const {
+  std::lock_guard<std::mutex> lock(slotMutex);
+  if (handle.id == 0 || handle.id > models.size())
+    return nullptr;
+  return models[handle.id - 1].get();
+}
+
+AssetStreamer::TextureSlot *
+AssetStreamer::findTexture(TextureHandle handle) const {
+  std::lock_guard<std::mutex> lock(slotMutex);
+  if (handle.id == 0 || handle.id > textures.size())
+    return nullptr;
+  return textures[handle.id - 1].get();
+}
+
+void AssetStreamer::upload(UploadBudget &budget) {
+  std::unique_lock<std::mutex> lock(slotMutex);
+  if (!placeholderTexture)
+    createPlaceholders();
+
+  // Slots are only touched by the loading job until they are queued, so
+  // uploading outside the lock is safe
+  while (!modelUploads.empty() && !budget.isSpent()) {
+    ModelSlot *slot = modelUploads.front();
+    lock.unlock();
+    bool uploaded = slot->model.uploadPending(budget);
+    lock.lock();
+
+    if (!uploaded)
+      break;
+    modelUploads.pop_front();
+    slot->state = AssetState::Ready;
+    Logger::assetStreamer->info("Model ready: {}", slot->path);
+  }
+
+  while (!textureUploads.empty() && !budget.isSpent()) {
+    TextureSlot *slot = textureUploads.front();
+    textureUploads.pop_front();
+    lock.unlock();
+    slot->texture.upload2D();
+    budget.spend(static_cast<size_t>(slot->texture.getWidth()) *
+                 slot->texture.getHeight() * 4);
+    lock.lock();
+
+    slot->state = AssetState::Ready;
+    Logger::assetStreamer->info("Texture ready: {}", slot->path);
+  }
+
+  lastFrameUploadBytes = budget.getSpentBytes();
+  lastFrameUploadMs = budget.getElapsedMs();
+}
+
+// Magenta and black checkerboard on a unit cube, hard to mistake for a
+// loaded asset
+void AssetStreamer::createPlaceholders() {
+  unsigned char pixels[CHECKER_SIZE * CHECKER_SIZE * 4];
+  for (int y = 0; y < CHECKER_SIZE; y++) {
+    for (int x = 0; x < CHECKER_SIZE; x++) {
+      unsigned char *pixel = pixels + (y * CHECKER_SIZE + x) * 4;
+      bool magenta = (x + y) % 2 == 0;
+      pixel[0] = magenta ? 255 : 0;
+      pixel[1] = 0;
+      pixel[2] = magenta ? 255 : 0;
+      pixel[3] = 255;
+    }
+  }
+
+  glGenTextures(1, &placeholderTexture);
+  glBindTexture(GL_TEXTURE_2D, placeholderTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, CHECKER_SIZE, CHECKER_SIZE, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // One face per normal, so every face gets the whole checkerboard
+  const glm::vec3 normals[6] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  for (const glm::vec3 &normal : normals) {
+    glm::vec3 tangent = normal.x != 0.0f ? glm::vec3(0.0f, 0.0f, -normal.x)
+                                         : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    unsigned int first = static_cast<unsigned int>(vertices.size());
+    const glm::vec2 corners[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    for (const glm::vec2 &corner : corners) {
+      Vertex vertex;
+      vertex.Position = 0.5f * normal + (corner.x - 0.5f) * tangent +
+                        (corner.y - 0.5f) * bitangent;
+      vertex.Normal = normal;
+      vertex.TexCoords = corner;
+      vertex.Tangent = tangent;
+      vertex.Bitangent = bitangent;
+      vertices.push_back(vertex);
+    }
+    unsigned int quad[6] = {0, 1, 2, 2, 3, 0};
+    for (unsigned int index : quad)
+      indices.push_back(first + index);
+  }
+
+  Texture texture{placeholderTexture, "texture_diffuse", "<placeholder>"};
+  placeholderModel.meshes.emplace_back(std::move(vertices), std::move(indices),
+                                       std::vector<Texture>{texture});
+}
+
+static std::string getModelKey(const std::string &path,
+                               const ModelLoadSettings &settings) {
+  return path + '|' +
+         std::to_string(static_cast<int>(settings.vertexLayout)) + '|' +
+         std::to_string(static_cast<int>(settings.importProfile)) + '|' +
+         std::to_string(static_cast<int>(settings.residency)) + '|' +
+         std::to_string(settings.mergeMeshes);
+}
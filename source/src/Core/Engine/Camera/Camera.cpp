@@ -38,7 +38,7 @@ void Camera::processKeyboard(SDL_Event &event, SDL_Window *window) {
         KeyEvents::isLockedIn = !KeyEvents::isLockedIn;
 
         if (!KeyEvents::isLockedIn) {
-          int width, height;
+          int width = 0, height = 0;
           SDL_GetWindowSize(window, &width, &height);
           SDL_WarpMouseInWindow(window, width / 2, height / 2);
         }
@@ -141,8 +141,9 @@ void Camera::processMouseMotion(SDL_Event &event) {
   }
 }
 
-void Camera::update() {
-  SDL_SetRelativeMouseMode(KeyEvents::isLockedIn ? SDL_TRUE : SDL_FALSE);
+void Camera::update(bool grabMouse) {
+  if (grabMouse)
+    SDL_SetRelativeMouseMode(KeyEvents::isLockedIn ? SDL_TRUE : SDL_FALSE);
 
   if (KeyEvents::isLockedIn) {
     float modifiedSpeed =
@@ -176,4 +177,11 @@ void Camera::updateCameraVectors() {
   up = glm::normalize(glm::cross(right, front));
 }
 
+void Camera::setPose(const glm::vec3 &position, float yaw, float pitch) {
+  this->position = position;
+  this->yaw = yaw;
+  this->pitch = pitch;
+  updateCameraVectors();
+}
+
 float Camera::getFOV() const { return fov; }
@@ -0,0 +1,194 @@
+#include "ClusterCuller.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) ||                                     \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CLUSTER_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+static constexpr size_t LANES = 4;
+
+// Gribb and Hartmann: each plane is the last row of the matrix plus or minus
+// one of the others
+CullView CullView::fromViewProjection(const glm::mat4 &viewProjection,
+                                      const glm::vec3 &position,
+                                      bool backfaces) {
+  glm::vec4 rows[4];
+  for (int row = 0; row < 4; row++)
+    rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+                          viewProjection[2][row], viewProjection[3][row]);
+
+  CullView view;
+  view.planes[0] = rows[3] + rows[0]; // left
+  view.planes[1] = rows[3] - rows[0]; // right
+  view.planes[2] = rows[3] + rows[1]; // bottom
+  view.planes[3] = rows[3] - rows[1]; // top
+  view.planes[4] = rows[3] + rows[2]; // near
+  view.planes[5] = rows[3] - rows[2]; // far
+  for (glm::vec4 &plane : view.planes)
+    plane /= glm::length(glm::vec3(plane));
+  view.position = position;
+  view.backfaces = backfaces;
+  return view;
+}
+
+ClusterCuller::ClusterCuller() : meshletCount(0), visibleCount(0) {}
+
+void ClusterCuller::build(const std::vector<Meshlet> &meshlets) {
+  meshletCount = meshlets.size();
+  size_t padded = (meshletCount + LANES - 1) / LANES * LANES;
+
+  // Padding has an infinitely negative radius, which fails every plane
+  float never = -std::numeric_limits<float>::infinity();
+  centerX.assign(padded, 0.0f);
+  centerY.assign(padded, 0.0f);
+  centerZ.assign(padded, 0.0f);
+  radius.assign(padded, never);
+  axisX.assign(padded, 0.0f);
+  axisY.assign(padded, 0.0f);
+  axisZ.assign(padded, 0.0f);
+  cutoff.assign(padded, Meshlet::NO_CONE);
+  firstIndex.assign(padded, 0);
+  indexCount.assign(padded, 0);
+
+  for (size_t i = 0; i < meshletCount; i++) {
+    const Meshlet &meshlet = meshlets[i];
+    centerX[i] = meshlet.center.x;
+    centerY[i] = meshlet.center.y;
+    centerZ[i] = meshlet.center.z;
+    radius[i] = meshlet.radius;
+    axisX[i] = meshlet.coneAxis.x;
+    axisY[i] = meshlet.coneAxis.y;
+    axisZ[i] = meshlet.coneAxis.z;
+    cutoff[i] = meshlet.coneCutoff;
+    firstIndex[i] = meshlet.firstIndex;
+    indexCount[i] = meshlet.indexCount;
+  }
+
+  counts.reserve(meshletCount);
+  offsets.reserve(meshletCount);
+}
+
+bool ClusterCuller::isEmpty() const { return meshletCount == 0; }
+
+size_t ClusterCuller::getMeshletCount() const { return meshletCount; }
+
+bool ClusterCuller::cull(const glm::mat4 &model, const CullView &view,
+                         size_t indexStride, size_t baseOffset) {
+  PROFILE_FUNCTION();
+
+  counts.clear();
+  offsets.clear();
+  visibleCount = 0;
+  if (meshletCount == 0)
+    return false;
+
+  // The planes and the eye move into model space once, instead of every
+  // meshlet into world space. Planes keep world-space distances, so radii
+  // only need the largest scale
+  glm::mat4 transposed = glm::transpose(model);
+  glm::vec4 planes[6];
+  for (int i = 0; i < 6; i++)
+    planes[i] = transposed * view.planes[i];
+
+  float scaleX = glm::length(glm::vec3(model[0]));
+  float scaleY = glm::length(glm::vec3(model[1]));
+  float scaleZ = glm::length(glm::vec3(model[2]));
+  float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+  float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+  // Non-uniform scale bends normals, so the cones no longer hold
+  bool cones = view.backfaces && maxScale - minScale <= 1e-3f * maxScale;
+  glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(view.position, 1));
+
+  uint32_t rangeEnd = 0;
+  for (size_t block = 0; block < meshletCount; block += LANES) {
+    int mask = 0;
+#ifdef CLUSTER_CULLER_SSE
+    __m128 x = _mm_loadu_ps(&centerX[block]);
+    __m128 y = _mm_loadu_ps(&centerY[block]);
+    __m128 z = _mm_loadu_ps(&centerZ[block]);
+    __m128 r = _mm_loadu_ps(&radius[block]);
+    __m128 negativeRadius =
+        _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(r, _mm_set1_ps(maxScale)));
+
+    __m128 visible = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+    for (const glm::vec4 &plane : planes) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                     _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                     _mm_set1_ps(plane.w)));
+      visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+    }
+
+    if (cones) {
+      __m128 dx = _mm_sub_ps(x, _mm_set1_ps(eye.x));
+      __m128 dy = _mm_sub_ps(y, _mm_set1_ps(eye.y));
+      __m128 dz = _mm_sub_ps(z, _mm_set1_ps(eye.z));
+      __m128 along = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&axisX[block])),
+                     _mm_mul_ps(dy, _mm_loadu_ps(&axisY[block]))),
+          _mm_mul_ps(dz, _mm_loadu_ps(&axisZ[block])));
+      __m128 length = _mm_sqrt_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                     _mm_mul_ps(dz, dz)));
+      __m128 backfacing = _mm_cmpge_ps(
+          along,
+          _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[block]), length), r));
+      visible = _mm_andnot_ps(backfacing, visible);
+    }
+    mask = _mm_movemask_ps(visible);
+#else
+    for (size_t lane = 0; lane < LANES; lane++) {
+      size_t i = block + lane;
+      glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+      bool visible = true;
+      for (const glm::vec4 &plane : planes)
+        visible = visible && glm::dot(glm::vec3(plane), center) + plane.w >=
+                                 -radius[i] * maxScale;
+
+      if (visible && cones) {
+        glm::vec3 toCenter = center - eye;
+        float along =
+            glm::dot(toCenter, glm::vec3(axisX[i], axisY[i], axisZ[i]));
+        visible = along < cutoff[i] * glm::length(toCenter) + radius[i];
+      }
+      if (visible)
+        mask |= 1 << lane;
+    }
+#endif
+
+    for (size_t lane = 0; lane < LANES; lane++) {
+      if (mask & (1 << lane))
+        addRange(firstIndex[block + lane], indexCount[block + lane],
+                 indexStride, baseOffset, rangeEnd);
+    }
+  }
+  return !counts.empty();
+}
+
+const std::vector<int> &ClusterCuller::getCounts() const { return counts; }
+
+const std::vector<const void *> &ClusterCuller::getOffsets() const {
+  return offsets;
+}
+
+size_t ClusterCuller::getVisibleCount() const { return visibleCount; }
+
+void ClusterCuller::addRange(uint32_t first, uint32_t count,
+                             size_t indexStride, size_t baseOffset,
+                             uint32_t &rangeEnd) {
+  if (!counts.empty() && first == rangeEnd) {
+    counts.back() += static_cast<int>(count);
+  } else {
+    counts.push_back(static_cast<int>(count));
+    offsets.push_back(reinterpret_cast<const void *>(
+        baseOffset + static_cast<uintptr_t>(first) * indexStride));
+  }
+  rangeEnd = first + count;
+  visibleCount++;
+}
@@ -0,0 +1,128 @@
+#include "CommandLine.h"
+#include "Logger.h"
+#include <cstdlib>
+#include <string>
+
+ArgumentResult parseEngineArgument(int argc, char *argv[], int &i,
+                                   EngineConfig &config) {
+  std::string argument(argv[i]);
+  bool hasValue = i + 1 < argc;
+
+  if (argument == "--headless" || argument == "--headless=sim") {
+    config.runMode = RunMode::HeadlessSimulation;
+  } else if (argument == "--headless=offscreen") {
+    config.runMode = RunMode::HeadlessOffscreen;
+  } else if (argument == "--size" && hasValue) {
+    if (std::sscanf(argv[++i], "%dx%d", &config.width, &config.height) != 2 ||
+        config.width <= 0 || config.height <= 0) {
+      Logger::engine->error("Invalid size '{}', expected WIDTHxHEIGHT.",
+                            argv[i]);
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument == "--pipelined") {
+    config.pipelinedRendering = true;
+  } else if (argument.rfind("--pacing=", 0) == 0) {
+    if (!FramePacer::parseMode(argument.c_str() + 9, config.pacingMode)) {
+      Logger::engine->error("Unknown pacing mode '{}'.", argument.substr(9));
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument == "--fps" && hasValue) {
+    config.targetFps = std::atof(argv[++i]);
+  } else if (argument == "--scene" && hasValue) {
+    config.scenePath = argv[++i];
+  } else if (argument == "--dt" && hasValue) {
+    config.fixedDeltaTime = static_cast<float>(std::atof(argv[++i]));
+  } else if (argument == "--record" && hasValue) {
+    config.recordInputPath = argv[++i];
+  } else if (argument == "--replay" && hasValue) {
+    config.replayInputPath = argv[++i];
+  } else if (argument == "--upload-budget" && hasValue) {
+    config.uploadBudgetMs = std::atof(argv[++i]);
+  } else if (argument.rfind("--vertex-layout=", 0) == 0) {
+    if (!Mesh::parseLayout(argument.c_str() + 16, config.vertexLayout)) {
+      Logger::engine->error("Unknown vertex layout '{}'.",
+                            argument.substr(16));
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument.rfind("--import-profile=", 0) == 0) {
+    if (!Model::parseImportProfile(argument.c_str() + 17,
+                                   config.importProfile)) {
+      Logger::engine->error("Unknown import profile '{}'.",
+                            argument.substr(17));
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument.rfind("--residency=", 0) == 0) {
+    if (!Model::parseResidency(argument.c_str() + 12,
+                               config.geometryResidency)) {
+      Logger::engine->error("Unknown residency '{}'.", argument.substr(12));
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument == "--merged-draws") {
+    config.mergedDraws = true;
+  } else if (argument == "--no-cluster-culling") {
+    config.clusterCulling = false;
+  } else if (argument == "--backface-culling") {
+    config.backfaceCulling = true;
+  } else if (argument == "--tick-rate" && hasValue) {
+    config.physicsStep.tickRate = static_cast<float>(std::atof(argv[++i]));
+    if (!(config.physicsStep.tickRate > 0.0f)) {
+      Logger::engine->error("Tick rate must be positive.");
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument == "--max-catchup-ticks" && hasValue) {
+    config.physicsStep.maxTicksPerFrame = std::atoi(argv[++i]);
+    if (config.physicsStep.maxTicksPerFrame < 1) {
+      Logger::engine->error("Catch-up budget must be at least one tick.");
+      return ArgumentResult::Invalid;
+    }
+  } else if (argument == "--deterministic") {
+    config.physicsStep.deterministic = true;
+  } else if (argument == "--lod-error" && hasValue) {
+    config.lodPixelError = static_cast<float>(std::atof(argv[++i]));
+  } else {
+    return ArgumentResult::Unknown;
+  }
+  return ArgumentResult::Parsed;
+}
+
+void printEngineUsage(FILE *file) {
+  std::fprintf(
+      file,
+      "  --headless[=sim|offscreen]  Run without a window. 'sim' (default)\n"
+      "                              runs physics and scene update only,\n"
+      "                              'offscreen' renders through EGL\n"
+      "  --size <width>x<height>     Window or offscreen framebuffer size\n"
+      "  --pipelined                 Submit GL work on a render thread\n"
+      "  --pacing=<mode>             Frame pacing: uncapped, capped, vsync\n"
+      "                              (default), adaptive or low-latency\n"
+      "  --fps <n>                   Target frame rate, defaults to the\n"
+      "                              display refresh rate\n"
+      "  --scene <file>              Load a scene description\n"
+      "  --dt <seconds>              Simulation step per frame, 0 (default)\n"
+      "                              uses the measured frame time\n"
+      "  --record <file>             Record input and frame times\n"
+      "  --replay <file>             Replay a recording frame by frame, its\n"
+      "                              frame times replace --dt\n"
+      "  --upload-budget <ms>        Stream scene models to the GPU within\n"
+      "                              this much time per frame\n"
+      "  --vertex-layout=<layout>    GPU vertex format of models: float\n"
+      "                              (default), compact or quantized\n"
+      "  --import-profile=<profile>  Assimp post-processing of models:\n"
+      "                              editor-fast or runtime-optimized\n"
+      "                              (default)\n"
+      "  --residency=<policy>        CPU geometry kept after upload: gpu\n"
+      "                              (default), positions or full\n"
+      "  --merged-draws              One buffer per model, drawn with\n"
+      "                              multi-draw indirect (GL 4.3)\n"
+      "  --no-cluster-culling        Draw whole meshes instead of the\n"
+      "                              meshlets inside the view\n"
+      "  --backface-culling          Cull back faces, on the GPU and per\n"
+      "                              meshlet\n"
+      "  --tick-rate <hz>            Physics ticks per second (default 60)\n"
+      "  --max-catchup-ticks <n>     Physics ticks a slow frame may catch\n"
+      "                              up on (default 5)\n"
+      "  --deterministic             One physics tick per frame whatever\n"
+      "                              the frame time\n"
+      "  --lod-error <pixels>        Screen-space error mesh LODs may show\n"
+      "                              (default 1), 0 draws full detail\n");
+}
@@ -1,14 +1,22 @@
 #include "ElementBuffer.h"
+#include <algorithm>
 #include <assimp/Importer.hpp>
+#include <cstdint>
 
 ElementBuffer::ElementBuffer(const GLuint *data, GLuint pCount)
-    : count(pCount) {
+    : count(pCount), type(chooseType(data, pCount)) {
   // ASSERT(sizeof(unsigned int) == sizeof(GLuint))
 
   glGenBuffers(1, &rendererID);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rendererID);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, pCount * sizeof(GLuint), data,
-               GL_STATIC_DRAW);
+  if (type == GL_UNSIGNED_INT) {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, pCount * sizeof(GLuint), data,
+                 GL_STATIC_DRAW);
+  } else {
+    std::vector<unsigned char> narrowed = narrow(data, pCount, type);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrowed.size(), narrowed.data(),
+                 GL_STATIC_DRAW);
+  }
 }
 
 ElementBuffer::~ElementBuffer() { glDeleteBuffers(1, &rendererID); }
@@ -20,3 +28,41 @@ void ElementBuffer::Bind() const {
 void ElementBuffer::Unbind() const { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
 
 GLuint ElementBuffer::getCount() const { return count; }
+
+GLenum ElementBuffer::getType() const { return type; }
+
+GLenum ElementBuffer::chooseType(const GLuint *data, size_t count) {
+  GLuint largest = count > 0 ? *std::max_element(data, data + count) : 0;
+  if (largest <= UINT8_MAX)
+    return GL_UNSIGNED_BYTE;
+  if (largest <= UINT16_MAX)
+    return GL_UNSIGNED_SHORT;
+  return GL_UNSIGNED_INT;
+}
+
+size_t ElementBuffer::getTypeSize(GLenum type) {
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    return sizeof(uint8_t);
+  case GL_UNSIGNED_SHORT:
+    return sizeof(uint16_t);
+  default:
+    return sizeof(uint32_t);
+  }
+}
+
+std::vector<unsigned char> ElementBuffer::narrow(const GLuint *data,
+                                                 size_t count, GLenum type) {
+  std::vector<unsigned char> narrowed(count * getTypeSize(type));
+  if (type == GL_UNSIGNED_BYTE) {
+    std::copy(data, data + count, narrowed.data());
+  } else if (type == GL_UNSIGNED_SHORT) {
+    uint16_t *shorts = reinterpret_cast<uint16_t *>(narrowed.data());
+    for (size_t i = 0; i < count; i++)
+      shorts[i] = static_cast<uint16_t>(data[i]);
+  } else {
+    std::copy(data, data + count,
+              reinterpret_cast<uint32_t *>(narrowed.data()));
+  }
+  return narrowed;
+}
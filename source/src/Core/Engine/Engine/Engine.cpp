@@ -1,18 +1,37 @@
 #include "Engine.h"
+#include "FrameArena.h"
+#include "GpuHeap.h"
+#include "GpuProfiler.h"
 #include "Logger.h"
+#include "ModelBatch.h"
 #include "Physics.h"
+#include "Profiler.h"
+#include "TextureRegistry.h"
 #include "UI.h"
 #include "backends/imgui_impl_sdl2.h"
 #include <SDL2/SDL.h>
 #include <SDL_events.h>
 #include <SDL_video.h>
+#include <chrono>
+#include <cstdint>
 #include <glad/glad.h>
 
 static UI *ui = UI::getInstance();
 static Physics *physics = Physics::getInstance();
 
+static constexpr float CLEAR_COLOR[4] = {0.141176f, 0.137255f, 0.137255f,
+                                         1.0f};
+
+static float getAspectRatio(int width, int height) {
+  return height > 0 ? static_cast<float>(width) / height : 1.0f;
+}
+
 // Constructors and Destructors
-Engine::Engine() : m_Window(nullptr) {
+Engine::Engine()
+    : m_Window(nullptr), m_GLContext(nullptr), m_Running(false),
+      m_DeltaTime(0.0f), m_WindowWidth(0), m_WindowHeight(0),
+      m_FrameCount(0), m_StartupFailed(false), m_TimeToFirstFrameMs(0.0),
+      m_SceneTime(0.0f), m_LastGpuFrameIndex(UINT64_MAX) {
   Logger::engine->info("Engine instance created.");
 }
 
@@ -29,7 +48,11 @@ Engine *Engine::getInstance() {
 }
 
 // Class Public Methods
-void Engine::run() {
+void Engine::run(const EngineConfig &config) {
+  m_Config = config;
+  m_StartupStart = std::chrono::steady_clock::now();
+  PROFILE_THREAD_NAME("Main");
+
   Logger::engine->info("Initializing shader game engine...");
   initEverything();
 
@@ -43,17 +66,200 @@ void Engine::run() {
   }
 }
 
+JobSystem &Engine::getJobSystem() { return m_JobSystem; }
+
+TaskGraph &Engine::getFrameGraph() { return m_FrameGraph; }
+
+TaskID Engine::getInputTask() const { return m_InputTask; }
+
+TaskID Engine::getUpdateTask() const { return m_UpdateTask; }
+
+TaskID Engine::getRenderTask() const { return m_RenderTask; }
+
+const std::vector<TaskTiming> &Engine::getFrameTaskTimings() const {
+  return m_FrameGraph.getTimings();
+}
+
+const std::vector<TaskTiming> &Engine::getStartupTimings() const {
+  return m_StartupGraph.getTimings();
+}
+
+double Engine::getTimeToFirstFrameMs() const { return m_TimeToFirstFrameMs; }
+
+Scene &Engine::getScene() { return m_Scene; }
+
+AssetStreamer &Engine::getAssetStreamer() { return m_AssetStreamer; }
+
+const std::vector<FrameSample> &Engine::getFrameSamples() const {
+  return m_FrameSamples;
+}
+
+const std::vector<double> &Engine::getGpuFrameSamples() const {
+  return m_GpuFrameSamples;
+}
+
 // Class Private Methods
 
 void Engine::initEverything() {
   Logger::engine->info("Initializing everything...");
 
-  setOpenGLAttributes();
+  if (m_Config.pipelinedRendering && m_Config.runMode != RunMode::Windowed) {
+    Logger::engine->warn("Pipelined rendering needs a window, ignoring it.");
+    m_Config.pipelinedRendering = false;
+  }
+
+  // Everything else runs as a task graph on the job system
+  if (!initJobSystem()) {
+    m_Running = false;
+    return;
+  }
+
+  buildStartupGraph();
+  m_StartupGraph.execute(m_JobSystem);
+  m_Running = !m_StartupFailed.load();
+  logStartupTrace();
+
+  // GL resources of the scene are created before the render thread takes
+  // the context
+  if (m_Running && m_Config.pipelinedRendering)
+    m_Running = initRenderThread();
+
+  buildFrameGraph();
+}
+
+void Engine::buildStartupGraph() {
+  Logger::engine->info("Building startup task graph...");
+
+  m_StartupGraph.clear();
+  m_StartupFailed = false;
+
+  // Steps are skipped once any step has failed
+  auto addStep = [this](const char *name, std::function<bool()> step,
+                        const std::vector<TaskID> &dependencies,
+                        TaskAffinity affinity = TaskAffinity::AnyThread) {
+    return m_StartupGraph.addTask(
+        name,
+        [this, step] {
+          if (!m_StartupFailed.load() && !step())
+            m_StartupFailed = true;
+        },
+        dependencies, affinity);
+  };
+  const TaskAffinity main = TaskAffinity::MainThread;
+  bool hasGL = m_Config.runMode != RunMode::HeadlessSimulation;
+  bool hasScene = !m_Config.scenePath.empty();
+
+  // Thread-safe work overlaps with SDL, window and GL context creation,
+  // which must stay on the main thread
+  TaskID physicsTask = addStep("Physics", [this] { return initPhysics(); }, {});
+  addStep("Frame Arena", [this] { return initFrameArena(); }, {});
+
+  // The streamer needs no GL until its first update, so scene models start
+  // importing while the window and context are created
+  TaskID streamerTask = 0;
+  if (hasGL)
+    streamerTask = addStep(
+        "Asset Streamer", [this] { return initAssetStreamer(); }, {});
+
+  TaskID sceneTask = 0;
+  TaskID streamTask = 0;
+  TaskID shaderSourceTask = 0;
+  if (hasScene) {
+    sceneTask = addStep("Scene", [this] { return loadScene(); }, {});
+    addStep(
+        "Rigid Bodies",
+        [this] {
+          m_Scene.createRigidBodies();
+          return true;
+        },
+        {physicsTask, sceneTask});
+    if (hasGL) {
+      streamTask = addStep(
+          "Scene Streaming",
+          [this] {
+            m_Scene.streamModels(m_AssetStreamer);
+            return true;
+          },
+          {sceneTask, streamerTask});
+      shaderSourceTask = addStep(
+          "Shader Source", [this] { return loadSceneShaderSource(); }, {});
+    }
+  }
 
-  m_Running = initSDL() && initWindow() && initOpenGLContext() && loadGLAD() &&
-              initUI() && initPhysics();
+  TaskID sdlTask = addStep("SDL", [this] { return initSDL(); }, {}, main);
+  TaskID contextTask = sdlTask;
+  switch (m_Config.runMode) {
+  case RunMode::Windowed: {
+    TaskID windowTask = addStep(
+        "Window",
+        [this] {
+          setOpenGLAttributes();
+          return initWindow();
+        },
+        {sdlTask}, main);
+    contextTask = addStep(
+        "GL Context", [this] { return initOpenGLContext(); }, {windowTask},
+        main);
+    break;
+  }
+  case RunMode::HeadlessSimulation:
+    Logger::engine->info("Running headless: simulation only.");
+    break;
+  case RunMode::HeadlessOffscreen:
+    Logger::engine->info("Running headless: offscreen rendering.");
+    contextTask = addStep(
+        "Offscreen Context", [this] { return initOffscreenContext(); },
+        {sdlTask}, main);
+    break;
+  }
+
+  addStep("Frame Pacer", [this] { return initFramePacer(); }, {contextTask},
+          main);
+  addStep("Input Recorder", [this] { return initInputRecorder(); },
+          {contextTask}, main);
+
+  if (hasGL) {
+    TaskID gladTask = addStep(
+        "GLAD",
+        [this] {
+          if (!loadGLAD())
+            return false;
+          if (m_Config.runMode == RunMode::HeadlessOffscreen &&
+              !m_OffscreenContext.createFramebuffer(m_WindowWidth,
+                                                    m_WindowHeight))
+            return false;
+          initGLViewPort();
+          return true;
+        },
+        {contextTask}, main);
+    addStep("UI", [this] { return initUI(); }, {gladTask}, main);
+
+    if (hasScene)
+      addStep("Scene Upload", [this] { return uploadScene(); },
+              {gladTask, streamTask, shaderSourceTask}, main);
+  }
+
+  Logger::engine->info("Successfully built startup task graph ({} steps).",
+                       m_StartupGraph.getTaskCount());
+}
 
-  initGLViewPort();
+void Engine::logStartupTrace() {
+  const std::vector<TaskTiming> &timings = m_StartupGraph.getTimings();
+
+  double serialMs = 0.0;
+  Logger::engine->info("Startup trace:");
+  for (const TaskTiming &timing : timings) {
+    serialMs += timing.durationMs;
+    Logger::engine->info(
+        "  {:<18} {:8.2f} ms -> {:8.2f} ms ({:7.2f} ms) on {}", timing.name,
+        timing.startMs, timing.startMs + timing.durationMs, timing.durationMs,
+        timing.workerIndex < 0 ? std::string("main")
+                               : "worker " +
+                                     std::to_string(timing.workerIndex));
+  }
+  Logger::engine->info("Startup graph took {:.2f} ms, {:.2f} ms of steps in "
+                       "total.",
+                       m_StartupGraph.getLastExecutionMs(), serialMs);
 }
 
 void Engine::setOpenGLAttributes() {
@@ -73,7 +279,12 @@ void Engine::setOpenGLAttributes() {
 
 bool Engine::initSDL() {
   Logger::engine->info("Initializing SDL...");
-  if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+
+  // Headless runs only need timers and events, which work without a display
+  Uint32 subsystems = m_Config.runMode == RunMode::Windowed
+                          ? SDL_INIT_EVERYTHING
+                          : SDL_INIT_TIMER | SDL_INIT_EVENTS;
+  if (SDL_Init(subsystems) < 0) {
     Logger::engine->error("Failed to initialize SDL: {}", SDL_GetError());
     return false;
   } else {
@@ -83,8 +294,8 @@ bool Engine::initSDL() {
 }
 
 bool Engine::initWindow() {
-  int initWindowWidth = 1600;
-  int initWindowHeight = 920;
+  int initWindowWidth = m_Config.width;
+  int initWindowHeight = m_Config.height;
 
   Logger::engine->info("Initializing window with dimension {}x{}...",
                        initWindowWidth, initWindowHeight);
@@ -116,32 +327,96 @@ bool Engine::initOpenGLContext() {
     return false;
   }
 
-  SDL_GL_SetSwapInterval(
-      0); // Disable VSync: allows rendering at uncapped FPS instead of syncing
-          // to monitor's refresh rate (e.g., 60Hz)
   Logger::engine->info("Successfully initialized SDL_GL context.");
   return true;
 }
 
+bool Engine::initFramePacer() {
+  Logger::engine->info("Initializing frame pacer...");
+
+  FramePacingMode mode = m_Config.pacingMode;
+  if (m_Config.runMode != RunMode::Windowed &&
+      (mode == FramePacingMode::VSync ||
+       mode == FramePacingMode::AdaptiveVSync)) {
+    // Nothing to sync to without a window, run as fast as possible
+    mode = m_Config.targetFps > 0.0 ? FramePacingMode::Capped
+                                    : FramePacingMode::Uncapped;
+  }
+
+  if (m_Window) {
+    SDL_DisplayMode displayMode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_Window),
+                                  &displayMode) == 0)
+      m_FramePacer.setDisplayRefreshRate(displayMode.refresh_rate);
+  }
+
+  m_FramePacer.configure(mode, m_Config.targetFps);
+  if (m_GLContext)
+    m_FramePacer.applySwapInterval();
+
+  Logger::engine->info("Successfully initialized frame pacer.");
+  return true;
+}
+
+bool Engine::initFrameArena() {
+  Logger::engine->info("Initializing frame arena...");
+
+  if (!FrameArena::getInstance()->init()) {
+    Logger::engine->error("Failed to initialize frame arena.");
+    return false;
+  }
+
+  Logger::engine->info("Successfully initialized frame arena.");
+  return true;
+}
+
+bool Engine::initOffscreenContext() {
+  Logger::engine->info("Initializing offscreen OpenGL context...");
+
+  if (!m_OffscreenContext.createContext()) {
+    Logger::engine->error("Failed to initialize offscreen OpenGL context.");
+    return false;
+  }
+
+  m_WindowWidth = m_Config.width;
+  m_WindowHeight = m_Config.height;
+  Logger::engine->info("Successfully initialized offscreen OpenGL context.");
+  return true;
+}
+
 bool Engine::loadGLAD() {
   Logger::engine->info("Loading GLAD...");
 
-  if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
+  GLADloadproc loader = m_Config.runMode == RunMode::HeadlessOffscreen
+                            ? (GLADloadproc)OffscreenContext::getProcAddress
+                            : (GLADloadproc)SDL_GL_GetProcAddress;
+  if (!gladLoadGLLoader(loader)) {
     Logger::engine->error("Failed to initialize GLAD.");
     return false;
   }
   Logger::engine->info("Successfully loaded GLAD.");
+  ModelBatch::loadFunctions(loader);
+  GpuHeap::getInstance()->setBlockSize(
+      static_cast<size_t>(m_Config.gpuHeapBlockMB * 1024.0 * 1024.0));
+
+#ifdef SHADER_ENGINE_PROFILING
+  // Optional, disables itself when timer queries are unsupported
+  GpuProfiler::getInstance()->init();
+#endif
   return true;
 }
 
 bool Engine::initUI() {
   Logger::engine->info("Initializing UI...");
 
-  bool initSuccess = ui->init(m_Window, m_GLContext);
+  bool initSuccess = m_Config.runMode == RunMode::HeadlessOffscreen
+                         ? ui->initHeadless(m_WindowWidth, m_WindowHeight)
+                         : ui->init(m_Window, m_GLContext);
   if (!initSuccess) {
     Logger::engine->warn("Failed to initialize UI.");
     return false;
   }
+  ui->setDrawStatsSource([this]() { return m_Scene.getDrawStats(); });
 
   Logger::engine->info("Successfully initialized UI.");
   return true;
@@ -150,74 +425,408 @@ bool Engine::initUI() {
 bool Engine::initPhysics() {
   Logger::engine->info("Initializing Physics...");
 
-  if (!physics->init()) {
+  if (!physics->init() || !physics->setStepSettings(m_Config.physicsStep)) {
+    Logger::engine->error("Failed to initialize Physics.");
     return false;
-    Logger::engine->info("Failed to initialize Physics.");
   }
 
   Logger::engine->info("Successfully initialized Physics.");
   return true;
 }
 
+bool Engine::initJobSystem() {
+  Logger::engine->info("Initializing job system...");
+
+  if (!m_JobSystem.init()) {
+    Logger::engine->error("Failed to initialize job system.");
+    return false;
+  }
+
+  Logger::engine->info("Successfully initialized job system.");
+  return true;
+}
+
+bool Engine::initRenderThread() {
+  Logger::engine->info("Initializing render thread...");
+
+  ui->prepareForRenderThread();
+
+  if (m_SceneShader) {
+    m_RenderThread.setSceneRenderer([this](const SceneView &view) {
+      m_Scene.draw(*m_SceneShader, view);
+    });
+  }
+  m_RenderThread.setUploader([this] {
+    m_AssetStreamer.update();
+    TextureRegistry::getInstance()->deleteReleased();
+    GpuHeap::getInstance()->compact(
+        static_cast<size_t>(m_Config.gpuHeapCompactMB * 1024.0 * 1024.0));
+  });
+
+  // Hand the context over; it can only be current on one thread at a time
+  SDL_GL_MakeCurrent(m_Window, nullptr);
+
+  if (!m_RenderThread.start(m_Window, m_GLContext)) {
+    Logger::engine->error("Failed to initialize render thread.");
+    SDL_GL_MakeCurrent(m_Window, m_GLContext);
+    return false;
+  }
+
+  Logger::engine->info("Successfully initialized render thread.");
+  return true;
+}
+
+bool Engine::loadScene() {
+  Logger::engine->info("Loading scene...");
+
+  m_Scene.setVertexLayout(m_Config.vertexLayout);
+  m_Scene.setImportProfile(m_Config.importProfile);
+  m_Scene.setGeometryResidency(m_Config.geometryResidency);
+  m_Scene.setMergedDraws(m_Config.mergedDraws);
+  m_Scene.setCulling(m_Config.clusterCulling, m_Config.backfaceCulling);
+  m_Scene.setLodPixelError(m_Config.lodPixelError);
+  if (!m_Scene.loadFromFile(m_Config.scenePath)) {
+    Logger::engine->error("Failed to load scene.");
+    return false;
+  }
+
+  m_SceneTime = 0.0f;
+  Logger::engine->info("Successfully loaded scene.");
+  return true;
+}
+
+bool Engine::loadSceneShaderSource() {
+  m_SceneShader = std::make_unique<Shader>();
+  m_SceneShader->loadSource(CMAKE_SOURCE_PATH "/shaders/main.glsl");
+  return true;
+}
+
+bool Engine::uploadScene() {
+  Logger::engine->info("Uploading scene to the GPU...");
+
+  m_SceneShader->compile();
+
+  if (m_Config.uploadBudgetMs > 0.0 || m_Config.uploadBudgetMB > 0.0) {
+    Logger::engine->info("Streaming the scene at {:.2f} ms and {:.2f} MB "
+                         "per frame.",
+                         m_Config.uploadBudgetMs, m_Config.uploadBudgetMB);
+    return true;
+  }
+
+  if (!m_AssetStreamer.flush()) {
+    Logger::engine->error("Failed to load every scene model.");
+    return false;
+  }
+
+  GeometryMemory memory = m_Scene.getGeometryMemory();
+  Logger::engine->info("Successfully uploaded scene: {:.2f} MB of geometry "
+                       "on the GPU, {:.2f} MB kept on the CPU, {:.2f} MB "
+                       "freed.",
+                       memory.gpuBytes / (1024.0 * 1024.0),
+                       memory.cpuBytes / (1024.0 * 1024.0),
+                       memory.releasedBytes / (1024.0 * 1024.0));
+  return true;
+}
+
+bool Engine::initAssetStreamer() {
+  if (!m_AssetStreamer.init(m_Config.uploadBudgetMs,
+                            m_Config.uploadBudgetMB)) {
+    Logger::engine->error("Failed to initialize asset streamer.");
+    return false;
+  }
+
+  ModelLoadSettings settings;
+  settings.vertexLayout = m_Config.vertexLayout;
+  settings.importProfile = m_Config.importProfile;
+  settings.residency = m_Config.geometryResidency;
+  settings.mergeMeshes = m_Config.mergedDraws;
+  m_AssetStreamer.setModelSettings(settings);
+  return true;
+}
+
+bool Engine::initInputRecorder() {
+  bool recording = !m_Config.recordInputPath.empty();
+  bool replaying = !m_Config.replayInputPath.empty();
+  if (!recording && !replaying)
+    return true;
+
+  Logger::engine->info("Initializing input recorder...");
+
+  if (recording && replaying) {
+    Logger::engine->error("Cannot record and replay input at the same time.");
+    return false;
+  }
+
+  bool started = replaying ? m_InputRecorder.startReplay(
+                                 m_Config.replayInputPath, m_Config.scenePath)
+                           : m_InputRecorder.startRecording(
+                                 m_Config.recordInputPath, m_Config.scenePath);
+  if (!started) {
+    Logger::engine->error("Failed to initialize input recorder.");
+    return false;
+  }
+
+  if (m_Window)
+    m_InputRecorder.setWindowID(SDL_GetWindowID(m_Window));
+
+  Logger::engine->info("Successfully initialized input recorder.");
+  return true;
+}
+
 void Engine::initGLViewPort() {
   Logger::engine->info("Initializing OpenGL viewport...");
   glViewport(0, 0, m_WindowWidth, m_WindowHeight);
   Logger::engine->info("Successfully initialized OpenGL viewport.");
 }
 
+void Engine::buildFrameGraph() {
+  Logger::engine->info("Building frame task graph...");
+
+  m_FrameGraph.clear();
+
+  // SDL event pumping, the ImGui frame and GL submission must stay on the
+  // thread that owns the window and context. Physics and the camera path
+  // run on workers next to each other while the main thread builds the UI
+  m_InputTask = m_FrameGraph.addTask(
+      "Input",
+      [this] {
+        handleInput();
+        // Every task of the frame steps by the same delta
+        calculateDeltaTime();
+        m_InputRecorder.recordFrame(m_DeltaTime);
+      },
+      {}, TaskAffinity::MainThread);
+  m_PhysicsTask = m_FrameGraph.addTask(
+      "Physics", [this] { physics->stepSimulation(m_DeltaTime); },
+      {m_InputTask});
+  m_CameraTask = m_FrameGraph.addTask(
+      "CameraPath", [this] { updateCameraPath(); }, {m_InputTask});
+  m_UpdateTask = m_FrameGraph.addTask("Update", [this] { update(); },
+                                      {m_PhysicsTask, m_CameraTask});
+
+  std::vector<TaskID> renderDependencies = {m_UpdateTask};
+  if (m_Config.runMode != RunMode::HeadlessSimulation) {
+    // Only reads profiler and allocator stats, never the simulation
+    m_UITask = m_FrameGraph.addTask(
+        "UI", [this] { buildUI(); }, {m_InputTask}, TaskAffinity::MainThread);
+    renderDependencies.push_back(m_UITask);
+  }
+  m_RenderTask = m_FrameGraph.addTask(
+      "Render",
+      [this] {
+        if (m_Config.runMode != RunMode::HeadlessSimulation)
+          render();
+      },
+      renderDependencies, TaskAffinity::MainThread);
+
+  Logger::engine->info("Successfully built frame task graph.");
+}
+
 void Engine::gameLoop() {
+  Uint64 loopStart = SDL_GetPerformanceCounter();
+  m_FrameCount = 0;
+  if (m_Config.collectFrameStats && m_Config.maxFrames > 0)
+    m_FrameSamples.reserve(m_Config.maxFrames);
+
   while (m_Running) {
-    handleInput();
-    update();
-    render();
+    if (m_Config.collectFrameStats &&
+        m_FrameCount == m_Config.statsWarmupFrames)
+      Profiler::getInstance()->resetTotals();
+
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    m_FramePacer.beginFrame();
+    m_FrameGraph.execute(m_JobSystem);
+    m_FramePacer.endFrame();
+    FrameArena::getInstance()->reset();
+    PROFILE_FRAME_MARK();
+
+    if (m_Config.collectFrameStats)
+      recordFrameSample(frameStart);
+
+    if (m_FrameCount == 0) {
+      m_TimeToFirstFrameMs =
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - m_StartupStart)
+              .count();
+      Logger::engine->info("Time to first frame: {:.2f} ms.",
+                           m_TimeToFirstFrameMs);
+    }
+
+    if (++m_FrameCount == m_Config.maxFrames) {
+      Logger::engine->info("Reached frame limit of {}.", m_Config.maxFrames);
+      m_Running = false;
+    }
   }
+
+  double elapsedMs = static_cast<double>(SDL_GetPerformanceCounter() -
+                                         loopStart) *
+                     1000.0 /
+                     static_cast<double>(SDL_GetPerformanceFrequency());
+  Logger::engine->info("Ran {} frames in {:.2f} ms ({:.3f} ms/frame).",
+                       m_FrameCount, elapsedMs,
+                       m_FrameCount > 0 ? elapsedMs / m_FrameCount : 0.0);
+
+  FramePacingStats pacing = m_FramePacer.getStats();
+  Logger::engine->info("Frame pacing ({}): target {:.2f} ms, average {:.2f} "
+                       "ms, jitter {:.2f} ms, worst deviation {:.2f} ms, {} "
+                       "missed of last {} frames.",
+                       FramePacer::getModeName(m_FramePacer.getMode()),
+                       pacing.targetMs, pacing.averageMs, pacing.jitterMs,
+                       pacing.worstDeviationMs, pacing.missedFrames,
+                       pacing.sampleCount);
   Logger::engine->info("Engine game loop terminated.");
   free();
 }
 
 void Engine::handleInput() {
+  PROFILE_FUNCTION();
+  bool replaying = m_InputRecorder.getMode() == InputRecorderMode::Replay;
+
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
-    if (event.type == SDL_QUIT ||
-        (event.type == SDL_WINDOWEVENT &&
-         event.window.event == SDL_WINDOWEVENT_CLOSE &&
-         event.window.windowID == SDL_GetWindowID(m_Window))) {
-      Logger::engine->info("Detected window close!");
+    // While replaying, live input is dropped except for quitting
+    if (replaying && event.type != SDL_QUIT &&
+        InputRecorder::isInputEvent(event))
+      continue;
+
+    m_InputRecorder.recordEvent(event);
+    processEvent(event);
+    if (!m_Running)
+      return;
+  }
+
+  if (replaying) {
+    if (!m_InputRecorder.nextFrame()) {
+      Logger::engine->info("Input replay finished.");
       m_Running = false;
       return;
     }
 
-    if (event.type == SDL_KEYDOWN) {
-      auto e_Key = event.key.keysym.sym;
-      if ((e_Key == SDLK_LALT && e_Key == SDLK_F4) ||
-          (e_Key == SDLK_RALT && e_Key == SDLK_F4)) {
-        m_Running = false;
+    for (SDL_Event &recordedEvent : m_InputRecorder.getFrameEvents()) {
+      processEvent(recordedEvent);
+      if (!m_Running)
         return;
-      }
     }
+  }
+
+  if (isSceneCameraControlled())
+    m_Scene.getCamera().update(m_Window != nullptr && !replaying);
+}
+
+void Engine::processEvent(SDL_Event &event) {
+  if (event.type == SDL_QUIT ||
+      (event.type == SDL_WINDOWEVENT &&
+       event.window.event == SDL_WINDOWEVENT_CLOSE &&
+       event.window.windowID == SDL_GetWindowID(m_Window))) {
+    Logger::engine->info("Detected window close!");
+    m_Running = false;
+    return;
+  }
 
-    if (event.type == SDL_WINDOWEVENT &&
-        event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-      m_WindowWidth = event.window.data1;
-      m_WindowHeight = event.window.data2;
+  if (event.type == SDL_KEYDOWN) {
+    auto e_Key = event.key.keysym.sym;
+    if ((e_Key == SDLK_LALT && e_Key == SDLK_F4) ||
+        (e_Key == SDLK_RALT && e_Key == SDLK_F4)) {
+      m_Running = false;
+      return;
     }
+  }
 
+  if (event.type == SDL_WINDOWEVENT &&
+      event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+    m_WindowWidth = event.window.data1;
+    m_WindowHeight = event.window.data2;
+  }
+
+  if (m_Config.runMode == RunMode::Windowed)
     ImGui_ImplSDL2_ProcessEvent(&event);
+
+  if (isSceneCameraControlled()) {
+    m_Scene.getCamera().processKeyboard(event, m_Window);
+    m_Scene.getCamera().processMouseMotion(event);
   }
 }
 
+bool Engine::isSceneCameraControlled() const {
+  return m_Scene.isLoaded() && m_Scene.getCameraPath().isEmpty();
+}
+
+// Scripted cameras do not touch physics, so this runs beside the step
+void Engine::updateCameraPath() {
+  PROFILE_FUNCTION();
+  if (!m_Scene.isLoaded())
+    return;
+
+  m_SceneTime += m_DeltaTime;
+  m_Scene.getCameraPath().apply(m_SceneTime, m_Scene.getCamera());
+}
+
+// Moves the scene models to their bodies, after the physics step
 void Engine::update() {
-  calculateDeltaTime();
-  physics->dynamicsWorld->stepSimulation(m_DeltaTime, 10);
+  PROFILE_FUNCTION();
+  if (m_Scene.isLoaded())
+    m_Scene.update();
+}
+
+void Engine::buildUI() {
+  PROFILE_FUNCTION();
+  // The previous frame's ImGui texture uploads must land before NewFrame
+  if (m_Config.pipelinedRendering)
+    m_RenderThread.waitForTextureSync();
+  ui->buildFrame();
 }
 
 void Engine::render() {
-  // TODO: gawin 'tong dynamic, pede siguro ilipat 'to sa ui
-  glClearColor(0.141176, 0.137255, 0.137255, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  PROFILE_FUNCTION();
+  if (m_Config.pipelinedRendering) {
+    RenderSnapshot &snapshot = m_RenderThread.acquireSnapshot();
+    snapshot.viewportWidth = m_WindowWidth;
+    snapshot.viewportHeight = m_WindowHeight;
+    for (int i = 0; i < 4; i++)
+      snapshot.clearColor[i] = CLEAR_COLOR[i];
+    snapshot.captureDrawData(ImGui::GetDrawData());
+
+    snapshot.hasScene = m_SceneShader != nullptr;
+    if (snapshot.hasScene)
+      m_Scene.captureView(m_Scene.getCamera(),
+                          getAspectRatio(m_WindowWidth, m_WindowHeight),
+                          m_WindowHeight, snapshot.sceneView);
+
+    m_RenderThread.publishSnapshot();
+    return;
+  }
 
-  ui->render();
-  SDL_GL_SwapWindow(m_Window);
+  if (m_Config.runMode == RunMode::HeadlessOffscreen)
+    m_OffscreenContext.bindFramebuffer();
+
+  m_AssetStreamer.update();
+  TextureRegistry::getInstance()->deleteReleased();
+  GpuHeap::getInstance()->compact(
+      static_cast<size_t>(m_Config.gpuHeapCompactMB * 1024.0 * 1024.0));
+
+  GPU_PROFILE_FRAME_BEGIN();
+  {
+    GPU_PROFILE_SCOPE("Scene");
+    // TODO: gawin 'tong dynamic, pede siguro ilipat 'to sa ui
+    glClearColor(CLEAR_COLOR[0], CLEAR_COLOR[1], CLEAR_COLOR[2],
+                 CLEAR_COLOR[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    if (m_SceneShader) {
+      m_Scene.captureView(m_Scene.getCamera(),
+                          getAspectRatio(m_WindowWidth, m_WindowHeight),
+                          m_WindowHeight, m_SceneView);
+      m_Scene.draw(*m_SceneShader, m_SceneView);
+    }
+  }
+
+  ui->submitFrame();
+  GPU_PROFILE_FRAME_END();
+
+  if (m_Config.runMode == RunMode::HeadlessOffscreen)
+    m_OffscreenContext.present();
+  else
+    SDL_GL_SwapWindow(m_Window);
 }
 
 void Engine::calculateDeltaTime() {
@@ -228,14 +837,62 @@ void Engine::calculateDeltaTime() {
                 static_cast<float>(SDL_GetPerformanceFrequency());
 
   lastCounter = currentCounter;
+
+  if (m_InputRecorder.getMode() == InputRecorderMode::Replay)
+    m_DeltaTime = m_InputRecorder.getFrameDeltaTime();
+  else if (m_Config.fixedDeltaTime > 0.0f)
+    m_DeltaTime = m_Config.fixedDeltaTime;
+}
+
+void Engine::recordFrameSample(Uint64 frameStart) {
+  const std::vector<TaskTiming> &timings = m_FrameGraph.getTimings();
+
+  FrameSample sample;
+  // Measured after the pacer's wait, so consecutive samples add up to the
+  // wall-clock time of the run
+  sample.frameMs = static_cast<double>(SDL_GetPerformanceCounter() -
+                                       frameStart) *
+                   1000.0 /
+                   static_cast<double>(SDL_GetPerformanceFrequency());
+  sample.cpuMs = m_FrameGraph.getLastExecutionMs();
+  sample.updateMs =
+      timings[m_PhysicsTask].durationMs + timings[m_UpdateTask].durationMs;
+  sample.renderMs = timings[m_RenderTask].durationMs;
+  m_FrameSamples.push_back(sample);
+
+  // GPU results trail by a few frames, take each one once it comes back
+  GpuFrameTiming gpuFrame = GpuProfiler::getInstance()->getLatestFrame();
+  if (!gpuFrame.passes.empty() && gpuFrame.frameIndex != m_LastGpuFrameIndex) {
+    m_LastGpuFrameIndex = gpuFrame.frameIndex;
+    m_GpuFrameSamples.push_back(gpuFrame.totalMs);
+  }
 }
 
 void Engine::free() {
   Logger::engine->info("Destroying engine resources...");
+  if (m_Config.pipelinedRendering) {
+    m_RenderThread.stop();
+    SDL_GL_MakeCurrent(m_Window, m_GLContext);
+  }
+  m_JobSystem.free();
+  m_InputRecorder.stop();
+  m_Scene.free();
+  m_AssetStreamer.free();
+  // Textures and geometry released by the models above, while the context
+  // still lives
+  TextureRegistry::getInstance()->deleteReleased();
+  GpuHeap::getInstance()->free();
   physics->free();
-  ui->free();
-  SDL_DestroyWindow(m_Window);
-  SDL_GL_DeleteContext(m_GLContext);
+  GpuProfiler::getInstance()->free();
+  m_SceneShader.reset();
+  if (m_Config.runMode != RunMode::HeadlessSimulation)
+    ui->free();
+  m_OffscreenContext.free();
+  FrameArena::getInstance()->free();
+  if (m_GLContext)
+    SDL_GL_DeleteContext(m_GLContext);
+  if (m_Window)
+    SDL_DestroyWindow(m_Window);
   SDL_Quit();
   Logger::engine->info("Successfully destroyed Shader game engine resources.");
 }
@@ -0,0 +1,91 @@
+#include "FrameArena.h"
+#include "Logger.h"
+#include <algorithm>
+#include <new>
+
+FrameArena::FrameArena()
+    : buffer(nullptr), capacity(0), offset(0), overflowBytes(0),
+      overflowAllocations(0), lastFrameBytes(0), lastFrameOverflowBytes(0),
+      highWaterBytes(0) {}
+
+FrameArena *FrameArena::getInstance() {
+  static FrameArena instance;
+  return &instance;
+}
+
+bool FrameArena::init(size_t capacity) {
+  Logger::frameArena->info("Initializing frame arena of {} KB...",
+                           capacity / 1024);
+
+  free();
+  buffer = static_cast<char *>(::operator new(
+      capacity, std::align_val_t(alignof(std::max_align_t)), std::nothrow));
+  if (!buffer) {
+    Logger::frameArena->error("Failed to allocate frame arena.");
+    return false;
+  }
+
+  this->capacity = capacity;
+  offset.store(0, std::memory_order_relaxed);
+  Logger::frameArena->info("Successfully initialized frame arena.");
+  return true;
+}
+
+void FrameArena::free() {
+  reset();
+  if (!buffer)
+    return;
+
+  Logger::frameArena->info(
+      "Destroying frame arena, high-water mark {} KB of {} KB, {} overflow "
+      "allocations.",
+      highWaterBytes / 1024, capacity / 1024, overflowAllocations);
+  ::operator delete(buffer, std::align_val_t(alignof(std::max_align_t)));
+  buffer = nullptr;
+  capacity = 0;
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+  size_t current = offset.load(std::memory_order_relaxed);
+  uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+
+  while (buffer) {
+    size_t aligned =
+        ((base + current + alignment - 1) & ~(uintptr_t(alignment) - 1)) -
+        base;
+    if (aligned + size > capacity)
+      break;
+    if (offset.compare_exchange_weak(current, aligned + size,
+                                     std::memory_order_relaxed))
+      return buffer + aligned;
+  }
+
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  void *memory = ::operator new(size, std::align_val_t(alignment));
+
+  std::lock_guard<std::mutex> lock(overflowMutex);
+  overflowBlocks.push_back(OverflowBlock{memory, alignment});
+  overflowBytes += size;
+  overflowAllocations++;
+  return memory;
+}
+
+void FrameArena::reset() {
+  std::lock_guard<std::mutex> lock(overflowMutex);
+
+  lastFrameBytes = offset.load(std::memory_order_relaxed);
+  lastFrameOverflowBytes = overflowBytes;
+  highWaterBytes = std::max(highWaterBytes, lastFrameBytes + overflowBytes);
+
+  for (const OverflowBlock &block : overflowBlocks)
+    ::operator delete(block.memory, std::align_val_t(block.alignment));
+  overflowBlocks.clear();
+  overflowBytes = 0;
+  offset.store(0, std::memory_order_relaxed);
+}
+
+FrameArenaStats FrameArena::getStats() const {
+  std::lock_guard<std::mutex> lock(overflowMutex);
+  return FrameArenaStats{capacity, lastFrameBytes, lastFrameOverflowBytes,
+                         highWaterBytes, overflowAllocations};
+}
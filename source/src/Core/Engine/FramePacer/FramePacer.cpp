@@ -0,0 +1,235 @@
+#include "FramePacer.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+// Extra time reserved before a low-latency deadline on top of the measured
+// frame work, absorbs frame-to-frame variance
+static constexpr double LOW_LATENCY_SAFETY_MS = 0.5;
+static constexpr double MISSED_FRAME_TOLERANCE_MS = 1.0;
+
+FramePacer::FramePacer()
+    : mode(FramePacingMode::Uncapped), targetFps(0.0), displayRefreshRate(0),
+      frequency(static_cast<double>(SDL_GetPerformanceFrequency())),
+      targetTicks(0), nextDeadline(0), frameBegin(0), lastFrameBegin(0),
+      workEstimateMs(0.0), spinThresholdMs(2.0),
+      frameTimes(HISTORY_SIZE, 0.0), historyIndex(0), historyCount(0) {
+#ifdef _WIN32
+  // Default scheduler granularity is ~15.6 ms, far too coarse for pacing
+  timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+  timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::configure(FramePacingMode mode, double targetFps) {
+  this->mode = mode;
+  this->targetFps = targetFps;
+  nextDeadline = 0;
+  lastFrameBegin = 0;
+  historyIndex = 0;
+  historyCount = 0;
+  updateTargetTicks();
+
+  Logger::framePacer->info("Frame pacing: {}, target {:.2f} ms.",
+                           getModeName(mode), getTargetMs());
+}
+
+void FramePacer::setDisplayRefreshRate(int refreshRate) {
+  displayRefreshRate = refreshRate;
+  updateTargetTicks();
+}
+
+void FramePacer::applySwapInterval() {
+  int interval = 0;
+  if (mode == FramePacingMode::VSync)
+    interval = 1;
+  else if (mode == FramePacingMode::AdaptiveVSync)
+    interval = -1;
+
+  if (SDL_GL_SetSwapInterval(interval) == 0) {
+    Logger::framePacer->info("Swap interval set to {}.", interval);
+    return;
+  }
+
+  if (interval == -1) {
+    Logger::framePacer->warn(
+        "Adaptive vsync unsupported ({}), falling back to vsync.",
+        SDL_GetError());
+    mode = FramePacingMode::VSync;
+    if (SDL_GL_SetSwapInterval(1) == 0)
+      return;
+  }
+
+  Logger::framePacer->warn("Failed to set swap interval {}: {}", interval,
+                           SDL_GetError());
+}
+
+void FramePacer::beginFrame() {
+  if (mode == FramePacingMode::LowLatency && targetTicks > 0) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (nextDeadline == 0)
+      nextDeadline = now + targetTicks;
+
+    // Start the frame as late as possible, so input is sampled right before
+    // the work that consumes it
+    Uint64 lead = static_cast<Uint64>(
+        (workEstimateMs + LOW_LATENCY_SAFETY_MS) * frequency / 1000.0);
+    if (nextDeadline > lead)
+      waitUntil(nextDeadline - lead);
+  }
+
+  frameBegin = SDL_GetPerformanceCounter();
+
+  if (lastFrameBegin != 0) {
+    frameTimes[historyIndex] = toMs(frameBegin - lastFrameBegin);
+    historyIndex = (historyIndex + 1) % HISTORY_SIZE;
+    historyCount = std::min(historyCount + 1, HISTORY_SIZE);
+  }
+  lastFrameBegin = frameBegin;
+}
+
+void FramePacer::endFrame() {
+  Uint64 now = SDL_GetPerformanceCounter();
+  workEstimateMs = workEstimateMs * 0.9 + toMs(now - frameBegin) * 0.1;
+
+  if (targetTicks == 0)
+    return;
+
+  if (nextDeadline == 0)
+    nextDeadline = frameBegin + targetTicks;
+
+  bool capAtEnd = mode == FramePacingMode::Capped ||
+                  ((mode == FramePacingMode::VSync ||
+                    mode == FramePacingMode::AdaptiveVSync) &&
+                   targetFps > 0.0);
+  if (capAtEnd)
+    waitUntil(nextDeadline);
+
+  // Resynchronise after a long hitch rather than rushing frames to catch up
+  now = SDL_GetPerformanceCounter();
+  nextDeadline += targetTicks;
+  if (nextDeadline < now)
+    nextDeadline = now + targetTicks;
+}
+
+FramePacingMode FramePacer::getMode() const { return mode; }
+
+double FramePacer::getTargetMs() const { return toMs(targetTicks); }
+
+FramePacingStats FramePacer::getStats() const {
+  FramePacingStats stats{};
+  stats.targetMs = getTargetMs();
+  stats.sampleCount = historyCount;
+  if (historyCount == 0)
+    return stats;
+
+  double sum = 0.0;
+  for (int i = 0; i < historyCount; i++)
+    sum += frameTimes[i];
+  stats.averageMs = sum / historyCount;
+
+  double variance = 0.0;
+  for (int i = 0; i < historyCount; i++) {
+    double frameTime = frameTimes[i];
+    variance += (frameTime - stats.averageMs) * (frameTime - stats.averageMs);
+
+    if (stats.targetMs > 0.0) {
+      double deviation = frameTime - stats.targetMs;
+      stats.averageDeviationMs += std::abs(deviation);
+      stats.worstDeviationMs =
+          std::max(stats.worstDeviationMs, std::abs(deviation));
+      if (deviation > MISSED_FRAME_TOLERANCE_MS)
+        stats.missedFrames++;
+    }
+  }
+  stats.jitterMs = std::sqrt(variance / historyCount);
+  stats.averageDeviationMs /= historyCount;
+
+  return stats;
+}
+
+const char *FramePacer::getModeName(FramePacingMode mode) {
+  switch (mode) {
+  case FramePacingMode::Uncapped:
+    return "uncapped";
+  case FramePacingMode::Capped:
+    return "capped";
+  case FramePacingMode::VSync:
+    return "vsync";
+  case FramePacingMode::AdaptiveVSync:
+    return "adaptive";
+  case FramePacingMode::LowLatency:
+    return "low-latency";
+  }
+  return "unknown";
+}
+
+bool FramePacer::parseMode(const char *name, FramePacingMode &mode) {
+  const FramePacingMode modes[] = {
+      FramePacingMode::Uncapped, FramePacingMode::Capped,
+      FramePacingMode::VSync, FramePacingMode::AdaptiveVSync,
+      FramePacingMode::LowLatency};
+
+  for (FramePacingMode candidate : modes) {
+    if (std::strcmp(name, getModeName(candidate)) == 0) {
+      mode = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FramePacer::updateTargetTicks() {
+  double fps = targetFps;
+  if (fps <= 0.0 && mode != FramePacingMode::Uncapped &&
+      mode != FramePacingMode::Capped)
+    fps = displayRefreshRate > 0 ? displayRefreshRate : 60.0;
+
+  targetTicks = fps > 0.0 ? static_cast<Uint64>(frequency / fps) : 0;
+}
+
+void FramePacer::waitUntil(Uint64 deadline) {
+  PROFILE_FUNCTION();
+
+  while (true) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= deadline)
+      return;
+
+    double remainingMs = toMs(deadline - now);
+    if (remainingMs <= spinThresholdMs) {
+      // Close to the deadline the OS scheduler is too coarse, spin instead
+      std::this_thread::yield();
+      continue;
+    }
+
+    double requestedMs = remainingMs - spinThresholdMs;
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(static_cast<long long>(requestedMs * 1000)));
+
+    // Track how much sleeps overshoot and keep that much time for spinning
+    double oversleptMs =
+        toMs(SDL_GetPerformanceCounter() - now) - requestedMs;
+    spinThresholdMs = std::clamp(
+        spinThresholdMs * 0.9 + (std::max(oversleptMs, 0.0) + 0.25) * 0.1,
+        0.25, 4.0);
+  }
+}
+
+double FramePacer::toMs(Uint64 ticks) const {
+  return static_cast<double>(ticks) * 1000.0 / frequency;
+}
@@ -0,0 +1,302 @@
+#include "GpuHeap.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <glad/glad.h>
+#include <iterator>
+
+static size_t alignSize(size_t size);
+
+GpuHeap::GpuHeap()
+    : blockSize(DEFAULT_BLOCK_SIZE), scratchBuffer(0), scratchSize(0),
+      movedBytes(0), stats{} {}
+
+GpuHeap *GpuHeap::getInstance() {
+  static GpuHeap instance;
+  return &instance;
+}
+
+void GpuHeap::setBlockSize(size_t bytes) { blockSize = alignSize(bytes); }
+
+GpuAllocation GpuHeap::allocate(const void *data, size_t size) {
+  if (size == 0)
+    return 0;
+
+  PROFILE_FUNCTION();
+
+  // First fit, lowest block and offset first, which keeps compaction short
+  size_t alignedSize = alignSize(size);
+  size_t blockIndex = blocks.size();
+  size_t offset = 0;
+  for (size_t i = 0; i < blocks.size() && blockIndex == blocks.size(); i++) {
+    if (!blocks[i].buffer)
+      continue;
+    for (const auto &range : blocks[i].freeRanges) {
+      if (range.second >= alignedSize) {
+        blockIndex = i;
+        offset = range.first;
+        break;
+      }
+    }
+  }
+  if (blockIndex == blocks.size())
+    blockIndex = createBlock(std::max(blockSize, alignedSize));
+
+  Block &block = blocks[blockIndex];
+  auto range = block.freeRanges.find(offset);
+  size_t rangeSize = range->second;
+  block.freeRanges.erase(range);
+  if (rangeSize > alignedSize)
+    block.freeRanges.emplace(offset + alignedSize, rangeSize - alignedSize);
+  block.usedBytes += alignedSize;
+
+  GpuAllocation allocation;
+  if (!freeSlots.empty()) {
+    allocation = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    slots.emplace_back();
+    allocation = static_cast<GpuAllocation>(slots.size());
+  }
+  slots[allocation - 1] = Slot{blockIndex, offset, alignedSize, true};
+  block.allocations[offset] = allocation;
+
+  if (data) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  publishStats();
+  return allocation;
+}
+
+void GpuHeap::release(GpuAllocation allocation) {
+  if (!findSlot(allocation))
+    return;
+
+  Slot &slot = slots[allocation - 1];
+  Block &block = blocks[slot.block];
+  block.allocations.erase(slot.offset);
+  block.usedBytes -= slot.size;
+  insertFreeRange(block, slot.offset, slot.size);
+  slot.live = false;
+  freeSlots.push_back(allocation);
+  publishStats();
+}
+
+void GpuHeap::update(GpuAllocation allocation, size_t offset,
+                     const void *data, size_t size) {
+  const Slot *slot = findSlot(allocation);
+  if (!slot || offset + size > slot->size) {
+    Logger::gpuHeap->warn("update(): {} bytes at {} do not fit allocation {}",
+                          size, offset, allocation);
+    return;
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, blocks[slot->block].buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, slot->offset + offset, size, data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+unsigned int GpuHeap::getBuffer(GpuAllocation allocation) const {
+  const Slot *slot = findSlot(allocation);
+  return slot ? blocks[slot->block].buffer : 0;
+}
+
+size_t GpuHeap::getOffset(GpuAllocation allocation) const {
+  const Slot *slot = findSlot(allocation);
+  return slot ? slot->offset : 0;
+}
+
+// Allocations only move within their block, so each block fills from the
+// front and its free space gathers in one range at the end
+void GpuHeap::compact(size_t maxBytes) {
+  if (maxBytes == 0)
+    return;
+
+  PROFILE_FUNCTION();
+
+  size_t moved = 0;
+  bool changed = false;
+  for (Block &block : blocks) {
+    while (block.buffer && moved < maxBytes && !block.freeRanges.empty()) {
+      auto gap = block.freeRanges.begin();
+      // Free ranges are never adjacent, so only the tail has no allocation
+      // after it
+      auto next = block.allocations.find(gap->first + gap->second);
+      if (next == block.allocations.end())
+        break;
+
+      Slot &slot = slots[next->second - 1];
+      moved += slot.size;
+      move(block, slot, gap->first);
+      changed = true;
+    }
+  }
+
+  size_t liveBlocks = 0;
+  for (const Block &block : blocks)
+    liveBlocks += block.buffer ? 1 : 0;
+  for (Block &block : blocks) {
+    if (liveBlocks > 1 && block.buffer && block.usedBytes == 0) {
+      deleteBlock(block);
+      liveBlocks--;
+      changed = true;
+    }
+  }
+
+  if (changed)
+    publishStats();
+}
+
+GpuHeapStats GpuHeap::getStats() const {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return stats;
+}
+
+void GpuHeap::free() {
+  if (blocks.empty() && !scratchBuffer)
+    return;
+
+  GpuHeapStats current = getStats();
+  Logger::gpuHeap->info("Destroying GPU heap, {} allocations left in {} "
+                        "blocks, {:.2f} MB moved by compaction",
+                        current.allocationCount, current.blockCount,
+                        current.movedBytes / (1024.0 * 1024.0));
+
+  for (Block &block : blocks) {
+    if (block.buffer)
+      deleteBlock(block);
+  }
+  if (scratchBuffer)
+    glDeleteBuffers(1, &scratchBuffer);
+  blocks.clear();
+  slots.clear();
+  freeSlots.clear();
+  scratchBuffer = 0;
+  scratchSize = 0;
+  movedBytes = 0;
+  publishStats();
+}
+
+const GpuHeap::Slot *GpuHeap::findSlot(GpuAllocation allocation) const {
+  if (allocation == 0 || allocation > slots.size() ||
+      !slots[allocation - 1].live)
+    return nullptr;
+  return &slots[allocation - 1];
+}
+
+size_t GpuHeap::createBlock(size_t size) {
+  size_t index = 0;
+  while (index < blocks.size() && blocks[index].buffer)
+    index++;
+  if (index == blocks.size())
+    blocks.emplace_back();
+
+  Block &block = blocks[index];
+  glGenBuffers(1, &block.buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  block.size = size;
+  block.usedBytes = 0;
+  block.freeRanges.clear();
+  block.freeRanges.emplace(0, size);
+  block.allocations.clear();
+
+  Logger::gpuHeap->info("Created block {} of {:.2f} MB", index,
+                        size / (1024.0 * 1024.0));
+  return index;
+}
+
+void GpuHeap::deleteBlock(Block &block) {
+  glDeleteBuffers(1, &block.buffer);
+  block.buffer = 0;
+  block.size = 0;
+  block.usedBytes = 0;
+  block.freeRanges.clear();
+  block.allocations.clear();
+}
+
+// Merges the range with the free ranges right before and after it
+void GpuHeap::insertFreeRange(Block &block, size_t offset, size_t size) {
+  auto next = block.freeRanges.lower_bound(offset);
+  if (next != block.freeRanges.end() && offset + size == next->first) {
+    size += next->second;
+    next = block.freeRanges.erase(next);
+  }
+  if (next != block.freeRanges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      previous->second += size;
+      return;
+    }
+  }
+  block.freeRanges.emplace_hint(next, offset, size);
+}
+
+// Moves the allocation down into the free range at offset, which ends
+// where the allocation starts. glCopyBufferSubData rejects overlapping
+// ranges of one buffer, so larger allocations than the gap go through the
+// scratch buffer
+void GpuHeap::move(Block &block, Slot &slot, size_t offset) {
+  size_t source = slot.offset;
+  size_t gapSize = source - offset;
+
+  if (slot.size <= gapSize) {
+    glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source,
+                        offset, slot.size);
+  } else {
+    if (scratchSize < slot.size) {
+      if (!scratchBuffer)
+        glGenBuffers(1, &scratchBuffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+      glBufferData(GL_COPY_WRITE_BUFFER, slot.size, nullptr, GL_STREAM_COPY);
+      scratchSize = slot.size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, block.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, 0,
+                        slot.size);
+    glBindBuffer(GL_COPY_READ_BUFFER, scratchBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset,
+                        slot.size);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  GpuAllocation allocation = block.allocations[source];
+  block.allocations.erase(source);
+  block.allocations[offset] = allocation;
+  block.freeRanges.erase(offset);
+  insertFreeRange(block, offset + slot.size, gapSize);
+  slot.offset = offset;
+  movedBytes += slot.size;
+}
+
+void GpuHeap::publishStats() {
+  GpuHeapStats current{};
+  for (const Block &block : blocks) {
+    if (!block.buffer)
+      continue;
+    current.blockCount++;
+    current.reservedBytes += block.size;
+    current.usedBytes += block.usedBytes;
+    current.allocationCount += block.allocations.size();
+    current.freeRangeCount += block.freeRanges.size();
+    for (const auto &range : block.freeRanges)
+      current.largestFreeBytes =
+          std::max(current.largestFreeBytes, range.second);
+  }
+  current.movedBytes = movedBytes;
+
+  std::lock_guard<std::mutex> lock(statsMutex);
+  stats = current;
+}
+
+static size_t alignSize(size_t size) {
+  return (size + GpuHeap::ALIGNMENT - 1) & ~(GpuHeap::ALIGNMENT - 1);
+}
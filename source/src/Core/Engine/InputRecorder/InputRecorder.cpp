@@ -0,0 +1,310 @@
+#include "InputRecorder.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr char MAGIC[4] = {'S', 'E', 'I', 'R'};
+
+template <typename T> static void writeValue(std::ofstream &stream, T value) {
+  stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> static bool readValue(std::ifstream &stream, T &value) {
+  return static_cast<bool>(
+      stream.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+InputRecorder::InputRecorder()
+    : mode(InputRecorderMode::Off), frameDeltaTime(0.0f), frameCount(0),
+      windowID(0) {}
+
+InputRecorder::~InputRecorder() { stop(); }
+
+bool InputRecorder::startRecording(const std::string &path,
+                                   const std::string &scenePath) {
+  Logger::inputRecorder->info("Recording input to {}...", path);
+
+  stop();
+  output.open(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    Logger::inputRecorder->error("Failed to open input recording: {}", path);
+    return false;
+  }
+
+  output.write(MAGIC, sizeof(MAGIC));
+  writeValue<uint32_t>(output, VERSION);
+  writeValue<uint32_t>(output, static_cast<uint32_t>(scenePath.size()));
+  output.write(scenePath.data(), scenePath.size());
+
+  this->path = path;
+  mode = InputRecorderMode::Record;
+  frameEvents.clear();
+  frameCount = 0;
+  return true;
+}
+
+bool InputRecorder::startReplay(const std::string &path,
+                                const std::string &scenePath) {
+  Logger::inputRecorder->info("Replaying input from {}...", path);
+
+  stop();
+  input.open(path, std::ios::binary);
+  if (!input) {
+    Logger::inputRecorder->error("Failed to open input recording: {}", path);
+    return false;
+  }
+
+  char magic[sizeof(MAGIC)];
+  uint32_t version = 0;
+  uint32_t scenePathLength = 0;
+  if (!input.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      !readValue(input, version) || !readValue(input, scenePathLength)) {
+    Logger::inputRecorder->error("Not an input recording: {}", path);
+    input.close();
+    return false;
+  }
+  if (version != VERSION) {
+    Logger::inputRecorder->error(
+        "Input recording version {} unsupported, expected {}.", version,
+        VERSION);
+    input.close();
+    return false;
+  }
+
+  std::string recordedScenePath(scenePathLength, '\0');
+  input.read(&recordedScenePath[0], scenePathLength);
+  if (recordedScenePath != scenePath)
+    Logger::inputRecorder->warn(
+        "Recording was made with scene '{}', replaying with '{}'.",
+        recordedScenePath, scenePath);
+
+  this->path = path;
+  mode = InputRecorderMode::Replay;
+  frameEvents.clear();
+  frameCount = 0;
+  return true;
+}
+
+void InputRecorder::stop() {
+  if (mode == InputRecorderMode::Off)
+    return;
+
+  if (mode == InputRecorderMode::Record) {
+    output.close();
+    Logger::inputRecorder->info("Recorded {} frames of input to {}.",
+                                frameCount, path);
+  } else {
+    input.close();
+    Logger::inputRecorder->info("Replayed {} frames of input from {}.",
+                                frameCount, path);
+  }
+  mode = InputRecorderMode::Off;
+}
+
+InputRecorderMode InputRecorder::getMode() const { return mode; }
+
+uint64_t InputRecorder::getFrameCount() const { return frameCount; }
+
+void InputRecorder::recordEvent(const SDL_Event &event) {
+  if (mode == InputRecorderMode::Record && isInputEvent(event))
+    frameEvents.push_back(event);
+}
+
+void InputRecorder::recordFrame(float deltaTime) {
+  if (mode != InputRecorderMode::Record)
+    return;
+
+  // Events past the 16-bit count are rare enough to carry to the next frame
+  size_t count = std::min<size_t>(frameEvents.size(), UINT16_MAX);
+  writeValue<float>(output, deltaTime);
+  writeValue<uint16_t>(output, static_cast<uint16_t>(count));
+  for (size_t i = 0; i < count; i++)
+    writeEvent(frameEvents[i]);
+  frameEvents.erase(frameEvents.begin(), frameEvents.begin() + count);
+
+  if (!output) {
+    Logger::inputRecorder->error("Failed to write input recording: {}", path);
+    stop();
+    return;
+  }
+  frameCount++;
+}
+
+bool InputRecorder::nextFrame() {
+  if (mode != InputRecorderMode::Replay)
+    return false;
+
+  frameEvents.clear();
+  uint16_t count = 0;
+  if (!readValue(input, frameDeltaTime) || !readValue(input, count)) {
+    stop();
+    return false;
+  }
+
+  frameEvents.resize(count);
+  for (SDL_Event &event : frameEvents) {
+    if (!readEvent(event)) {
+      Logger::inputRecorder->error("Input recording truncated at frame {}.",
+                                   frameCount);
+      frameEvents.clear();
+      stop();
+      return false;
+    }
+  }
+
+  frameCount++;
+  return true;
+}
+
+std::vector<SDL_Event> &InputRecorder::getFrameEvents() {
+  return frameEvents;
+}
+
+float InputRecorder::getFrameDeltaTime() const { return frameDeltaTime; }
+
+void InputRecorder::setWindowID(Uint32 windowID) { this->windowID = windowID; }
+
+bool InputRecorder::isInputEvent(const SDL_Event &event) {
+  switch (event.type) {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+  case SDL_TEXTINPUT:
+  case SDL_MOUSEMOTION:
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+  case SDL_MOUSEWHEEL:
+  case SDL_QUIT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void InputRecorder::writeEvent(const SDL_Event &event) {
+  writeValue<uint32_t>(output, event.type);
+  writeValue<uint32_t>(output, event.common.timestamp);
+
+  switch (event.type) {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+    writeValue<uint8_t>(output, event.key.repeat);
+    writeValue<int32_t>(output, event.key.keysym.scancode);
+    writeValue<int32_t>(output, event.key.keysym.sym);
+    writeValue<uint16_t>(output, event.key.keysym.mod);
+    break;
+  case SDL_TEXTINPUT: {
+    uint8_t length = static_cast<uint8_t>(
+        strnlen(event.text.text, SDL_TEXTINPUTEVENT_TEXT_SIZE));
+    writeValue<uint8_t>(output, length);
+    output.write(event.text.text, length);
+    break;
+  }
+  case SDL_MOUSEMOTION:
+    writeValue<uint32_t>(output, event.motion.state);
+    writeValue<int32_t>(output, event.motion.x);
+    writeValue<int32_t>(output, event.motion.y);
+    writeValue<int32_t>(output, event.motion.xrel);
+    writeValue<int32_t>(output, event.motion.yrel);
+    break;
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+    writeValue<uint8_t>(output, event.button.button);
+    writeValue<uint8_t>(output, event.button.clicks);
+    writeValue<int32_t>(output, event.button.x);
+    writeValue<int32_t>(output, event.button.y);
+    break;
+  case SDL_MOUSEWHEEL:
+    writeValue<int32_t>(output, event.wheel.x);
+    writeValue<int32_t>(output, event.wheel.y);
+    writeValue<uint32_t>(output, event.wheel.direction);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    writeValue<float>(output, event.wheel.preciseX);
+    writeValue<float>(output, event.wheel.preciseY);
+#else
+    writeValue<float>(output, static_cast<float>(event.wheel.x));
+    writeValue<float>(output, static_cast<float>(event.wheel.y));
+#endif
+    break;
+  default:
+    break;
+  }
+}
+
+bool InputRecorder::readEvent(SDL_Event &event) {
+  std::memset(&event, 0, sizeof(event));
+
+  uint32_t type = 0;
+  uint32_t timestamp = 0;
+  if (!readValue(input, type) || !readValue(input, timestamp))
+    return false;
+  event.type = type;
+  event.common.timestamp = timestamp;
+
+  switch (type) {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP: {
+    int32_t scancode = 0;
+    int32_t sym = 0;
+    uint16_t mod = 0;
+    readValue(input, event.key.repeat);
+    readValue(input, scancode);
+    readValue(input, sym);
+    readValue(input, mod);
+    event.key.windowID = windowID;
+    event.key.state = type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+    event.key.keysym.scancode = static_cast<SDL_Scancode>(scancode);
+    event.key.keysym.sym = static_cast<SDL_Keycode>(sym);
+    event.key.keysym.mod = mod;
+    break;
+  }
+  case SDL_TEXTINPUT: {
+    uint8_t length = 0;
+    readValue(input, length);
+    if (length >= SDL_TEXTINPUTEVENT_TEXT_SIZE)
+      return false;
+    input.read(event.text.text, length);
+    event.text.windowID = windowID;
+    break;
+  }
+  case SDL_MOUSEMOTION:
+    readValue(input, event.motion.state);
+    readValue(input, event.motion.x);
+    readValue(input, event.motion.y);
+    readValue(input, event.motion.xrel);
+    readValue(input, event.motion.yrel);
+    event.motion.windowID = windowID;
+    break;
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+    readValue(input, event.button.button);
+    readValue(input, event.button.clicks);
+    readValue(input, event.button.x);
+    readValue(input, event.button.y);
+    event.button.windowID = windowID;
+    event.button.state =
+        type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+    break;
+  case SDL_MOUSEWHEEL: {
+    float preciseX = 0.0f;
+    float preciseY = 0.0f;
+    readValue(input, event.wheel.x);
+    readValue(input, event.wheel.y);
+    readValue(input, event.wheel.direction);
+    readValue(input, preciseX);
+    readValue(input, preciseY);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    event.wheel.preciseX = preciseX;
+    event.wheel.preciseY = preciseY;
+#endif
+    event.wheel.windowID = windowID;
+    break;
+  }
+  case SDL_QUIT:
+    break;
+  default:
+    return false;
+  }
+
+  return static_cast<bool>(input);
+}
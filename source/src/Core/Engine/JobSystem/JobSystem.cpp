@@ -0,0 +1,204 @@
+#include "JobSystem.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+
+static thread_local int currentWorkerIndex = -1;
+// Job system owning the calling worker, so several job systems can coexist
+static thread_local const JobSystem *currentJobSystem = nullptr;
+
+JobSystem::JobSystem() : running(false), queuedJobs(0) {}
+
+JobSystem::~JobSystem() { free(); }
+
+bool JobSystem::init(unsigned int workerCount, const std::string &name) {
+  if (running) {
+    Logger::jobSystem->warn("init(): Job system already running.");
+    return true;
+  }
+
+  if (workerCount == 0) {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+  }
+
+  Logger::jobSystem->info("Initializing job system with {} workers...",
+                          workerCount);
+
+  queues.clear();
+  for (unsigned int i = 0; i < workerCount + 1; i++)
+    queues.push_back(std::make_unique<WorkQueue>());
+
+  // Never shrunk: the profiler keeps pointers to these names
+  while (workerNames.size() < workerCount)
+    workerNames.push_back(name + " " + std::to_string(workerNames.size()));
+
+  running = true;
+  queuedJobs = 0;
+
+  for (unsigned int i = 0; i < workerCount; i++)
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+
+  Logger::jobSystem->info("Successfully initialized job system.");
+  return true;
+}
+
+void JobSystem::free() {
+  if (!running)
+    return;
+
+  Logger::jobSystem->info("Stopping job system workers...");
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    running = false;
+  }
+  sleepCondition.notify_all();
+
+  for (std::thread &worker : workers)
+    worker.join();
+  workers.clear();
+  queues.clear();
+  Logger::jobSystem->info("Successfully stopped job system workers.");
+}
+
+void JobSystem::submit(Job job, JobCounter *counter) {
+  if (counter)
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+  if (queues.empty()) {
+    // Not initialized, run inline so callers still make progress
+    QueuedJob inlineJob{std::move(job), counter};
+    execute(inlineJob);
+    return;
+  }
+
+  int localIndex = getLocalWorkerIndex();
+  unsigned int index = localIndex >= 0
+                           ? static_cast<unsigned int>(localIndex)
+                           : static_cast<unsigned int>(queues.size() - 1);
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->jobs.push_back({std::move(job), counter});
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    queuedJobs.fetch_add(1, std::memory_order_release);
+  }
+  sleepCondition.notify_one();
+}
+
+void JobSystem::wait(const JobCounter &counter) {
+  while (counter.pending.load(std::memory_order_acquire) > 0) {
+    if (!runPendingJob())
+      std::this_thread::yield();
+  }
+}
+
+void JobSystem::parallelFor(
+    size_t count, size_t grainSize,
+    const std::function<void(size_t begin, size_t end)> &fn) {
+  if (count == 0)
+    return;
+
+  grainSize = std::max<size_t>(grainSize, 1);
+
+  JobCounter counter;
+  for (size_t begin = 0; begin < count; begin += grainSize) {
+    size_t end = std::min(begin + grainSize, count);
+    submit([&fn, begin, end] { fn(begin, end); }, &counter);
+  }
+  wait(counter);
+}
+
+bool JobSystem::runPendingJob() {
+  QueuedJob queuedJob;
+  if (!findJob(getLocalWorkerIndex(), queuedJob))
+    return false;
+
+  execute(queuedJob);
+  return true;
+}
+
+unsigned int JobSystem::getWorkerCount() const {
+  return static_cast<unsigned int>(workers.size());
+}
+
+int JobSystem::getCurrentWorkerIndex() { return currentWorkerIndex; }
+
+int JobSystem::getLocalWorkerIndex() const {
+  return currentJobSystem == this ? currentWorkerIndex : -1;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+  currentWorkerIndex = static_cast<int>(index);
+  currentJobSystem = this;
+  PROFILE_THREAD_NAME(workerNames[index].c_str());
+
+  while (true) {
+    QueuedJob queuedJob;
+    if (findJob(static_cast<int>(index), queuedJob)) {
+      execute(queuedJob);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepCondition.wait(lock, [this] {
+      return !running || queuedJobs.load(std::memory_order_acquire) > 0;
+    });
+
+    if (!running)
+      break;
+  }
+
+  currentWorkerIndex = -1;
+  currentJobSystem = nullptr;
+}
+
+bool JobSystem::popLocal(unsigned int index, QueuedJob &out) {
+  WorkQueue &queue = *queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty())
+    return false;
+
+  out = std::move(queue.jobs.back());
+  queue.jobs.pop_back();
+  return true;
+}
+
+bool JobSystem::steal(unsigned int thief, QueuedJob &out) {
+  const unsigned int queueCount = static_cast<unsigned int>(queues.size());
+
+  for (unsigned int offset = 1; offset <= queueCount; offset++) {
+    WorkQueue &victim = *queues[(thief + offset) % queueCount];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || victim.jobs.empty())
+      continue;
+
+    out = std::move(victim.jobs.front());
+    victim.jobs.pop_front();
+    return true;
+  }
+  return false;
+}
+
+bool JobSystem::findJob(int index, QueuedJob &out) {
+  if (queues.empty() || queuedJobs.load(std::memory_order_acquire) <= 0)
+    return false;
+
+  unsigned int own = index >= 0 ? static_cast<unsigned int>(index)
+                                : static_cast<unsigned int>(queues.size() - 1);
+
+  if (popLocal(own, out) || steal(own, out)) {
+    queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+  }
+  return false;
+}
+
+void JobSystem::execute(QueuedJob &queuedJob) {
+  queuedJob.job();
+
+  if (queuedJob.counter)
+    queuedJob.counter->pending.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,147 @@
+#include "TaskGraph.h"
+#include "JobSystem.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+TaskGraph::TaskGraph()
+    : pendingCapacity(0), lastExecutionMs(0.0), remainingTasks(0) {}
+
+TaskID TaskGraph::addTask(const std::string &name,
+                          std::function<void()> function,
+                          const std::vector<TaskID> &dependencies,
+                          TaskAffinity affinity) {
+  TaskID id = static_cast<TaskID>(tasks.size());
+  tasks.push_back({name, std::move(function), affinity, {}, 0});
+
+  for (TaskID dependency : dependencies) {
+    if (dependency >= id) {
+      Logger::jobSystem->error(
+          "addTask(): Task '{}' depends on unknown task {}, ignoring.", name,
+          dependency);
+      continue;
+    }
+    tasks[dependency].dependents.push_back(id);
+    tasks[id].dependencyCount++;
+  }
+
+  return id;
+}
+
+void TaskGraph::clear() {
+  tasks.clear();
+  timings.clear();
+}
+
+void TaskGraph::execute(JobSystem &jobSystem) {
+  if (tasks.empty())
+    return;
+
+  if (pendingCapacity < tasks.size()) {
+    pendingCapacity = tasks.size();
+    pendingDependencies =
+        std::make_unique<std::atomic<int>[]>(pendingCapacity);
+  }
+
+  timings.resize(tasks.size());
+  for (size_t i = 0; i < tasks.size(); i++)
+    pendingDependencies[i].store(tasks[i].dependencyCount,
+                                 std::memory_order_relaxed);
+
+  remainingTasks.store(static_cast<int>(tasks.size()));
+  executionStart = std::chrono::steady_clock::now();
+
+  for (TaskID id = 0; id < tasks.size(); id++) {
+    if (tasks[id].dependencyCount == 0)
+      schedule(id, jobSystem);
+  }
+
+  // The calling thread runs main-thread tasks and helps with worker jobs
+  // until the whole graph has drained
+  while (remainingTasks.load(std::memory_order_acquire) > 0) {
+    TaskID mainTask = 0;
+    bool hasMainTask = false;
+    {
+      std::lock_guard<std::mutex> lock(mainQueueMutex);
+      if (!mainQueue.empty()) {
+        mainTask = mainQueue.front();
+        mainQueue.pop_front();
+        hasMainTask = true;
+      }
+    }
+
+    if (hasMainTask) {
+      runTask(mainTask, jobSystem);
+      continue;
+    }
+
+    if (jobSystem.runPendingJob())
+      continue;
+
+    std::unique_lock<std::mutex> lock(mainQueueMutex);
+    mainQueueCondition.wait_for(lock, std::chrono::microseconds(200), [this] {
+      return !mainQueue.empty() ||
+             remainingTasks.load(std::memory_order_acquire) == 0;
+    });
+  }
+  // The loop may have seen zero without the lock; taking it waits for the
+  // last worker to leave runTask()
+  { std::lock_guard<std::mutex> lock(mainQueueMutex); }
+
+  lastExecutionMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - executionStart)
+                        .count();
+}
+
+size_t TaskGraph::getTaskCount() const { return tasks.size(); }
+
+const std::vector<TaskTiming> &TaskGraph::getTimings() const {
+  return timings;
+}
+
+double TaskGraph::getLastExecutionMs() const { return lastExecutionMs; }
+
+void TaskGraph::schedule(TaskID id, JobSystem &jobSystem) {
+  if (tasks[id].affinity == TaskAffinity::MainThread) {
+    {
+      std::lock_guard<std::mutex> lock(mainQueueMutex);
+      mainQueue.push_back(id);
+    }
+    mainQueueCondition.notify_one();
+    return;
+  }
+
+  jobSystem.submit([this, id, &jobSystem] { runTask(id, jobSystem); });
+}
+
+void TaskGraph::runTask(TaskID id, JobSystem &jobSystem) {
+  Task &task = tasks[id];
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    PROFILE_SCOPE(task.name.c_str());
+    task.function();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  // Each task only ever writes its own slot, no locking required
+  TaskTiming &timing = timings[id];
+  timing.name = task.name;
+  timing.startMs =
+      std::chrono::duration<double, std::milli>(start - executionStart)
+          .count();
+  timing.durationMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  timing.workerIndex = JobSystem::getCurrentWorkerIndex();
+
+  for (TaskID dependent : task.dependents) {
+    if (pendingDependencies[dependent].fetch_sub(
+            1, std::memory_order_acq_rel) == 1)
+      schedule(dependent, jobSystem);
+  }
+
+  // Notified under the lock: once execute() sees zero, the graph may be
+  // destroyed, so the last task must be done touching it by then
+  std::lock_guard<std::mutex> lock(mainQueueMutex);
+  remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+  mainQueueCondition.notify_one();
+}
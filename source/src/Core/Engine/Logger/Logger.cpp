@@ -3,32 +3,63 @@
 #include <spdlog/spdlog.h>
 
 namespace Logger {
+std::shared_ptr<spdlog::logger> assetStreamer;
 std::shared_ptr<spdlog::logger> camera;
 std::shared_ptr<spdlog::logger> elementBuffer;
 std::shared_ptr<spdlog::logger> engine;
+std::shared_ptr<spdlog::logger> frameArena;
+std::shared_ptr<spdlog::logger> framePacer;
+std::shared_ptr<spdlog::logger> gpuHeap;
+std::shared_ptr<spdlog::logger> inputRecorder;
+std::shared_ptr<spdlog::logger> jobSystem;
 std::shared_ptr<spdlog::logger> mesh;
+std::shared_ptr<spdlog::logger> meshCache;
 std::shared_ptr<spdlog::logger> model;
+std::shared_ptr<spdlog::logger> modelBatch;
+std::shared_ptr<spdlog::logger> offscreenContext;
 std::shared_ptr<spdlog::logger> physics;
+std::shared_ptr<spdlog::logger> profiler;
+std::shared_ptr<spdlog::logger> renderThread;
 std::shared_ptr<spdlog::logger> rigidBody;
+std::shared_ptr<spdlog::logger> scene;
 std::shared_ptr<spdlog::logger> shader;
 std::shared_ptr<spdlog::logger> texture2D;
+std::shared_ptr<spdlog::logger> textureRegistry;
 std::shared_ptr<spdlog::logger> ui;
 std::shared_ptr<spdlog::logger> vertexArray;
 std::shared_ptr<spdlog::logger> vertexBuffer;
 
-void init() {
-  camera = spdlog::stdout_color_mt("Camera");
-  elementBuffer = spdlog::stdout_color_mt("ElementBuffer");
-  engine = spdlog::stdout_color_mt("Engine");
-  mesh = spdlog::stdout_color_mt("Mesh");
-  model = spdlog::stdout_color_mt("Model");
-  physics = spdlog::stdout_color_mt("Physics");
-  rigidBody = spdlog::stdout_color_mt("RigidBody");
-  shader = spdlog::stdout_color_mt("Shader");
-  texture2D = spdlog::stdout_color_mt("Texture2D");
-  ui = spdlog::stdout_color_mt("UI");
-  vertexArray = spdlog::stdout_color_mt("VertexArray");
-  vertexBuffer = spdlog::stdout_color_mt("VertexBuffer");
+void init(bool toStderr) {
+  auto create = [toStderr](const std::string &name) {
+    return toStderr ? spdlog::stderr_color_mt(name)
+                    : spdlog::stdout_color_mt(name);
+  };
+
+  assetStreamer = create("AssetStreamer");
+  camera = create("Camera");
+  elementBuffer = create("ElementBuffer");
+  engine = create("Engine");
+  frameArena = create("FrameArena");
+  framePacer = create("FramePacer");
+  gpuHeap = create("GpuHeap");
+  inputRecorder = create("InputRecorder");
+  jobSystem = create("JobSystem");
+  mesh = create("Mesh");
+  meshCache = create("MeshCache");
+  model = create("Model");
+  modelBatch = create("ModelBatch");
+  offscreenContext = create("OffscreenContext");
+  physics = create("Physics");
+  profiler = create("Profiler");
+  renderThread = create("RenderThread");
+  rigidBody = create("RigidBody");
+  scene = create("Scene");
+  shader = create("Shader");
+  texture2D = create("Texture2D");
+  textureRegistry = create("TextureRegistry");
+  ui = create("UI");
+  vertexArray = create("VertexArray");
+  vertexBuffer = create("VertexBuffer");
 
   spdlog::set_default_logger(engine);
 
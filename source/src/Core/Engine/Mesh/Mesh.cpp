@@ -1,99 +1,585 @@
 #include "Mesh.h"
+#include "ElementBuffer.h"
+#include "GpuHeap.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include "Shader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <glm/ext/matrix_float4x4.hpp>
+#include <glm/gtc/packing.hpp>
+#include <utility>
+
+static glm::vec2 encodeOctahedral(const glm::vec3 &vector);
+static glm::vec3 decodeOctahedral(const glm::vec2 &encoded);
+static void packAttributes(const Vertex &vertex, int16_t normal[2],
+                           int16_t tangent[2], uint16_t texCoords[2]);
+static void unpackAttributes(const int16_t normal[2],
+                             const int16_t tangent[2],
+                             const uint16_t texCoords[2], Vertex &vertex);
+static int16_t toSnorm16(float value);
+static uint16_t toUnorm16(float value);
+
+// A coarser level is only taken once its error is this much below the
+// limit, so a mesh resting near a switch distance does not flicker
+static constexpr float LOD_HYSTERESIS = 0.25f;
+
+Mesh::Mesh()
+    : transform(glm::mat4(1.0f)), vertexLayout(VertexLayout::Float),
+      positionOffset(0.0f), positionScale(1.0f), boundsCenter(0.0f),
+      boundsRadius(0.0f), vao(0), vertexAllocation(0), indexAllocation(0),
+      vertexOffset(0), indexCount(0),
+      indexType(GL_UNSIGNED_INT), uploaded(false), currentLod(0) {}
 
 Mesh::Mesh(std::vector<Vertex> verts, std::vector<unsigned int> inds,
            std::vector<Texture> texs)
-    : vertices(verts), indices(inds), textures(texs),
-      transform(glm::mat4(1.0f)) {
-  setupMesh();
+    : vertices(std::move(verts)), indices(std::move(inds)),
+      textures(std::move(texs)),
+      transform(glm::mat4(1.0f)), vertexLayout(VertexLayout::Float),
+      positionOffset(0.0f), positionScale(1.0f), boundsCenter(0.0f),
+      boundsRadius(0.0f), vao(0), vertexAllocation(0), indexAllocation(0),
+      vertexOffset(0), indexCount(0),
+      indexType(GL_UNSIGNED_INT), uploaded(false), currentLod(0) {
+  upload();
 }
 
-void Mesh::setupMesh() {
-  glGenVertexArrays(1, &vao);
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &ebo);
+Mesh::~Mesh() { free(); }
 
-  glBindVertexArray(vao);
+Mesh::Mesh(Mesh &&other) noexcept : Mesh() { *this = std::move(other); }
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept {
+  if (this == &other)
+    return *this;
+
+  free();
+  vertices = std::move(other.vertices);
+  indices = std::move(other.indices);
+  textures = std::move(other.textures);
+  transform = other.transform;
+  vertexLayout = other.vertexLayout;
+  positionOffset = other.positionOffset;
+  positionScale = other.positionScale;
+  packedVertices = std::move(other.packedVertices);
+  meshlets = std::move(other.meshlets);
+  lods = std::move(other.lods);
+  boundsCenter = other.boundsCenter;
+  boundsRadius = other.boundsRadius;
+  // The GL objects change hands, other no longer frees them
+  vao = std::exchange(other.vao, 0);
+  vertexAllocation = std::exchange(other.vertexAllocation, 0);
+  indexAllocation = std::exchange(other.indexAllocation, 0);
+  vertexOffset = other.vertexOffset;
+  indexCount = std::exchange(other.indexCount, 0);
+  indexType = other.indexType;
+  uploaded = std::exchange(other.uploaded, false);
+  clusterCuller = std::move(other.clusterCuller);
+  currentLod = other.currentLod;
+  textureUniforms = std::move(other.textureUniforms);
+  return *this;
+}
+
+void Mesh::pack() {
+  packedVertices.clear();
+  positionOffset = glm::vec3(0.0f);
+  positionScale = glm::vec3(1.0f);
+  if (vertexLayout == VertexLayout::Float || vertices.empty())
+    return;
+
+  PROFILE_FUNCTION();
+
+  if (vertexLayout == VertexLayout::CompactQuantized) {
+    glm::vec3 minimum = vertices[0].Position;
+    glm::vec3 maximum = vertices[0].Position;
+    for (const Vertex &vertex : vertices) {
+      minimum = glm::min(minimum, vertex.Position);
+      maximum = glm::max(maximum, vertex.Position);
+    }
+    positionOffset = minimum;
+    positionScale = maximum - minimum;
+  }
+
+  size_t stride = getVertexStride();
+  packedVertices.resize(vertices.size() * stride);
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const Vertex &vertex = vertices[i];
+    unsigned char *destination = packedVertices.data() + i * stride;
+
+    if (vertexLayout == VertexLayout::Compact) {
+      CompactVertex packed;
+      packed.Position[0] = vertex.Position.x;
+      packed.Position[1] = vertex.Position.y;
+      packed.Position[2] = vertex.Position.z;
+      packAttributes(vertex, packed.Normal, packed.Tangent, packed.TexCoords);
+      std::memcpy(destination, &packed, sizeof(packed));
+    } else {
+      QuantizedVertex packed;
+      for (int axis = 0; axis < 3; axis++) {
+        // Flat axes keep a zero scale and decode to the offset
+        float extent = positionScale[axis];
+        float position = vertex.Position[axis] - positionOffset[axis];
+        packed.Position[axis] =
+            toUnorm16(extent > 0.0f ? position / extent : 0.0f);
+      }
+      packed.Position[3] = 0;
+      packAttributes(vertex, packed.Normal, packed.Tangent, packed.TexCoords);
+      std::memcpy(destination, &packed, sizeof(packed));
+    }
+  }
+}
+
+void Mesh::unpack(const void *vertexData, size_t vertexCount) {
+  vertices.resize(vertexCount);
+  if (vertexLayout == VertexLayout::Float) {
+    std::memcpy(vertices.data(), vertexData, vertexCount * sizeof(Vertex));
+    return;
+  }
+
+  PROFILE_FUNCTION();
+
+  size_t stride = getVertexStride();
+  for (size_t i = 0; i < vertexCount; i++) {
+    const unsigned char *source =
+        static_cast<const unsigned char *>(vertexData) + i * stride;
+    Vertex &vertex = vertices[i];
+
+    if (vertexLayout == VertexLayout::Compact) {
+      CompactVertex packed;
+      std::memcpy(&packed, source, sizeof(packed));
+      vertex.Position = glm::vec3(packed.Position[0], packed.Position[1],
+                                  packed.Position[2]);
+      unpackAttributes(packed.Normal, packed.Tangent, packed.TexCoords,
+                       vertex);
+    } else {
+      QuantizedVertex packed;
+      std::memcpy(&packed, source, sizeof(packed));
+      glm::vec3 position(packed.Position[0], packed.Position[1],
+                         packed.Position[2]);
+      vertex.Position = positionOffset + position / 65535.0f * positionScale;
+      unpackAttributes(packed.Normal, packed.Tangent, packed.TexCoords,
+                       vertex);
+    }
+  }
+}
+
+void Mesh::upload() {
+  if (uploaded)
+    return;
+
+  if (vertexLayout == VertexLayout::Float) {
+    upload(vertices.data(), vertices.size(), indices.data(), indices.size());
+    return;
+  }
+
+  if (packedVertices.empty())
+    pack();
+  upload(packedVertices.data(), vertices.size(), indices.data(),
+         indices.size());
+  // Only the GPU copy is drawn, vertices stay for CPU-side users
+  packedVertices.clear();
+  packedVertices.shrink_to_fit();
+}
+
+void Mesh::upload(const void *vertexData, size_t vertexCount,
+                  const unsigned int *indexData, size_t indexCount) {
+  if (uploaded)
+    return;
+
+  setupMesh(vertexData, vertexCount, indexData, indexCount);
+  attach(indexType, indexCount);
+}
+
+void Mesh::attach(unsigned int indexType, size_t indexCount) {
+  if (uploaded)
+    return;
+
+  this->indexType = indexType;
+  this->indexCount = indexCount;
+  setupTextureUniforms();
+  clusterCuller.build(meshlets);
+  uploaded = true;
+}
+
+bool Mesh::isUploaded() const { return uploaded; }
+
+void Mesh::free() {
+  if (vao)
+    glDeleteVertexArrays(1, &vao);
+  GpuHeap *heap = GpuHeap::getInstance();
+  heap->release(vertexAllocation);
+  heap->release(indexAllocation);
+  vao = 0;
+  vertexAllocation = indexAllocation = 0;
+  vertexOffset = 0;
+  indexCount = 0;
+  uploaded = false;
+}
+
+void Mesh::releaseGeometry() {
+  std::vector<Vertex>().swap(vertices);
+  std::vector<unsigned int>().swap(indices);
+  std::vector<unsigned char>().swap(packedVertices);
+}
+
+size_t Mesh::getVertexStride() const { return getVertexStride(vertexLayout); }
+
+size_t Mesh::getIndexStride() const {
+  return ElementBuffer::getTypeSize(indexType);
+}
+
+void Mesh::setupMesh(const void *vertexData, size_t vertexCount,
+                     const unsigned int *indexData, size_t indexCount) {
+  this->indexCount = indexCount;
+  GpuHeap *heap = GpuHeap::getInstance();
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  if (!vertices.empty())
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 vertices.data(), GL_STATIC_DRAW);
+  if (vertexCount > 0)
+    vertexAllocation =
+        heap->allocate(vertexData, vertexCount * getVertexStride());
   else
     Logger::mesh->warn("setupMesh(): No vertex data found!");
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-  if (!indices.empty())
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 indices.data(), GL_STATIC_DRAW);
-  else
+  // Most submeshes fit 8 or 16-bit indices, which halve index memory and
+  // bandwidth or better
+  indexType = ElementBuffer::chooseType(indexData, indexCount);
+  if (indexCount == 0) {
     Logger::mesh->warn("setupMesh(): No index data found!");
+  } else if (indexType == GL_UNSIGNED_INT) {
+    indexAllocation =
+        heap->allocate(indexData, indexCount * sizeof(unsigned int));
+  } else {
+    std::vector<unsigned char> narrowed =
+        ElementBuffer::narrow(indexData, indexCount, indexType);
+    indexAllocation = heap->allocate(narrowed.data(), narrowed.size());
+  }
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  bindGeometry();
+  glBindVertexArray(0);
+}
+
+void Mesh::bindGeometry() {
+  GpuHeap *heap = GpuHeap::getInstance();
+  vertexOffset = heap->getOffset(vertexAllocation);
+  glBindBuffer(GL_ARRAY_BUFFER, heap->getBuffer(vertexAllocation));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, heap->getBuffer(indexAllocation));
+  // Core profile rejects attribute offsets without a buffer
+  if (vertexAllocation)
+    setupAttributes(vertexLayout, vertexOffset);
+}
+
+void Mesh::setupAttributes(VertexLayout layout, size_t baseOffset) {
+  size_t stride = getVertexStride(layout);
+  if (layout == VertexLayout::Compact) {
+    setupCompactAttributes(GL_FLOAT, GL_FALSE, stride, baseOffset,
+                           offsetof(CompactVertex, Normal),
+                           offsetof(CompactVertex, TexCoords),
+                           offsetof(CompactVertex, Tangent));
+    return;
+  }
+  if (layout == VertexLayout::CompactQuantized) {
+    setupCompactAttributes(GL_UNSIGNED_SHORT, GL_TRUE, stride, baseOffset,
+                           offsetof(QuantizedVertex, Normal),
+                           offsetof(QuantizedVertex, TexCoords),
+                           offsetof(QuantizedVertex, Tangent));
+    return;
+  }
 
   // Position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)baseOffset);
   glEnableVertexAttribArray(0);
   // Normal
   glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, Normal));
+                        (void *)(baseOffset + offsetof(Vertex, Normal)));
   glEnableVertexAttribArray(1);
   // TexCoords
   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, TexCoords));
+                        (void *)(baseOffset + offsetof(Vertex, TexCoords)));
   glEnableVertexAttribArray(2);
   // Tangent
   glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, Tangent));
+                        (void *)(baseOffset + offsetof(Vertex, Tangent)));
   glEnableVertexAttribArray(3);
   // Bitangent
   glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (void *)offsetof(Vertex, Bitangent));
+                        (void *)(baseOffset + offsetof(Vertex, Bitangent)));
   glEnableVertexAttribArray(4);
-
-  glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader &shader, const glm::mat4 &transform,
-                const glm::vec3 &ambient, const float &shininess) {
-  if (indices.empty()) {
-    Logger::mesh->warn("Draw(): No index data found.");
-    return;
-  }
+// Normals and tangents are two snorm16 each, decoded in the vertex shader;
+// the bitangent is rebuilt from them, so location 4 stays disabled
+void Mesh::setupCompactAttributes(unsigned int positionType,
+                                  unsigned char positionNormalized,
+                                  size_t stride, size_t baseOffset,
+                                  size_t normalOffset,
+                                  size_t texCoordsOffset,
+                                  size_t tangentOffset) {
+  GLsizei size = static_cast<GLsizei>(stride);
+  // Position
+  glVertexAttribPointer(0, 3, positionType, positionNormalized, size,
+                        (void *)baseOffset);
+  glEnableVertexAttribArray(0);
+  // Normal
+  glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, size,
+                        (void *)(baseOffset + normalOffset));
+  glEnableVertexAttribArray(1);
+  // TexCoords
+  glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, size,
+                        (void *)(baseOffset + texCoordsOffset));
+  glEnableVertexAttribArray(2);
+  // Tangent
+  glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, size,
+                        (void *)(baseOffset + tangentOffset));
+  glEnableVertexAttribArray(3);
+}
 
+void Mesh::setupTextureUniforms() {
   int diffuseNum = 0;
   int specularNum = 0;
-  // Binds all the textures to their own texture units and sets the respective
-  // uniforms in the fragment shader
-  for (int i = 0; i < textures.size(); ++i) {
-    glActiveTexture(GL_TEXTURE0 + i);
+
+  textureUniforms.clear();
+  textureUniforms.reserve(textures.size());
+  for (const Texture &texture : textures) {
     std::string number;
-    std::string name = textures[i].type;
+    const std::string &name = texture.type;
     if (name == "texture_diffuse")
       number = std::to_string(++diffuseNum);
     else if (name == "texture_specular")
       number = std::to_string(++specularNum);
-    shader.setInt("material." + name + number, i);
-    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    textureUniforms.push_back("material." + name + number);
+  }
+}
+
+void Mesh::Draw(Shader &shader, const glm::mat4 &transform,
+                const glm::vec3 &ambient, const float &shininess,
+                const CullView *cullView, const LodView *lodView) {
+  // Still streaming in, or drawn by the ModelBatch holding its geometry
+  if (!uploaded || !vao)
+    return;
+
+  if (indexCount == 0) {
+    Logger::mesh->warn("Draw(): No index data found.");
+    return;
   }
 
   glm::mat4 transformedMesh = transform * this->transform;
+  bool clustered;
+  size_t firstIndex;
+  size_t drawCount;
+  // Nothing is bound for a mesh that is entirely culled
+  if (!selectDraw(transformedMesh, cullView, lodView, clustered, firstIndex,
+                  drawCount))
+    return;
+
+  bindTextures(shader);
   shader.setMat4("u_Model", transformedMesh);
+  shader.setInt("u_VertexLayout", static_cast<int>(vertexLayout));
+  shader.setVec3("u_PositionOffset", positionOffset);
+  shader.setVec3("u_PositionScale", positionScale);
   shader.setVec3("material.ambient", ambient);
   shader.setFloat("material.shininess", shininess);
 
   // Draws the mesh
   glBindVertexArray(vao);
-  glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+  // Compaction moved the vertices since the VAO was set up
+  if (GpuHeap::getInstance()->getOffset(vertexAllocation) != vertexOffset)
+    bindGeometry();
+  if (clustered) {
+    const std::vector<int> &counts = clusterCuller.getCounts();
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), indexType,
+                        clusterCuller.getOffsets().data(),
+                        static_cast<GLsizei>(counts.size()));
+  } else {
+    size_t indexOffset = GpuHeap::getInstance()->getOffset(indexAllocation);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(drawCount), indexType,
+                   reinterpret_cast<const void *>(
+                       indexOffset + firstIndex * getIndexStride()));
+  }
   glBindVertexArray(0);
   // Resets the active texture unit
   glActiveTexture(GL_TEXTURE0);
 }
 
+bool Mesh::selectDraw(const glm::mat4 &model, const CullView *cullView,
+                      const LodView *lodView, bool &clustered,
+                      size_t &firstIndex, size_t &drawCount) {
+  size_t lod = lodView ? selectLod(model, *lodView) : 0;
+  firstIndex = lods.empty() ? 0 : lods[lod].firstIndex;
+  drawCount = lods.empty() ? indexCount : lods[lod].indexCount;
+
+  clustered = lod == 0 && cullView && !clusterCuller.isEmpty();
+  // Ranges are offsets into the heap block, 0 based for batched meshes
+  return !clustered ||
+         clusterCuller.cull(model, *cullView, getIndexStride(),
+                            GpuHeap::getInstance()->getOffset(indexAllocation));
+}
+
+const ClusterCuller &Mesh::getClusterCuller() const { return clusterCuller; }
+
+// Binds all the textures to their own texture units and sets the respective
+// uniforms in the fragment shader
+void Mesh::bindTextures(Shader &shader) const {
+  for (int i = 0; i < textures.size(); ++i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    shader.setInt(textureUniforms[i], i);
+    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+  }
+}
+
+size_t Mesh::getCurrentLod() const { return currentLod; }
+
+// Projected error is the level's model-space error scaled by the largest
+// axis scale and divided by the distance to the bounding sphere
+size_t Mesh::selectLod(const glm::mat4 &model, const LodView &view) {
+  if (lods.size() < 2)
+    return 0;
+
+  float scale = std::max(glm::length(glm::vec3(model[0])),
+                         std::max(glm::length(glm::vec3(model[1])),
+                                  glm::length(glm::vec3(model[2]))));
+  glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+  float distance = glm::length(center - view.position) - boundsRadius * scale;
+  // Inside the bounds every simplification may be right in front of the eye
+  if (distance <= 0.0f) {
+    currentLod = 0;
+    return currentLod;
+  }
+
+  float pixelsPerUnit = scale * view.pixelScale / distance;
+  auto fits = [&](size_t lod, float maxPixelError) {
+    return lods[lod].error * pixelsPerUnit <= maxPixelError;
+  };
+
+  // Finer levels are taken at once, coarser ones only past the hysteresis
+  if (currentLod >= lods.size())
+    currentLod = 0;
+  while (currentLod > 0 && !fits(currentLod, view.maxPixelError))
+    currentLod--;
+  while (currentLod + 1 < lods.size() &&
+         fits(currentLod + 1, view.maxPixelError * (1.0f - LOD_HYSTERESIS)))
+    currentLod++;
+  return currentLod;
+}
+
 // Optionally remove this, only used for soft body physics
 void Mesh::updateVertices(const std::vector<float> &newVertices) {
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, newVertices.size() * sizeof(float),
-                  newVertices.data());
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (vertexLayout != VertexLayout::Float) {
+    Logger::mesh->warn("updateVertices(): Only float vertices can be updated.");
+    return;
+  }
+
+  GpuHeap::getInstance()->update(vertexAllocation, 0, newVertices.data(),
+                                 newVertices.size() * sizeof(float));
+}
+
+size_t Mesh::getVertexStride(VertexLayout layout) {
+  switch (layout) {
+  case VertexLayout::Float:
+    return sizeof(Vertex);
+  case VertexLayout::Compact:
+    return sizeof(CompactVertex);
+  case VertexLayout::CompactQuantized:
+    return sizeof(QuantizedVertex);
+  }
+  return 0;
+}
+
+const char *Mesh::getLayoutName(VertexLayout layout) {
+  switch (layout) {
+  case VertexLayout::Float:
+    return "float";
+  case VertexLayout::Compact:
+    return "compact";
+  case VertexLayout::CompactQuantized:
+    return "quantized";
+  }
+  return "unknown";
+}
+
+bool Mesh::parseLayout(const char *name, VertexLayout &layout) {
+  const VertexLayout layouts[] = {VertexLayout::Float, VertexLayout::Compact,
+                                  VertexLayout::CompactQuantized};
+
+  for (VertexLayout candidate : layouts) {
+    if (std::strcmp(name, getLayoutName(candidate)) == 0) {
+      layout = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Projects onto the octahedron and folds the lower half over the upper, see
+// decodeOctahedral() in main.glsl
+static glm::vec2 encodeOctahedral(const glm::vec3 &vector) {
+  float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+  if (length == 0.0f)
+    return glm::vec2(0.0f);
+
+  glm::vec3 projected = vector / length;
+  if (projected.z >= 0.0f)
+    return glm::vec2(projected.x, projected.y);
+  return glm::vec2(
+      (1.0f - std::abs(projected.y)) * (projected.x >= 0.0f ? 1.0f : -1.0f),
+      (1.0f - std::abs(projected.x)) * (projected.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// Same as decodeOctahedral() in main.glsl
+static glm::vec3 decodeOctahedral(const glm::vec2 &encoded) {
+  glm::vec3 vector(encoded.x, encoded.y,
+                   1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  float fold = std::max(-vector.z, 0.0f);
+  vector.x += vector.x >= 0.0f ? -fold : fold;
+  vector.y += vector.y >= 0.0f ? -fold : fold;
+  return glm::normalize(vector);
+}
+
+// The bitangent sign lives in the sign of the tangent's second component,
+// which is remapped from [-1, 1] to (0, 1] first and loses one bit for it
+static void packAttributes(const Vertex &vertex, int16_t normal[2],
+                           int16_t tangent[2], uint16_t texCoords[2]) {
+  glm::vec2 encodedNormal = encodeOctahedral(vertex.Normal);
+  normal[0] = toSnorm16(encodedNormal.x);
+  normal[1] = toSnorm16(encodedNormal.y);
+
+  glm::vec2 encodedTangent = encodeOctahedral(vertex.Tangent);
+  float bitangentSign =
+      glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) <
+              0.0f
+          ? -1.0f
+          : 1.0f;
+  tangent[0] = toSnorm16(encodedTangent.x);
+  tangent[1] = toSnorm16(
+      bitangentSign *
+      std::max(encodedTangent.y * 0.5f + 0.5f, 1.0f / 32767.0f));
+
+  texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+  texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+}
+
+static void unpackAttributes(const int16_t normal[2],
+                             const int16_t tangent[2],
+                             const uint16_t texCoords[2], Vertex &vertex) {
+  vertex.Normal = decodeOctahedral(glm::vec2(normal[0], normal[1]) / 32767.0f);
+
+  float tangentY = tangent[1] / 32767.0f;
+  float bitangentSign = tangentY < 0.0f ? -1.0f : 1.0f;
+  vertex.Tangent = decodeOctahedral(glm::vec2(
+      tangent[0] / 32767.0f, std::abs(tangentY) * 2.0f - 1.0f));
+  vertex.Bitangent =
+      bitangentSign * glm::cross(vertex.Normal, vertex.Tangent);
+
+  vertex.TexCoords = glm::vec2(glm::unpackHalf1x16(texCoords[0]),
+                               glm::unpackHalf1x16(texCoords[1]));
+}
+
+static int16_t toSnorm16(float value) {
+  return static_cast<int16_t>(
+      std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint16_t toUnorm16(float value) {
+  return static_cast<uint16_t>(
+      std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
 }
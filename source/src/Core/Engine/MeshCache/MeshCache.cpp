@@ -0,0 +1,524 @@
+#include "MeshCache.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char MAGIC[4] = {'S', 'E', 'M', 'C'};
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t importFlags;
+  uint32_t vertexSize;
+  uint32_t meshCount;
+  uint32_t textureCount;
+  uint32_t textureReferenceCount;
+  uint32_t vertexLayout;
+  uint32_t optimizeFlags;
+};
+
+struct MeshRecord {
+  float transform[16];
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t firstTextureReference;
+  uint32_t textureReferenceCount;
+  float positionOffset[3];
+  float positionScale[3];
+  uint64_t meshletOffset;
+  uint32_t meshletCount;
+  uint32_t lodCount;
+  uint64_t lodOffset;
+  float boundsCenter[3];
+  float boundsRadius;
+};
+
+struct TextureRecord {
+  uint64_t stringOffset;
+  uint32_t typeLength;
+  uint32_t pathLength;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+
+static constexpr size_t MESHES_OFFSET = sizeof(FileHeader);
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static void writePadding(std::ofstream &stream, uint64_t &offset,
+                         uint64_t alignment) {
+  static const char zeros[16] = {};
+  uint64_t aligned = alignOffset(offset, alignment);
+  stream.write(zeros, static_cast<std::streamsize>(aligned - offset));
+  offset = aligned;
+}
+
+static void writeBytes(std::ofstream &stream, uint64_t &offset,
+                       const void *bytes, uint64_t count) {
+  stream.write(static_cast<const char *>(bytes),
+               static_cast<std::streamsize>(count));
+  offset += count;
+}
+
+// Unique per process and call, so jobs or processes cooking the same cache
+// at once never write into each other's file
+static std::string getTemporaryPath(const std::string &path) {
+  static std::atomic<uint32_t> counter{0};
+#ifdef _WIN32
+  unsigned long processId = GetCurrentProcessId();
+#else
+  unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+  return path + ".tmp." + std::to_string(processId) + '.' +
+         std::to_string(counter.fetch_add(1));
+}
+
+MeshCache::MeshCache()
+    : data(nullptr), size(0)
+#ifdef _WIN32
+      ,
+      file(nullptr), mapping(nullptr)
+#endif
+{
+}
+
+MeshCache::~MeshCache() { close(); }
+
+std::string MeshCache::getCachePath(const std::string &sourcePath) {
+  return sourcePath + ".semc";
+}
+
+// FNV-1a, streamed in chunks so large sources are not loaded whole
+bool MeshCache::hashFile(const std::string &path, uint64_t &hash) {
+  PROFILE_FUNCTION();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  hash = 14695981039346656037ull;
+  std::vector<char> buffer(1 << 20);
+  while (file) {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    std::streamsize count = file.gcount();
+    for (std::streamsize i = 0; i < count; i++) {
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 1099511628211ull;
+    }
+  }
+  return file.eof();
+}
+
+bool MeshCache::write(const std::string &path, uint64_t sourceHash,
+                      uint32_t importFlags, VertexLayout vertexLayout,
+                      uint32_t optimizeFlags,
+                      const std::vector<MeshCacheTexture> &textures,
+                      const std::vector<MeshCacheMesh> &meshes) {
+  PROFILE_FUNCTION();
+
+  FileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.sourceHash = sourceHash;
+  header.importFlags = importFlags;
+  header.vertexSize =
+      static_cast<uint32_t>(Mesh::getVertexStride(vertexLayout));
+  header.vertexLayout = static_cast<uint32_t>(vertexLayout);
+  header.optimizeFlags = optimizeFlags;
+  header.meshCount = static_cast<uint32_t>(meshes.size());
+  header.textureCount = static_cast<uint32_t>(textures.size());
+
+  // Lay out every section first so the tables can be written up front
+  std::vector<MeshRecord> meshRecords(meshes.size());
+  std::vector<TextureRecord> textureRecords(textures.size());
+  std::vector<uint32_t> textureReferences;
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    MeshRecord &record = meshRecords[i];
+    std::memcpy(record.transform, &meshes[i].transform[0][0],
+                sizeof(record.transform));
+    record.vertexCount = meshes[i].vertexCount;
+    record.indexCount = meshes[i].indexCount;
+    record.firstTextureReference =
+        static_cast<uint32_t>(textureReferences.size());
+    record.textureReferenceCount =
+        static_cast<uint32_t>(meshes[i].textures.size());
+    std::memcpy(record.positionOffset, &meshes[i].positionOffset[0],
+                sizeof(record.positionOffset));
+    std::memcpy(record.positionScale, &meshes[i].positionScale[0],
+                sizeof(record.positionScale));
+    record.meshletCount = meshes[i].meshletCount;
+    record.lodCount = meshes[i].lodCount;
+    std::memcpy(record.boundsCenter, &meshes[i].boundsCenter[0],
+                sizeof(record.boundsCenter));
+    record.boundsRadius = meshes[i].boundsRadius;
+    textureReferences.insert(textureReferences.end(),
+                             meshes[i].textures.begin(),
+                             meshes[i].textures.end());
+  }
+  header.textureReferenceCount =
+      static_cast<uint32_t>(textureReferences.size());
+
+  uint64_t offset = MESHES_OFFSET + meshRecords.size() * sizeof(MeshRecord) +
+                    textureRecords.size() * sizeof(TextureRecord) +
+                    textureReferences.size() * sizeof(uint32_t);
+  for (size_t i = 0; i < textures.size(); i++) {
+    textureRecords[i].stringOffset = offset;
+    textureRecords[i].typeLength =
+        static_cast<uint32_t>(textures[i].type.size());
+    textureRecords[i].pathLength =
+        static_cast<uint32_t>(textures[i].path.size());
+    offset += textures[i].type.size() + textures[i].path.size();
+  }
+  for (size_t i = 0; i < textures.size(); i++) {
+    textureRecords[i].dataOffset = textures[i].data ? offset : 0;
+    textureRecords[i].dataSize = textures[i].data ? textures[i].size : 0;
+    offset += textureRecords[i].dataSize;
+  }
+  offset = alignOffset(offset, 16);
+  for (MeshRecord &record : meshRecords) {
+    record.meshletOffset = offset;
+    offset += static_cast<uint64_t>(record.meshletCount) * sizeof(Meshlet);
+  }
+  for (MeshRecord &record : meshRecords) {
+    record.lodOffset = offset;
+    offset += static_cast<uint64_t>(record.lodCount) * sizeof(MeshLod);
+  }
+  offset = alignOffset(offset, 16);
+  for (MeshRecord &record : meshRecords) {
+    record.vertexOffset = offset;
+    offset += static_cast<uint64_t>(record.vertexCount) * header.vertexSize;
+  }
+  offset = alignOffset(offset, alignof(unsigned int));
+  for (MeshRecord &record : meshRecords) {
+    record.indexOffset = offset;
+    offset += static_cast<uint64_t>(record.indexCount) * sizeof(unsigned int);
+  }
+
+  // Written beside the cache and renamed, so a crash never leaves a torn
+  // cache behind
+  std::string temporaryPath = getTemporaryPath(path);
+  std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    Logger::meshCache->warn("Failed to create mesh cache: {}", path);
+    return false;
+  }
+
+  offset = 0;
+  writeBytes(stream, offset, &header, sizeof(header));
+  writeBytes(stream, offset, meshRecords.data(),
+             meshRecords.size() * sizeof(MeshRecord));
+  writeBytes(stream, offset, textureRecords.data(),
+             textureRecords.size() * sizeof(TextureRecord));
+  writeBytes(stream, offset, textureReferences.data(),
+             textureReferences.size() * sizeof(uint32_t));
+  for (const MeshCacheTexture &texture : textures) {
+    writeBytes(stream, offset, texture.type.data(), texture.type.size());
+    writeBytes(stream, offset, texture.path.data(), texture.path.size());
+  }
+  for (const MeshCacheTexture &texture : textures) {
+    if (texture.data)
+      writeBytes(stream, offset, texture.data, texture.size);
+  }
+  writePadding(stream, offset, 16);
+  for (const MeshCacheMesh &mesh : meshes)
+    writeBytes(stream, offset, mesh.meshlets,
+               static_cast<uint64_t>(mesh.meshletCount) * sizeof(Meshlet));
+  for (const MeshCacheMesh &mesh : meshes)
+    writeBytes(stream, offset, mesh.lods,
+               static_cast<uint64_t>(mesh.lodCount) * sizeof(MeshLod));
+  writePadding(stream, offset, 16);
+  for (const MeshCacheMesh &mesh : meshes)
+    writeBytes(stream, offset, mesh.vertices,
+               static_cast<uint64_t>(mesh.vertexCount) * header.vertexSize);
+  writePadding(stream, offset, alignof(unsigned int));
+  for (const MeshCacheMesh &mesh : meshes)
+    writeBytes(stream, offset, mesh.indices,
+               static_cast<uint64_t>(mesh.indexCount) * sizeof(unsigned int));
+
+  stream.close();
+  if (!stream) {
+    Logger::meshCache->warn("Failed to write mesh cache: {}", path);
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  std::remove(path.c_str());
+  if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+    Logger::meshCache->warn("Failed to replace mesh cache: {}", path);
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  Logger::meshCache->info("Cooked mesh cache: {} ({} meshes, {} KB)", path,
+                          meshes.size(), offset / 1024);
+  return true;
+}
+
+bool MeshCache::open(const std::string &path, uint64_t sourceHash,
+                     uint32_t importFlags, VertexLayout vertexLayout,
+                     uint32_t optimizeFlags) {
+  PROFILE_FUNCTION();
+
+  close();
+
+#ifdef _WIN32
+  HANDLE fileHandle =
+      CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(fileHandle);
+    return false;
+  }
+
+  HANDLE mappingHandle =
+      CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void *view = mappingHandle
+                   ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)
+                   : nullptr;
+  if (!view) {
+    Logger::meshCache->warn("Failed to map mesh cache: {}", path);
+    if (mappingHandle)
+      CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    return false;
+  }
+
+  file = fileHandle;
+  mapping = mappingHandle;
+  data = static_cast<const unsigned char *>(view);
+  size = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0)
+    return false;
+
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+    ::close(descriptor);
+    return false;
+  }
+
+  void *view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ,
+                    MAP_PRIVATE, descriptor, 0);
+  // The mapping keeps the file alive
+  ::close(descriptor);
+  if (view == MAP_FAILED) {
+    Logger::meshCache->warn("Failed to map mesh cache: {}", path);
+    return false;
+  }
+
+  data = static_cast<const unsigned char *>(view);
+  size = static_cast<size_t>(status.st_size);
+#endif
+
+  if (!validate()) {
+    Logger::meshCache->warn("Ignoring malformed mesh cache: {}", path);
+    close();
+    return false;
+  }
+
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+  if (header->version != VERSION ||
+      header->vertexLayout != static_cast<uint32_t>(vertexLayout) ||
+      header->optimizeFlags != optimizeFlags ||
+      header->importFlags != importFlags ||
+      header->sourceHash != sourceHash) {
+    Logger::meshCache->info("Mesh cache is stale: {}", path);
+    close();
+    return false;
+  }
+
+  Logger::meshCache->info("Mapped mesh cache: {} ({} meshes, {} KB)", path,
+                          header->meshCount, size / 1024);
+  return true;
+}
+
+void MeshCache::close() {
+  if (!data)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+  CloseHandle(static_cast<HANDLE>(mapping));
+  CloseHandle(static_cast<HANDLE>(file));
+  file = nullptr;
+  mapping = nullptr;
+#else
+  munmap(const_cast<unsigned char *>(data), size);
+#endif
+  data = nullptr;
+  size = 0;
+}
+
+bool MeshCache::isOpen() const { return data != nullptr; }
+
+size_t MeshCache::getMeshCount() const {
+  return data ? reinterpret_cast<const FileHeader *>(data)->meshCount : 0;
+}
+
+MeshCacheMesh MeshCache::getMesh(size_t index) const {
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+  const MeshRecord &record =
+      reinterpret_cast<const MeshRecord *>(data + MESHES_OFFSET)[index];
+  const uint32_t *references = reinterpret_cast<const uint32_t *>(
+      data + MESHES_OFFSET + header->meshCount * sizeof(MeshRecord) +
+      header->textureCount * sizeof(TextureRecord));
+
+  MeshCacheMesh mesh;
+  std::memcpy(&mesh.transform[0][0], record.transform,
+              sizeof(record.transform));
+  mesh.vertices = data + record.vertexOffset;
+  mesh.vertexCount = record.vertexCount;
+  std::memcpy(&mesh.positionOffset[0], record.positionOffset,
+              sizeof(record.positionOffset));
+  std::memcpy(&mesh.positionScale[0], record.positionScale,
+              sizeof(record.positionScale));
+  mesh.indices =
+      reinterpret_cast<const unsigned int *>(data + record.indexOffset);
+  mesh.indexCount = record.indexCount;
+  mesh.meshlets =
+      reinterpret_cast<const Meshlet *>(data + record.meshletOffset);
+  mesh.meshletCount = record.meshletCount;
+  mesh.lods = reinterpret_cast<const MeshLod *>(data + record.lodOffset);
+  mesh.lodCount = record.lodCount;
+  std::memcpy(&mesh.boundsCenter[0], record.boundsCenter,
+              sizeof(record.boundsCenter));
+  mesh.boundsRadius = record.boundsRadius;
+  mesh.textures.assign(references + record.firstTextureReference,
+                       references + record.firstTextureReference +
+                           record.textureReferenceCount);
+  return mesh;
+}
+
+size_t MeshCache::getTextureCount() const {
+  return data ? reinterpret_cast<const FileHeader *>(data)->textureCount : 0;
+}
+
+MeshCacheTexture MeshCache::getTexture(size_t index) const {
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+  const TextureRecord &record = reinterpret_cast<const TextureRecord *>(
+      data + MESHES_OFFSET + header->meshCount * sizeof(MeshRecord))[index];
+
+  const char *strings =
+      reinterpret_cast<const char *>(data + record.stringOffset);
+  MeshCacheTexture texture;
+  texture.type.assign(strings, record.typeLength);
+  texture.path.assign(strings + record.typeLength, record.pathLength);
+  texture.data = record.dataSize ? data + record.dataOffset : nullptr;
+  texture.size = record.dataSize;
+  return texture;
+}
+
+// Every offset is checked once here so the getters can trust the file
+bool MeshCache::validate() const {
+  auto inBounds = [this](uint64_t offset, uint64_t bytes) {
+    return offset <= size && bytes <= size - offset;
+  };
+
+  if (size < sizeof(FileHeader))
+    return false;
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+  if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+    return false;
+  // Older or newer versions are reported as stale by open()
+  if (header->version != VERSION)
+    return true;
+  VertexLayout vertexLayout = static_cast<VertexLayout>(header->vertexLayout);
+  if (header->vertexLayout >
+          static_cast<uint32_t>(VertexLayout::CompactQuantized) ||
+      header->vertexSize != Mesh::getVertexStride(vertexLayout))
+    return false;
+
+  uint64_t texturesOffset =
+      MESHES_OFFSET + uint64_t(header->meshCount) * sizeof(MeshRecord);
+  uint64_t referencesOffset =
+      texturesOffset + uint64_t(header->textureCount) * sizeof(TextureRecord);
+  if (!inBounds(referencesOffset, uint64_t(header->textureReferenceCount) *
+                                      sizeof(uint32_t)))
+    return false;
+
+  const MeshRecord *meshes =
+      reinterpret_cast<const MeshRecord *>(data + MESHES_OFFSET);
+  const uint32_t *references =
+      reinterpret_cast<const uint32_t *>(data + referencesOffset);
+  for (uint32_t i = 0; i < header->meshCount; i++) {
+    const MeshRecord &mesh = meshes[i];
+    if (mesh.vertexOffset % alignof(float) != 0 ||
+        mesh.indexOffset % alignof(unsigned int) != 0 ||
+        !inBounds(mesh.vertexOffset,
+                  uint64_t(mesh.vertexCount) * header->vertexSize) ||
+        !inBounds(mesh.indexOffset,
+                  uint64_t(mesh.indexCount) * sizeof(unsigned int)) ||
+        uint64_t(mesh.firstTextureReference) + mesh.textureReferenceCount >
+            header->textureReferenceCount ||
+        mesh.meshletOffset % alignof(Meshlet) != 0 ||
+        !inBounds(mesh.meshletOffset,
+                  uint64_t(mesh.meshletCount) * sizeof(Meshlet)) ||
+        mesh.lodOffset % alignof(MeshLod) != 0 ||
+        !inBounds(mesh.lodOffset, uint64_t(mesh.lodCount) * sizeof(MeshLod)))
+      return false;
+
+    // Indices are uploaded as they are, so one past the mesh's vertices
+    // would read another mesh's or beyond its heap allocation
+    const unsigned int *indices =
+        reinterpret_cast<const unsigned int *>(data + mesh.indexOffset);
+    for (uint32_t j = 0; j < mesh.indexCount; j++) {
+      if (indices[j] >= mesh.vertexCount)
+        return false;
+    }
+
+    // Meshlets and LODs become draw ranges, so they must stay inside the
+    // indices
+    const Meshlet *meshlets =
+        reinterpret_cast<const Meshlet *>(data + mesh.meshletOffset);
+    for (uint32_t j = 0; j < mesh.meshletCount; j++) {
+      if (uint64_t(meshlets[j].firstIndex) + meshlets[j].indexCount >
+          mesh.indexCount)
+        return false;
+    }
+    const MeshLod *lods =
+        reinterpret_cast<const MeshLod *>(data + mesh.lodOffset);
+    for (uint32_t j = 0; j < mesh.lodCount; j++) {
+      if (uint64_t(lods[j].firstIndex) + lods[j].indexCount > mesh.indexCount)
+        return false;
+    }
+  }
+  for (uint32_t i = 0; i < header->textureReferenceCount; i++) {
+    if (references[i] >= header->textureCount)
+      return false;
+  }
+
+  const TextureRecord *textures =
+      reinterpret_cast<const TextureRecord *>(data + texturesOffset);
+  for (uint32_t i = 0; i < header->textureCount; i++) {
+    const TextureRecord &texture = textures[i];
+    if (!inBounds(texture.stringOffset,
+                  uint64_t(texture.typeLength) + texture.pathLength) ||
+        !inBounds(texture.dataOffset, texture.dataSize))
+      return false;
+  }
+  return true;
+}
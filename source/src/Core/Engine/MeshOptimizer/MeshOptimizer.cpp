@@ -0,0 +1,733 @@
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Sum of squared distances to weighted planes, as a symmetric 4x4 matrix
+struct Quadric {
+  double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+  double weight;
+};
+
+static Meshlet computeMeshletBounds(const std::vector<Vertex> &vertices,
+                                    const std::vector<unsigned int> &indices,
+                                    size_t firstIndex, size_t indexCount);
+static void addPlane(Quadric &quadric, const glm::vec3 &normal,
+                     float distance, double weight);
+static void addQuadric(Quadric &quadric, const Quadric &other);
+static double evaluate(const Quadric &quadric, const glm::vec3 &point);
+
+float VertexCacheStats::getAcmr() const {
+  return triangles ? static_cast<float>(transformedVertices) / triangles
+                   : 0.0f;
+}
+
+float VertexCacheStats::getAtvr() const {
+  return vertices ? static_cast<float>(transformedVertices) / vertices : 0.0f;
+}
+
+VertexCacheStats &VertexCacheStats::operator+=(const VertexCacheStats &other) {
+  transformedVertices += other.transformedVertices;
+  triangles += other.triangles;
+  vertices += other.vertices;
+  return *this;
+}
+
+void MeshOptimizer::optimize(std::vector<Vertex> &vertices,
+                             std::vector<unsigned int> &indices,
+                             unsigned int flags) {
+  PROFILE_FUNCTION();
+
+  if (flags & VertexCache) {
+    std::vector<size_t> clusters;
+    optimizeVertexCache(indices, vertices.size(),
+                        flags & Overdraw ? &clusters : nullptr);
+    if (flags & Overdraw)
+      optimizeOverdraw(indices, vertices, clusters);
+  }
+  if (flags & VertexFetch)
+    optimizeVertexFetch(vertices, indices);
+}
+
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"): emits every triangle around a fanning
+// vertex, then moves on to the oldest neighbour that will still be cached
+// afterwards. Linear in the mesh size, unlike greedy scoring.
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices,
+                                        size_t vertexCount,
+                                        std::vector<size_t> *clusters) {
+  PROFILE_FUNCTION();
+
+  if (clusters)
+    clusters->clear();
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // Triangles around every vertex, packed into one array
+  std::vector<unsigned int> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++)
+    liveTriangles[indices[i]]++;
+  std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++)
+    adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+  std::vector<unsigned int> adjacency(triangleCount * 3);
+  std::vector<size_t> fill(adjacencyOffsets.begin(),
+                           adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < triangleCount * 3; i++)
+    adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+  std::vector<unsigned int> cacheTimes(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<unsigned int> deadEnds;
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> result;
+  result.reserve(triangleCount * 3);
+
+  unsigned int time = CACHE_SIZE + 1;
+  size_t cursor = 0;
+  // Recently used vertices first, then the lowest vertex with triangles
+  // left. Either way the cache is mostly cold, which starts a cluster
+  auto skipDeadEnd = [&]() -> int64_t {
+    while (!deadEnds.empty()) {
+      unsigned int vertex = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[vertex] > 0)
+        return vertex;
+    }
+    for (; cursor < vertexCount; cursor++) {
+      if (liveTriangles[cursor] > 0)
+        return static_cast<int64_t>(cursor);
+    }
+    return -1;
+  };
+
+  int64_t fanning = skipDeadEnd();
+  if (clusters)
+    clusters->push_back(0);
+  while (fanning >= 0) {
+    candidates.clear();
+    for (size_t a = adjacencyOffsets[fanning];
+         a < adjacencyOffsets[fanning + 1]; a++) {
+      unsigned int triangle = adjacency[a];
+      if (emitted[triangle])
+        continue;
+      emitted[triangle] = true;
+
+      for (size_t corner = 0; corner < 3; corner++) {
+        unsigned int vertex = indices[triangle * 3 + corner];
+        result.push_back(vertex);
+        deadEnds.push_back(vertex);
+        candidates.push_back(vertex);
+        liveTriangles[vertex]--;
+        if (time - cacheTimes[vertex] > CACHE_SIZE)
+          cacheTimes[vertex] = time++;
+      }
+    }
+
+    int64_t next = -1;
+    int bestPriority = -1;
+    for (unsigned int vertex : candidates) {
+      if (liveTriangles[vertex] == 0)
+        continue;
+      int priority = 0;
+      if (time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= CACHE_SIZE)
+        priority = static_cast<int>(time - cacheTimes[vertex]);
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        next = vertex;
+      }
+    }
+    if (next < 0) {
+      next = skipDeadEnd();
+      if (next >= 0 && clusters)
+        clusters->push_back(result.size());
+    }
+    fanning = next;
+  }
+
+  indices.swap(result);
+}
+
+// Sorts clusters by how far they face away from the mesh centre, a
+// view-independent guess at what gets drawn over what
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices,
+                                     const std::vector<Vertex> &vertices,
+                                     const std::vector<size_t> &clusters) {
+  PROFILE_FUNCTION();
+
+  if (clusters.size() < 2)
+    return;
+
+  struct Cluster {
+    size_t begin;
+    size_t end;
+    float sortKey;
+  };
+
+  std::vector<Cluster> sorted(clusters.size());
+  std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+    sorted[c].begin = clusters[c];
+    sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+
+    float clusterArea = 0.0f;
+    for (size_t i = sorted[c].begin; i + 2 < sorted[c].end; i += 3) {
+      const glm::vec3 &a = vertices[indices[i]].Position;
+      const glm::vec3 &b = vertices[indices[i + 1]].Position;
+      const glm::vec3 &d = vertices[indices[i + 2]].Position;
+      glm::vec3 normal = glm::cross(b - a, d - a);
+      float area = glm::length(normal);
+
+      normals[c] += normal;
+      centroids[c] += area * (a + b + d) / 3.0f;
+      clusterArea += area;
+    }
+
+    meshCentroid += centroids[c];
+    meshArea += clusterArea;
+    if (clusterArea > 0.0f)
+      centroids[c] /= clusterArea;
+  }
+  if (meshArea > 0.0f)
+    meshCentroid /= meshArea;
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+    float length = glm::length(normals[c]);
+    sorted[c].sortKey =
+        length > 0.0f
+            ? glm::dot(centroids[c] - meshCentroid, normals[c] / length)
+            : 0.0f;
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster &left, const Cluster &right) {
+                     return left.sortKey > right.sortKey;
+                   });
+
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+  for (const Cluster &cluster : sorted)
+    result.insert(result.end(), indices.begin() + cluster.begin,
+                  indices.begin() + cluster.end);
+  indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices,
+                                        std::vector<unsigned int> &indices) {
+  PROFILE_FUNCTION();
+
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(vertices.size(), unused);
+  unsigned int nextVertex = 0;
+  for (unsigned int &index : indices) {
+    if (remap[index] == unused)
+      remap[index] = nextVertex++;
+    index = remap[index];
+  }
+  for (unsigned int &target : remap) {
+    if (target == unused)
+      target = nextVertex++;
+  }
+
+  std::vector<Vertex> result(vertices.size());
+  for (size_t v = 0; v < vertices.size(); v++)
+    result[remap[v]] = vertices[v];
+  vertices.swap(result);
+}
+
+std::vector<MeshPart>
+MeshOptimizer::splitForShortIndices(const std::vector<Vertex> &vertices,
+                                   const std::vector<unsigned int> &indices,
+                                   size_t maxVertices) {
+  std::vector<MeshPart> parts;
+  if (vertices.size() <= maxVertices)
+    return parts;
+
+  PROFILE_FUNCTION();
+
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(vertices.size(), unused);
+  std::vector<unsigned int> mapped;
+  parts.emplace_back();
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    size_t newVertices = 0;
+    for (size_t corner = 0; corner < 3; corner++) {
+      if (remap[indices[i + corner]] == unused)
+        newVertices++;
+    }
+    if (parts.back().vertices.size() + newVertices > maxVertices) {
+      for (unsigned int vertex : mapped)
+        remap[vertex] = unused;
+      mapped.clear();
+      parts.emplace_back();
+    }
+
+    MeshPart &part = parts.back();
+    for (size_t corner = 0; corner < 3; corner++) {
+      unsigned int vertex = indices[i + corner];
+      if (remap[vertex] == unused) {
+        remap[vertex] = static_cast<unsigned int>(part.vertices.size());
+        part.vertices.push_back(vertices[vertex]);
+        mapped.push_back(vertex);
+      }
+      part.indices.push_back(remap[vertex]);
+    }
+  }
+  return parts;
+}
+
+std::vector<Meshlet>
+MeshOptimizer::buildMeshlets(const std::vector<Vertex> &vertices,
+                             const std::vector<unsigned int> &indices,
+                             size_t maxVertices, size_t maxTriangles) {
+  PROFILE_FUNCTION();
+
+  std::vector<Meshlet> meshlets;
+  // Meshlet that last used each vertex, so distinct vertices are counted
+  // without clearing a set per meshlet
+  std::vector<size_t> lastMeshlet(vertices.size(), SIZE_MAX);
+  size_t first = 0;
+  size_t vertexCount = 0;
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    size_t newVertices = 0;
+    for (size_t corner = 0; corner < 3; corner++) {
+      if (lastMeshlet[indices[i + corner]] != meshlets.size())
+        newVertices++;
+    }
+    if (vertexCount + newVertices > maxVertices ||
+        (i - first) / 3 >= maxTriangles) {
+      meshlets.push_back(
+          computeMeshletBounds(vertices, indices, first, i - first));
+      first = i;
+      vertexCount = 0;
+    }
+
+    for (size_t corner = 0; corner < 3; corner++) {
+      size_t &last = lastMeshlet[indices[i + corner]];
+      if (last != meshlets.size()) {
+        last = meshlets.size();
+        vertexCount++;
+      }
+    }
+  }
+  size_t end = indices.size() / 3 * 3;
+  if (end > first)
+    meshlets.push_back(computeMeshletBounds(vertices, indices, first,
+                                            end - first));
+  return meshlets;
+}
+
+std::vector<unsigned int>
+MeshOptimizer::simplify(const std::vector<Vertex> &vertices,
+                        const std::vector<unsigned int> &indices,
+                        size_t targetIndexCount, float &error) {
+  PROFILE_FUNCTION();
+
+  error = 0.0f;
+  std::vector<unsigned int> result(indices.begin(),
+                                   indices.begin() + indices.size() / 3 * 3);
+  if (result.size() <= targetIndexCount)
+    return result;
+
+  // Copies of a position differ only in attributes, at UV seams and hard
+  // edges. Topology works on the first copy of every position, and copied
+  // positions are locked so the seam never tears
+  size_t vertexCount = vertices.size();
+  std::vector<unsigned int> order(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++)
+    order[v] = static_cast<unsigned int>(v);
+  std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+    const glm::vec3 &left = vertices[a].Position;
+    const glm::vec3 &right = vertices[b].Position;
+    if (left.x != right.x)
+      return left.x < right.x;
+    if (left.y != right.y)
+      return left.y < right.y;
+    return left.z < right.z;
+  });
+  std::vector<unsigned int> position(vertexCount);
+  std::vector<bool> locked(vertexCount, false);
+  for (size_t i = 0; i < vertexCount;) {
+    size_t end = i + 1;
+    while (end < vertexCount &&
+           vertices[order[end]].Position == vertices[order[i]].Position)
+      end++;
+    for (size_t j = i; j < end; j++) {
+      position[order[j]] = order[i];
+      locked[order[j]] = end - i > 1;
+    }
+    i = end;
+  }
+
+  // Border and non-manifold edges are not shared by exactly two triangles
+  std::vector<uint64_t> edges;
+  edges.reserve(result.size());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    for (size_t corner = 0; corner < 3; corner++) {
+      uint64_t a = position[result[i + corner]];
+      uint64_t b = position[result[i + (corner + 1) % 3]];
+      if (a != b)
+        edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  for (size_t i = 0; i < edges.size();) {
+    size_t end = i + 1;
+    while (end < edges.size() && edges[end] == edges[i])
+      end++;
+    if (end - i != 2) {
+      locked[edges[i] >> 32] = true;
+      locked[edges[i] & 0xffffffffu] = true;
+    }
+    i = end;
+  }
+
+  // Every position starts with the planes of its triangles, weighted by
+  // area
+  std::vector<Quadric> quadrics(vertexCount, Quadric());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    const glm::vec3 &a = vertices[result[i]].Position;
+    const glm::vec3 &b = vertices[result[i + 1]].Position;
+    const glm::vec3 &c = vertices[result[i + 2]].Position;
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::length(normal);
+    if (area == 0.0f)
+      continue;
+    normal /= area;
+    for (size_t corner = 0; corner < 3; corner++)
+      addPlane(quadrics[position[result[i + corner]]], normal,
+               -glm::dot(normal, a), area * 0.5);
+  }
+
+  struct Collapse {
+    double cost;
+    unsigned int from;
+    unsigned int to;
+  };
+
+  std::vector<unsigned int> collapse(vertexCount);
+  std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+  std::vector<unsigned int> triangleList;
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(vertexCount);
+  std::vector<unsigned int> ring;
+  std::vector<unsigned int> shared;
+  double maxCost = 0.0;
+
+  // A collapse must keep the surface manifold, with exactly two neighbours
+  // shared by both ends, and must not turn any remaining triangle over
+  auto isValid = [&](unsigned int from, unsigned int to,
+                     const glm::vec3 &target) {
+    ring.clear();
+    for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1];
+         t++) {
+      for (size_t corner = 0; corner < 3; corner++)
+        ring.push_back(position[result[triangleList[t] * 3 + corner]]);
+    }
+    shared.clear();
+    for (unsigned int t = triangleOffsets[to]; t < triangleOffsets[to + 1];
+         t++) {
+      for (size_t corner = 0; corner < 3; corner++) {
+        unsigned int v = position[result[triangleList[t] * 3 + corner]];
+        if (v != from && v != to &&
+            std::find(ring.begin(), ring.end(), v) != ring.end() &&
+            std::find(shared.begin(), shared.end(), v) == shared.end())
+          shared.push_back(v);
+      }
+    }
+    if (shared.size() != 2)
+      return false;
+
+    for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1];
+         t++) {
+      const unsigned int *triangle = &result[triangleList[t] * 3];
+      glm::vec3 corners[3];
+      bool removed = false;
+      for (size_t corner = 0; corner < 3; corner++) {
+        corners[corner] = vertices[triangle[corner]].Position;
+        removed = removed || position[triangle[corner]] == to;
+      }
+      if (removed)
+        continue;
+
+      glm::vec3 before = glm::cross(corners[1] - corners[0],
+                                    corners[2] - corners[0]);
+      for (size_t corner = 0; corner < 3; corner++) {
+        if (position[triangle[corner]] == from)
+          corners[corner] = target;
+      }
+      glm::vec3 after = glm::cross(corners[1] - corners[0],
+                                   corners[2] - corners[0]);
+      if (glm::dot(before, after) <=
+          0.25f * glm::length(before) * glm::length(after))
+        return false;
+    }
+    return true;
+  };
+
+  // Passes collapse the cheapest edges whose neighbourhoods are untouched
+  // by this pass, so every check sees the current surface
+  while (result.size() > targetIndexCount) {
+    size_t triangleCount = result.size() / 3;
+    std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+    for (unsigned int index : result)
+      triangleOffsets[position[index] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+      triangleOffsets[v + 1] += triangleOffsets[v];
+    triangleList.resize(result.size());
+    std::vector<unsigned int> fill(triangleOffsets.begin(),
+                                   triangleOffsets.end() - 1);
+    for (size_t i = 0; i < result.size(); i++)
+      triangleList[fill[position[result[i]]]++] =
+          static_cast<unsigned int>(i / 3);
+
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; corner++) {
+        unsigned int a = result[i + corner];
+        unsigned int b = result[i + (corner + 1) % 3];
+        if (!locked[a])
+          collapses.push_back(
+              Collapse{evaluate(quadrics[a], vertices[b].Position), a, b});
+        if (!locked[b])
+          collapses.push_back(
+              Collapse{evaluate(quadrics[b], vertices[a].Position), b, a});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &left, const Collapse &right) {
+                return left.cost < right.cost;
+              });
+
+    for (size_t v = 0; v < vertexCount; v++)
+      collapse[v] = static_cast<unsigned int>(v);
+    std::fill(touched.begin(), touched.end(), false);
+    size_t wanted = triangleCount - targetIndexCount / 3;
+    size_t removed = 0;
+    for (const Collapse &candidate : collapses) {
+      if (removed >= wanted)
+        break;
+      // Unlocked vertices have no copies, so from is its own position
+      unsigned int from = candidate.from;
+      unsigned int to = position[candidate.to];
+      if (touched[from] || touched[to] ||
+          !isValid(from, to, vertices[candidate.to].Position))
+        continue;
+
+      collapse[from] = candidate.to;
+      addQuadric(quadrics[to], quadrics[from]);
+      maxCost = std::max(maxCost, candidate.cost);
+      for (unsigned int t = triangleOffsets[from];
+           t < triangleOffsets[from + 1]; t++) {
+        for (size_t corner = 0; corner < 3; corner++)
+          touched[position[result[triangleList[t] * 3 + corner]]] = true;
+      }
+      // An interior edge takes its two triangles with it
+      removed += 2;
+    }
+    if (removed == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      unsigned int a = collapse[result[i]];
+      unsigned int b = collapse[result[i + 1]];
+      unsigned int c = collapse[result[i + 2]];
+      if (position[a] == position[b] || position[b] == position[c] ||
+          position[c] == position[a])
+        continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  error = static_cast<float>(std::sqrt(maxCost));
+  return result;
+}
+
+std::vector<MeshLod>
+MeshOptimizer::buildLods(const std::vector<Vertex> &vertices,
+                         std::vector<unsigned int> &indices, size_t maxLods) {
+  PROFILE_FUNCTION();
+
+  std::vector<MeshLod> lods;
+  size_t fullCount = indices.size() / 3 * 3;
+  if (maxLods < 2 || fullCount / 3 < MIN_LOD_TRIANGLES * 2)
+    return lods;
+
+  std::vector<unsigned int> full(indices.begin(), indices.begin() + fullCount);
+  lods.push_back(MeshLod{0, static_cast<uint32_t>(fullCount), 0.0f});
+  while (lods.size() < maxLods) {
+    size_t target = lods.back().indexCount / 6 * 3;
+    if (target / 3 < MIN_LOD_TRIANGLES)
+      break;
+
+    // Every level starts from the full mesh, so its error is measured
+    // against the original surface rather than the previous level
+    float error;
+    std::vector<unsigned int> lod = simplify(vertices, full, target, error);
+    // Locked seams and borders can stop the mesh from shrinking
+    if (lod.size() > lods.back().indexCount / 4 * 3)
+      break;
+
+    optimizeVertexCache(lod, vertices.size());
+    lods.push_back(MeshLod{static_cast<uint32_t>(indices.size()),
+                           static_cast<uint32_t>(lod.size()),
+                           std::max(error, lods.back().error)});
+    indices.insert(indices.end(), lod.begin(), lod.end());
+  }
+  if (lods.size() < 2)
+    lods.clear();
+  return lods;
+}
+
+void MeshOptimizer::computeBounds(const std::vector<Vertex> &vertices,
+                                  glm::vec3 &center, float &radius) {
+  center = glm::vec3(0.0f);
+  radius = 0.0f;
+  if (vertices.empty())
+    return;
+
+  glm::vec3 minimum = vertices[0].Position;
+  glm::vec3 maximum = minimum;
+  for (const Vertex &vertex : vertices) {
+    minimum = glm::min(minimum, vertex.Position);
+    maximum = glm::max(maximum, vertex.Position);
+  }
+  center = (minimum + maximum) * 0.5f;
+  for (const Vertex &vertex : vertices)
+    radius = std::max(radius, glm::length(vertex.Position - center));
+}
+
+VertexCacheStats
+MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int> &indices,
+                                  size_t vertexCount, unsigned int cacheSize) {
+  VertexCacheStats stats;
+  stats.triangles = indices.size() / 3;
+
+  // A vertex is cached while fewer than cacheSize misses came after its own
+  std::vector<size_t> cacheTimes(vertexCount, 0);
+  std::vector<bool> referenced(vertexCount, false);
+  size_t time = cacheSize + 1;
+  for (size_t i = 0; i < stats.triangles * 3; i++) {
+    unsigned int vertex = indices[i];
+    if (!referenced[vertex]) {
+      referenced[vertex] = true;
+      stats.vertices++;
+    }
+    if (time - cacheTimes[vertex] > cacheSize) {
+      cacheTimes[vertex] = time++;
+      stats.transformedVertices++;
+    }
+  }
+  return stats;
+}
+
+// Bounding sphere around the box centre, and the tightest cone around the
+// average triangle normal
+static Meshlet computeMeshletBounds(const std::vector<Vertex> &vertices,
+                                    const std::vector<unsigned int> &indices,
+                                    size_t firstIndex, size_t indexCount) {
+  Meshlet meshlet;
+  meshlet.firstIndex = static_cast<uint32_t>(firstIndex);
+  meshlet.indexCount = static_cast<uint32_t>(indexCount);
+
+  glm::vec3 minimum = vertices[indices[firstIndex]].Position;
+  glm::vec3 maximum = minimum;
+  for (size_t i = firstIndex; i < firstIndex + indexCount; i++) {
+    minimum = glm::min(minimum, vertices[indices[i]].Position);
+    maximum = glm::max(maximum, vertices[indices[i]].Position);
+  }
+  meshlet.center = (minimum + maximum) * 0.5f;
+  meshlet.radius = 0.0f;
+  for (size_t i = firstIndex; i < firstIndex + indexCount; i++)
+    meshlet.radius =
+        std::max(meshlet.radius,
+                 glm::length(vertices[indices[i]].Position - meshlet.center));
+
+  std::vector<glm::vec3> normals;
+  normals.reserve(indexCount / 3);
+  glm::vec3 axis(0.0f);
+  for (size_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3) {
+    const glm::vec3 &a = vertices[indices[i]].Position;
+    const glm::vec3 &b = vertices[indices[i + 1]].Position;
+    const glm::vec3 &c = vertices[indices[i + 2]].Position;
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float length = glm::length(normal);
+    // Degenerate triangles are never drawn, they do not widen the cone
+    if (length == 0.0f)
+      continue;
+    normals.push_back(normal / length);
+    axis += normals.back();
+  }
+
+  meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+  meshlet.coneCutoff = Meshlet::NO_CONE;
+  float axisLength = glm::length(axis);
+  if (normals.empty() || axisLength == 0.0f)
+    return meshlet;
+
+  axis /= axisLength;
+  float minimumDot = 1.0f;
+  for (const glm::vec3 &normal : normals)
+    minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+  // At 90 degrees or wider some triangle always faces the eye
+  if (minimumDot <= 0.0f)
+    return meshlet;
+
+  meshlet.coneAxis = axis;
+  meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+  return meshlet;
+}
+
+static void addPlane(Quadric &quadric, const glm::vec3 &normal,
+                     float distance, double weight) {
+  double x = normal.x, y = normal.y, z = normal.z, w = distance;
+  quadric.xx += weight * x * x;
+  quadric.xy += weight * x * y;
+  quadric.xz += weight * x * z;
+  quadric.xw += weight * x * w;
+  quadric.yy += weight * y * y;
+  quadric.yz += weight * y * z;
+  quadric.yw += weight * y * w;
+  quadric.zz += weight * z * z;
+  quadric.zw += weight * z * w;
+  quadric.ww += weight * w * w;
+  quadric.weight += weight;
+}
+
+static void addQuadric(Quadric &quadric, const Quadric &other) {
+  quadric.xx += other.xx;
+  quadric.xy += other.xy;
+  quadric.xz += other.xz;
+  quadric.xw += other.xw;
+  quadric.yy += other.yy;
+  quadric.yz += other.yz;
+  quadric.yw += other.yw;
+  quadric.zz += other.zz;
+  quadric.zw += other.zw;
+  quadric.ww += other.ww;
+  quadric.weight += other.weight;
+}
+
+// Weighted mean squared distance of a point to the quadric's planes
+static double evaluate(const Quadric &quadric, const glm::vec3 &point) {
+  if (quadric.weight <= 0.0)
+    return 0.0;
+  double x = point.x, y = point.y, z = point.z;
+  double sum = quadric.xx * x * x + quadric.yy * y * y + quadric.zz * z * z +
+               2.0 * (quadric.xy * x * y + quadric.xz * x * z +
+                      quadric.yz * y * z + quadric.xw * x + quadric.yw * y +
+                      quadric.zw * z) +
+               quadric.ww;
+  return std::max(sum, 0.0) / quadric.weight;
+}
@@ -1,79 +1,669 @@
 #include "Model.h"
+#include "ElementBuffer.h"
+#include "JobSystem.h"
 #include "Logger.h"
-#include "stb_image.h"
+#include "MeshCache.h"
+#include "Profiler.h"
+#include "TextureRegistry.h"
+#include <algorithm>
+#include <cstring>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-static unsigned int TextureFromFile(const char *path,
-                                    const std::string &directory,
-                                    const aiScene *scene, bool gamma = false);
+static const aiTexture *findEmbeddedTexture(const std::string &path,
+                                            const aiScene *scene);
+static size_t countIndices(const aiMesh *mesh);
+static size_t countNodes(const aiNode *node);
+static size_t getCpuBytes(const Mesh &mesh);
 static glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 &from);
+static void writeFlatGeometry(const std::vector<Vertex> &vertices,
+                              const unsigned int *indices, size_t indexCount,
+                              int vertexOffset, float *flatVertex,
+                              int *flatIndex);
+
+// Position, normal, texture coordinates, tangent and bitangent
+static constexpr size_t FLAT_VERTEX_FLOATS = 14;
+// Steps every profile runs, the mesh conversion relies on them
+static constexpr unsigned int BASE_IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
+    aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+
+// Sizes of a scene, logged before and after post-processing
+struct SceneCounts {
+  size_t meshes = 0;
+  size_t vertices = 0;
+  size_t indices = 0;
+  size_t materials = 0;
+  size_t nodes = 0;
+
+  explicit SceneCounts(const aiScene *scene) {
+    meshes = scene->mNumMeshes;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+      vertices += scene->mMeshes[i]->mNumVertices;
+      indices += countIndices(scene->mMeshes[i]);
+    }
+    materials = scene->mNumMaterials;
+    nodes = countNodes(scene->mRootNode);
+  }
+};
+
+GeometryMemory &GeometryMemory::operator+=(const GeometryMemory &other) {
+  gpuBytes += other.gpuBytes;
+  cpuBytes += other.cpuBytes;
+  releasedBytes += other.releasedBytes;
+  return *this;
+}
+
+DrawStats &DrawStats::operator+=(const DrawStats &other) {
+  meshes += other.meshes;
+  for (size_t i = 0; i < MeshOptimizer::MAX_LODS; i++)
+    lodMeshes[i] += other.lodMeshes[i];
+  meshlets += other.meshlets;
+  visibleMeshlets += other.visibleMeshlets;
+  batchedMeshes += other.batchedMeshes;
+  batchMaterials += other.batchMaterials;
+  return *this;
+}
 
 Model::Model(std::string const &path, bool gamma)
     : transform(glm::mat4(1.0f)), ambient(glm::vec3(0.2f)), shininess(32),
-      gammaCorrection(gamma) {
+      gammaCorrection(gamma), vertexLayout(VertexLayout::Float),
+      optimizeFlags(MeshOptimizer::All),
+      importProfile(ImportProfile::RuntimeOptimized),
+      residency(GeometryResidency::GpuOnly), mergeMeshes(false),
+      uploadedTextures(0),
+      uploadedMeshes(0) {
   loadModel(path);
 }
 
 Model::Model(bool gamma)
     : transform(glm::mat4(1.0f)), ambient(glm::vec3(0.2f)), shininess(32),
-      gammaCorrection(gamma) {}
-
-void Model::Draw(Shader &shader) {
-  for (unsigned int i = 0; i < meshes.size(); i++)
-    meshes[i].Draw(shader, transform, ambient, shininess);
+      gammaCorrection(gamma), vertexLayout(VertexLayout::Float),
+      optimizeFlags(MeshOptimizer::All),
+      importProfile(ImportProfile::RuntimeOptimized),
+      residency(GeometryResidency::GpuOnly), mergeMeshes(false),
+      uploadedTextures(0),
+      uploadedMeshes(0) {}
+
+void Model::Draw(Shader &shader) { Draw(shader, transform); }
+
+// Batched meshes are skipped by Mesh::Draw(), the rest draw on their own
+void Model::Draw(Shader &shader, const glm::mat4 &transform,
+                 const CullView *cullView, const LodView *lodView) {
+  batch.draw(shader, meshes, transform, ambient, shininess, cullView,
+             lodView);
+  for (Mesh &mesh : meshes)
+    mesh.Draw(shader, transform, ambient, shininess, cullView, lodView);
+
+  // Mirrors Mesh::selectDraw(): the level is only picked with a LOD view,
+  // and only full detail is culled per meshlet
+  drawStats = DrawStats();
+  drawStats.batchedMeshes = batch.getMeshCount();
+  drawStats.batchMaterials = batch.getMaterialCount();
+  for (const Mesh &mesh : meshes) {
+    if (!mesh.isUploaded())
+      continue;
+    size_t lod = lodView ? std::min(mesh.getCurrentLod(),
+                                    MeshOptimizer::MAX_LODS - 1)
+                         : 0;
+    drawStats.meshes++;
+    drawStats.lodMeshes[lod]++;
+    const ClusterCuller &culler = mesh.getClusterCuller();
+    if (lod == 0 && cullView && !culler.isEmpty()) {
+      drawStats.meshlets += culler.getMeshletCount();
+      drawStats.visibleMeshlets += culler.getVisibleCount();
+    }
+  }
 }
 
+const DrawStats &Model::getDrawStats() const { return drawStats; }
+
 // Optionally remove this, only used for soft body physics
 void Model::syncSoftBodyVertices() {
+  if (residency != GeometryResidency::Full) {
+    Logger::model->warn("syncSoftBodyVertices(): {} keeps no soft body "
+                        "vertices, its residency is {}.",
+                        sourcePath, getResidencyName(residency));
+    return;
+  }
+
   for (auto &mesh : meshes) {
     mesh.updateVertices(flatVertices);
   }
 }
 
 void Model::loadModel(std::string const &path) {
+  if (importModel(path))
+    uploadPending();
+}
+
+bool Model::importModel(std::string const &path, JobSystem *jobSystem) {
+  PROFILE_FUNCTION();
+
+  std::string cachePath = MeshCache::getCachePath(path);
+  uint64_t sourceHash = 0;
+  bool hashed = MeshCache::hashFile(path, sourceHash);
+  if (hashed && importCache(path, sourceHash, jobSystem)) {
+    Logger::model->info("Successfully loaded model from cache: {}", path);
+    return true;
+  }
+
+  // Reading and post-processing are separate steps so the scene can be
+  // measured as authored
   Assimp::Importer importer;
-  const aiScene *scene = importer.ReadFile(
-      path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-                aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+  const aiScene *scene;
+  {
+    PROFILE_SCOPE("Assimp::Importer::ReadFile");
+    scene = importer.ReadFile(path, 0);
+  }
 
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
     Logger::model->error("Error: ASSIMP::{}", importer.GetErrorString());
-    return;
+    return false;
   }
 
+  SceneCounts authored(scene);
+  {
+    PROFILE_SCOPE("Assimp::Importer::ApplyPostProcessing");
+    scene = importer.ApplyPostProcessing(getImportFlags());
+  }
+  if (!scene) {
+    Logger::model->error("Error: ASSIMP::{}", importer.GetErrorString());
+    return false;
+  }
+
+  SceneCounts processed(scene);
+  Logger::model->info(
+      "Import profile {} on {}: {} -> {} meshes, {} -> {} vertices, {} -> {} "
+      "indices, {} -> {} materials, {} -> {} nodes",
+      getImportProfileName(importProfile), path, authored.meshes,
+      processed.meshes, authored.vertices, processed.vertices,
+      authored.indices, processed.indices, authored.materials,
+      processed.materials, authored.nodes, processed.nodes);
+
   directory = path.substr(0, path.find_last_of('/'));
-  processNode(scene->mRootNode, scene, glm::mat4(1.0f));
+  sourcePath = path;
+
+  // The node walk and material lookups are cheap and stay serial, so every
+  // job knows its slice of the shared arrays up front
+  std::vector<MeshImport> imports;
+  processNode(scene->mRootNode, scene, glm::mat4(1.0f), imports);
+
+  size_t flatVertexCount = flatVertices.size() / FLAT_VERTEX_FLOATS;
+  size_t flatIndexCount = flatIndices.size();
+  for (MeshImport &import : imports) {
+    import.flatVertexOffset = flatVertexCount;
+    import.flatIndexOffset = flatIndexCount;
+    flatVertexCount += import.mesh->mNumVertices;
+    flatIndexCount += countIndices(import.mesh);
+  }
+  if (residency == GeometryResidency::Full) {
+    flatVertices.resize(flatVertexCount * FLAT_VERTEX_FLOATS);
+    flatIndices.resize(flatIndexCount);
+  }
+
+  size_t firstMesh = meshes.size();
+  size_t firstTexture = stagedTextures.size();
+  meshes.resize(firstMesh + imports.size());
+  meshSources.resize(meshes.size());
+  for (size_t i = 0; i < imports.size(); i++) {
+    aiMaterial *material = scene->mMaterials[imports[i].mesh->mMaterialIndex];
+    std::vector<Texture> &textures = meshes[firstMesh + i].textures;
+
+    const std::pair<aiTextureType, const char *> textureTypes[] = {
+        {aiTextureType_DIFFUSE, "texture_diffuse"},
+        {aiTextureType_SPECULAR, "texture_specular"},
+        {aiTextureType_HEIGHT, "texture_normal"},
+        {aiTextureType_AMBIENT, "texture_height"}};
+    for (const auto &textureType : textureTypes) {
+      std::vector<Texture> maps = loadMaterialTextures(
+          material, textureType.first, textureType.second);
+      textures.insert(textures.end(), maps.begin(), maps.end());
+    }
+  }
+
+  stagedTextures.resize(textures_loaded.size());
+  for (size_t i = firstTexture; i < stagedTextures.size(); i++) {
+    const aiTexture *embedded =
+        findEmbeddedTexture(textures_loaded[i].path, scene);
+    if (embedded) {
+      stagedTextures[i].embeddedData =
+          reinterpret_cast<const unsigned char *>(embedded->pcData);
+      stagedTextures[i].embeddedSize = embedded->mWidth;
+    }
+  }
+
+  JobCounter counter;
+  for (size_t i = 0; i < imports.size(); i++) {
+    Mesh &mesh = meshes[firstMesh + i];
+    MeshImport &import = imports[i];
+    if (jobSystem)
+      jobSystem->submit(
+          [this, &import, scene, &mesh] { processMesh(import, scene, mesh); },
+          &counter);
+    else
+      processMesh(import, scene, mesh);
+  }
+  decodeTextures(firstTexture, jobSystem, counter);
+  if (jobSystem)
+    jobSystem->wait(counter);
 
-  Logger::model->info("Successfully loaded model: {}", path);
+  for (MeshImport &import : imports) {
+    for (Mesh &part : import.parts)
+      meshes.push_back(std::move(part));
+  }
+  meshSources.resize(meshes.size());
+
+  if (hashed)
+    cookCache(cachePath, sourceHash, scene, firstMesh);
+
+  VertexCacheStats originalCache;
+  VertexCacheStats optimizedCache;
+  for (const MeshImport &import : imports) {
+    originalCache += import.originalCache;
+    optimizedCache += import.optimizedCache;
+  }
+  Logger::model->info("Vertex cache of {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} "
+                      "-> {:.3f}",
+                      path, originalCache.getAcmr(), optimizedCache.getAcmr(),
+                      originalCache.getAtvr(), optimizedCache.getAtvr());
+
+  Logger::model->info("Successfully imported model: {} ({} meshes, {} "
+                      "textures)",
+                      path, meshes.size() - firstMesh,
+                      stagedTextures.size() - firstTexture);
+  return true;
+}
+
+// Meshes upload straight from the mapped pages, so the cache stays mapped
+// until the last of them is on the GPU
+bool Model::importCache(const std::string &path, uint64_t sourceHash,
+                        JobSystem *jobSystem) {
+  std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>();
+  if (!cache->open(MeshCache::getCachePath(path), sourceHash,
+                   getImportFlags(), vertexLayout, optimizeFlags))
+    return false;
+
+  directory = path.substr(0, path.find_last_of('/'));
+  sourcePath = path;
+
+  // Cache textures are matched against textures_loaded by path, like
+  // material textures are
+  size_t firstTexture = textures_loaded.size();
+  std::vector<Texture> cacheTextures(cache->getTextureCount());
+  for (size_t i = 0; i < cacheTextures.size(); i++) {
+    MeshCacheTexture cacheTexture = cache->getTexture(i);
+
+    auto found = loadedTextureIndices.find(cacheTexture.path);
+    if (found != loadedTextureIndices.end()) {
+      cacheTextures[i] = textures_loaded[found->second];
+    } else {
+      cacheTextures[i] = Texture{0, cacheTexture.type, cacheTexture.path};
+      loadedTextureIndices[cacheTexture.path] = textures_loaded.size();
+      textures_loaded.push_back(cacheTextures[i]);
+      stagedTextures.push_back(
+          TextureStaging{cacheTexture.data, cacheTexture.size});
+    }
+  }
+
+  size_t firstMesh = meshes.size();
+  meshes.resize(firstMesh + cache->getMeshCount());
+  meshSources.resize(meshes.size());
+  for (size_t i = 0; i < cache->getMeshCount(); i++) {
+    MeshCacheMesh cacheMesh = cache->getMesh(i);
+    Mesh &mesh = meshes[firstMesh + i];
+    mesh.transform = cacheMesh.transform;
+    mesh.vertexLayout = vertexLayout;
+    mesh.positionOffset = cacheMesh.positionOffset;
+    mesh.positionScale = cacheMesh.positionScale;
+    mesh.meshlets.assign(cacheMesh.meshlets,
+                         cacheMesh.meshlets + cacheMesh.meshletCount);
+    mesh.lods.assign(cacheMesh.lods, cacheMesh.lods + cacheMesh.lodCount);
+    mesh.boundsCenter = cacheMesh.boundsCenter;
+    mesh.boundsRadius = cacheMesh.boundsRadius;
+    for (uint32_t texture : cacheMesh.textures)
+      mesh.textures.push_back(cacheTextures[texture]);
+    meshSources[firstMesh + i] =
+        MeshSource{cache, cacheMesh.vertices, cacheMesh.vertexCount,
+                   cacheMesh.indices, cacheMesh.indexCount};
+
+    // Full keeps the CPU geometry a fresh import keeps, packed layouts
+    // decoded back to float vertices
+    if (residency != GeometryResidency::Full)
+      continue;
+    mesh.unpack(cacheMesh.vertices, cacheMesh.vertexCount);
+    mesh.indices.assign(cacheMesh.indices,
+                        cacheMesh.indices + cacheMesh.indexCount);
+
+    // Optionally remove this, only used for soft body physics. Only the
+    // full detail level, the LODs follow it
+    size_t vertexOffset = flatVertices.size() / FLAT_VERTEX_FLOATS;
+    size_t indexOffset = flatIndices.size();
+    uint32_t indexCount = cacheMesh.lodCount ? cacheMesh.lods[0].indexCount
+                                             : cacheMesh.indexCount;
+    flatVertices.resize(flatVertices.size() +
+                        mesh.vertices.size() * FLAT_VERTEX_FLOATS);
+    flatIndices.resize(flatIndices.size() + indexCount);
+    writeFlatGeometry(mesh.vertices, mesh.indices.data(), indexCount,
+                      static_cast<int>(vertexOffset),
+                      flatVertices.data() + vertexOffset * FLAT_VERTEX_FLOATS,
+                      flatIndices.data() + indexOffset);
+  }
+
+  JobCounter counter;
+  decodeTextures(firstTexture, jobSystem, counter);
+  if (jobSystem)
+    jobSystem->wait(counter);
+  return true;
+}
+
+void Model::cookCache(const std::string &cachePath, uint64_t sourceHash,
+                      const aiScene *scene, size_t firstMesh) {
+  std::vector<MeshCacheTexture> cacheTextures;
+  std::vector<MeshCacheMesh> cacheMeshes;
+
+  for (size_t i = firstMesh; i < meshes.size(); i++) {
+    const Mesh &mesh = meshes[i];
+    MeshCacheMesh cacheMesh;
+    cacheMesh.transform = mesh.transform;
+    if (vertexLayout == VertexLayout::Float)
+      cacheMesh.vertices = mesh.vertices.data();
+    else
+      cacheMesh.vertices = mesh.packedVertices.data();
+    cacheMesh.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    cacheMesh.positionOffset = mesh.positionOffset;
+    cacheMesh.positionScale = mesh.positionScale;
+    cacheMesh.indices = mesh.indices.data();
+    cacheMesh.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    cacheMesh.meshlets = mesh.meshlets.data();
+    cacheMesh.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+    cacheMesh.lods = mesh.lods.data();
+    cacheMesh.lodCount = static_cast<uint32_t>(mesh.lods.size());
+    cacheMesh.boundsCenter = mesh.boundsCenter;
+    cacheMesh.boundsRadius = mesh.boundsRadius;
+
+    for (const Texture &texture : mesh.textures) {
+      uint32_t index = 0;
+      while (index < cacheTextures.size() &&
+             cacheTextures[index].path != texture.path)
+        index++;
+      if (index == cacheTextures.size()) {
+        const aiTexture *embedded = findEmbeddedTexture(texture.path, scene);
+        cacheTextures.push_back(MeshCacheTexture{
+            texture.type, texture.path,
+            embedded ? reinterpret_cast<const unsigned char *>(embedded->pcData)
+                     : nullptr,
+            embedded ? embedded->mWidth : 0});
+      }
+      cacheMesh.textures.push_back(index);
+    }
+    cacheMeshes.push_back(std::move(cacheMesh));
+  }
+
+  MeshCache::write(cachePath, sourceHash, getImportFlags(), vertexLayout,
+                   optimizeFlags, cacheTextures, cacheMeshes);
+}
+
+// Textures some other model or Texture2D already holds come back from the
+// registry decoded, or are waited for while another import decodes them
+void Model::decodeTextures(size_t firstTexture, JobSystem *jobSystem,
+                           JobCounter &counter) {
+  for (size_t i = firstTexture; i < stagedTextures.size(); i++) {
+    auto decode = [this, i] {
+      PROFILE_SCOPE("Model::decodeTexture");
+      TextureRegistry *registry = TextureRegistry::getInstance();
+      TextureStaging &staging = stagedTextures[i];
+      Texture &texture = textures_loaded[i];
+      if (texture.path[0] == '*') {
+        // Compressed embedded texture like PNG or JPG
+        static const unsigned char none = 0;
+        texture.shared = registry->acquire(
+            sourcePath + texture.path,
+            staging.embeddedData ? staging.embeddedData : &none,
+            staging.embeddedData ? staging.embeddedSize : 0);
+      } else {
+        texture.shared = registry->acquire(directory + '/' + texture.path);
+      }
+      registry->decode(*texture.shared);
+      staging.embeddedData = nullptr;
+      staging.embeddedSize = 0;
+    };
+
+    if (jobSystem)
+      jobSystem->submit(decode, &counter);
+    else
+      decode();
+  }
+}
+
+bool Model::uploadPending() {
+  UploadBudget unlimited;
+  return uploadPending(unlimited);
+}
+
+bool Model::uploadPending(UploadBudget &budget) {
+  if (isUploaded())
+    return true;
+
+  PROFILE_FUNCTION();
+  bool meshesPending = uploadedMeshes < meshes.size();
+
+  // Meshes reference texture ids, so textures go first. Shared textures
+  // already on the GPU cost nothing
+  while (uploadedTextures < stagedTextures.size() && !budget.isSpent()) {
+    Texture &texture = textures_loaded[uploadedTextures];
+    budget.spend(TextureRegistry::getInstance()->upload(*texture.shared));
+    if (texture.shared->hasFailed())
+      Logger::model->error("Texture failed to load at path: {}",
+                           texture.path);
+    texture.id = texture.shared->getId();
+    uploadedTextures++;
+  }
+
+  if (mergeMeshes && uploadedTextures == stagedTextures.size() &&
+      uploadedMeshes == 0 && !meshes.empty() && !batch.isAllocated() &&
+      ModelBatch::isSupported())
+    allocateBatch();
+
+  while (uploadedTextures == stagedTextures.size() &&
+         uploadedMeshes < meshes.size() && !budget.isSpent()) {
+    Mesh &mesh = meshes[uploadedMeshes];
+    for (Texture &texture : mesh.textures) {
+      auto found = loadedTextureIndices.find(texture.path);
+      if (found != loadedTextureIndices.end()) {
+        texture.id = textures_loaded[found->second].id;
+        texture.shared = textures_loaded[found->second].shared;
+      }
+    }
+
+    // Meshes added to the public vector directly have no source. Taking it
+    // out unmaps the cache once its last mesh is uploaded
+    MeshSource source{};
+    if (uploadedMeshes < meshSources.size())
+      std::swap(source, meshSources[uploadedMeshes]);
+    bool batched = addToBatch(mesh, source);
+    size_t bytes;
+    if (source.cache) {
+      if (!batched)
+        mesh.upload(source.vertices, source.vertexCount, source.indices,
+                    source.indexCount);
+      bytes = source.vertexCount * mesh.getVertexStride() +
+              source.indexCount * mesh.getIndexStride();
+    } else {
+      if (!batched)
+        mesh.upload();
+      bytes = mesh.vertices.size() * mesh.getVertexStride() +
+              mesh.indices.size() * mesh.getIndexStride();
+    }
+    budget.spend(bytes);
+    geometryMemory.gpuBytes += bytes;
+
+    if (residency == GeometryResidency::GpuAndPositions)
+      keepCollisionGeometry(mesh, source);
+    if (residency != GeometryResidency::Full) {
+      geometryMemory.releasedBytes += getCpuBytes(mesh);
+      mesh.releaseGeometry();
+    }
+    uploadedMeshes++;
+  }
+
+  if (meshesPending && isUploaded()) {
+    GeometryMemory memory = getGeometryMemory();
+    Logger::model->info("Geometry of {}: {:.2f} MB on the GPU, {:.2f} MB "
+                        "kept on the CPU, {:.2f} MB freed ({})",
+                        sourcePath, memory.gpuBytes / (1024.0 * 1024.0),
+                        memory.cpuBytes / (1024.0 * 1024.0),
+                        memory.releasedBytes / (1024.0 * 1024.0),
+                        getResidencyName(residency));
+  }
+  return isUploaded();
+}
+
+void Model::allocateBatch() {
+  size_t meshCount = 0;
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+  GLenum indexType = GL_UNSIGNED_BYTE;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const Mesh &mesh = meshes[i];
+    if (mesh.vertexLayout != vertexLayout)
+      continue;
+
+    bool cached = i < meshSources.size() && meshSources[i].cache;
+    const unsigned int *indices =
+        cached ? meshSources[i].indices : mesh.indices.data();
+    size_t meshIndexCount =
+        cached ? meshSources[i].indexCount : mesh.indices.size();
+    GLenum meshIndexType = ElementBuffer::chooseType(indices, meshIndexCount);
+    if (ElementBuffer::getTypeSize(meshIndexType) >
+        ElementBuffer::getTypeSize(indexType))
+      indexType = meshIndexType;
+
+    meshCount++;
+    vertexCount += cached ? meshSources[i].vertexCount : mesh.vertices.size();
+    indexCount += meshIndexCount;
+  }
+
+  batch.allocate(vertexLayout, meshCount, vertexCount, indexCount, indexType);
+  Logger::model->info("Merging {} meshes of {} into one buffer ({} "
+                      "vertices, {} indices of {} bytes)",
+                      meshCount, sourcePath, vertexCount, indexCount,
+                      ElementBuffer::getTypeSize(indexType));
+}
+
+// Meshes that do not fit the batch, such as ones imported after it was
+// sized, get their own buffers
+bool Model::addToBatch(Mesh &mesh, const MeshSource &source) {
+  if (!batch.isAllocated())
+    return false;
+  if (source.cache)
+    return batch.add(mesh, uploadedMeshes, source.vertices,
+                     source.vertexCount, source.indices, source.indexCount);
+  if (mesh.vertexLayout == VertexLayout::Float)
+    return batch.add(mesh, uploadedMeshes, mesh.vertices.data(),
+                     mesh.vertices.size(), mesh.indices.data(),
+                     mesh.indices.size());
+
+  if (mesh.packedVertices.empty())
+    mesh.pack();
+  bool added = batch.add(mesh, uploadedMeshes, mesh.packedVertices.data(),
+                         mesh.vertices.size(), mesh.indices.data(),
+                         mesh.indices.size());
+  // Only the GPU copy is drawn, like Mesh::upload() does
+  if (added)
+    std::vector<unsigned char>().swap(mesh.packedVertices);
+  return added;
+}
+
+GeometryMemory Model::getGeometryMemory() const {
+  GeometryMemory memory = geometryMemory;
+  memory.cpuBytes = flatVertices.capacity() * sizeof(float) +
+                    flatIndices.capacity() * sizeof(int) +
+                    collisionPositions.capacity() * sizeof(glm::vec3) +
+                    collisionIndices.capacity() * sizeof(unsigned int);
+  for (const Mesh &mesh : meshes)
+    memory.cpuBytes += getCpuBytes(mesh);
+  return memory;
+}
+
+// Positions come from the float vertices when the mesh has them, else from
+// the mapped cache in the mesh's layout
+void Model::keepCollisionGeometry(const Mesh &mesh, const MeshSource &source) {
+  size_t vertexCount = source.cache ? source.vertexCount : mesh.vertices.size();
+  const unsigned int *indices =
+      source.cache ? source.indices : mesh.indices.data();
+  // Only the full detail level, the LODs follow it
+  size_t indexCount = source.cache ? source.indexCount : mesh.indices.size();
+  if (!mesh.lods.empty())
+    indexCount = mesh.lods[0].indexCount;
+
+  unsigned int firstVertex =
+      static_cast<unsigned int>(collisionPositions.size());
+  const Vertex *vertices = source.cache
+                              ? static_cast<const Vertex *>(source.vertices)
+                              : mesh.vertices.data();
+  collisionPositions.reserve(collisionPositions.size() + vertexCount);
+  for (size_t i = 0; i < vertexCount; i++) {
+    glm::vec3 position;
+    if (!source.cache || mesh.vertexLayout == VertexLayout::Float) {
+      position = vertices[i].Position;
+    } else if (mesh.vertexLayout == VertexLayout::Compact) {
+      const CompactVertex &vertex =
+          static_cast<const CompactVertex *>(source.vertices)[i];
+      position = glm::vec3(vertex.Position[0], vertex.Position[1],
+                           vertex.Position[2]);
+    } else {
+      const QuantizedVertex &vertex =
+          static_cast<const QuantizedVertex *>(source.vertices)[i];
+      glm::vec3 unit(vertex.Position[0], vertex.Position[1],
+                     vertex.Position[2]);
+      position = mesh.positionOffset + unit / 65535.0f * mesh.positionScale;
+    }
+    collisionPositions.push_back(
+        glm::vec3(mesh.transform * glm::vec4(position, 1.0f)));
+  }
+
+  collisionIndices.reserve(collisionIndices.size() + indexCount);
+  for (size_t i = 0; i < indexCount; i++)
+    collisionIndices.push_back(firstVertex + indices[i]);
+}
+
+bool Model::isUploaded() const {
+  return uploadedTextures == stagedTextures.size() &&
+         uploadedMeshes == meshes.size();
 }
 
 void Model::processNode(aiNode *node, const aiScene *scene,
-                        const glm::mat4 &parentTransform) {
+                        const glm::mat4 &parentTransform,
+                        std::vector<MeshImport> &imports) {
   glm::mat4 nodeTransform =
       parentTransform * aiMatrix4x4ToGlm(node->mTransformation);
 
   for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-    aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-    Mesh processedMesh = processMesh(mesh, scene);
-    processedMesh.transform = nodeTransform;
-    meshes.push_back(processedMesh);
+    const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+    imports.push_back(MeshImport{mesh, nodeTransform, 0, 0});
   }
 
   for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene, nodeTransform);
+    processNode(node->mChildren[i], scene, nodeTransform, imports);
   }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
-  int vertexOffset =
-      flatVertices.size() /
-      3; // Optionally remove this, only used for soft body physics
+// Runs on a worker: writes only to its own mesh, its own import and its own
+// slice of the flat arrays
+void Model::processMesh(MeshImport &import, const aiScene *scene,
+                        Mesh &result) {
+  PROFILE_FUNCTION();
 
-  std::vector<Vertex> vertices;
-  std::vector<unsigned int> indices;
-  std::vector<Texture> textures;
+  const aiMesh *mesh = import.mesh;
+  std::vector<Vertex> &vertices = result.vertices;
+  std::vector<unsigned int> &indices = result.indices;
+  result.transform = import.transform;
+
+  // Faces are triangulated on import
+  vertices.reserve(mesh->mNumVertices);
+  indices.reserve(countIndices(mesh));
 
   for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
     Vertex vertex;
@@ -117,81 +707,86 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
       vertex.Bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
     }
 
-    // Optionally remove this, only used for soft body physics
-    flatVertices.push_back(vertex.Position.x);
-    flatVertices.push_back(vertex.Position.y);
-    flatVertices.push_back(vertex.Position.z);
-
-    flatVertices.push_back(vertex.Normal.x);
-    flatVertices.push_back(vertex.Normal.y);
-    flatVertices.push_back(vertex.Normal.z);
-
-    flatVertices.push_back(vertex.TexCoords.x);
-    flatVertices.push_back(vertex.TexCoords.y);
-
-    flatVertices.push_back(vertex.Tangent.x);
-    flatVertices.push_back(vertex.Tangent.y);
-    flatVertices.push_back(vertex.Tangent.z);
-
-    flatVertices.push_back(vertex.Bitangent.x);
-    flatVertices.push_back(vertex.Bitangent.y);
-    flatVertices.push_back(vertex.Bitangent.z);
-    // End of optionally remove this
-
-    // Not included in optionally removing
     vertices.push_back(vertex);
   }
 
   for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[i];
-    for (unsigned int j = 0; j < face.mNumIndices; j++) {
+    const aiFace &face = mesh->mFaces[i];
+    for (unsigned int j = 0; j < face.mNumIndices; j++)
       indices.push_back(face.mIndices[j]);
-      flatIndices.push_back(face.mIndices[j] + vertexOffset);
-    }
   }
 
-  aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-  std::vector<Texture> diffuseMaps = loadMaterialTextures(
-      material, aiTextureType_DIFFUSE, "texture_diffuse", scene);
-  textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-  std::vector<Texture> specularMaps = loadMaterialTextures(
-      material, aiTextureType_SPECULAR, "texture_specular", scene);
-  textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-  std::vector<Texture> normalMaps = loadMaterialTextures(
-      material, aiTextureType_HEIGHT, "texture_normal", scene);
-  textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-
-  std::vector<Texture> heightMaps = loadMaterialTextures(
-      material, aiTextureType_AMBIENT, "texture_height", scene);
-  textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+  // Reorders triangles and vertices, the counts stay the same so the flat
+  // slices still fit. Leftover points and lines would be torn apart
+  bool triangles = mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+  import.originalCache =
+      MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+  if (triangles)
+    MeshOptimizer::optimize(vertices, indices, optimizeFlags);
+  import.optimizedCache =
+      MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+  // Optionally remove this, only used for soft body physics
+  if (residency == GeometryResidency::Full)
+    writeFlatGeometry(
+        vertices, indices.data(), indices.size(),
+        static_cast<int>(import.flatVertexOffset),
+        flatVertices.data() + import.flatVertexOffset * FLAT_VERTEX_FLOATS,
+        flatIndices.data() + import.flatIndexOffset);
+  // End of optionally remove this
+
+  std::vector<MeshPart> parts;
+  if (triangles && (optimizeFlags & MeshOptimizer::ShortIndices))
+    parts = MeshOptimizer::splitForShortIndices(vertices, indices);
+  for (size_t i = 1; i < parts.size(); i++) {
+    Mesh part;
+    part.vertices = std::move(parts[i].vertices);
+    part.indices = std::move(parts[i].indices);
+    part.textures = result.textures;
+    part.transform = result.transform;
+    import.parts.push_back(std::move(part));
+  }
+  if (!parts.empty()) {
+    vertices = std::move(parts[0].vertices);
+    indices = std::move(parts[0].indices);
+  }
 
-  return Mesh(vertices, indices, textures);
+  // Meshlets, LODs and packing come last, they depend on the final index
+  // order. LODs go after the meshlets, which cover all of indices
+  auto finish = [&](Mesh &part) {
+    if (triangles && (optimizeFlags & MeshOptimizer::Meshlets))
+      part.meshlets =
+          MeshOptimizer::buildMeshlets(part.vertices, part.indices);
+    if (triangles && (optimizeFlags & MeshOptimizer::Lods))
+      part.lods = MeshOptimizer::buildLods(part.vertices, part.indices);
+    MeshOptimizer::computeBounds(part.vertices, part.boundsCenter,
+                                 part.boundsRadius);
+    part.vertexLayout = vertexLayout;
+    part.pack();
+  };
+  finish(result);
+  for (Mesh &part : import.parts)
+    finish(part);
 }
 
+// Texture ids stay 0 until uploadPending() creates the GL textures
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat,
                                                  aiTextureType type,
-                                                 std::string typeName,
-                                                 const aiScene *scene) {
+                                                 std::string typeName) {
   std::vector<Texture> textures;
   for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
     mat->GetTexture(type, i, &str);
 
-    bool skip = false;
-    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-      if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-        textures.push_back(textures_loaded[j]);
-        skip = true;
-        break;
-      }
-    }
-    if (!skip) {
+    auto found = loadedTextureIndices.find(str.C_Str());
+    if (found != loadedTextureIndices.end()) {
+      textures.push_back(textures_loaded[found->second]);
+    } else {
       Texture texture;
-      texture.id = TextureFromFile(str.C_Str(), this->directory, scene);
+      texture.id = 0;
       texture.type = typeName;
       texture.path = str.C_Str();
+      loadedTextureIndices[texture.path] = textures_loaded.size();
       textures.push_back(texture);
       textures_loaded.push_back(texture);
     }
@@ -221,84 +816,107 @@ void Model::setTransform(const glm::mat4 &transform) {
   this->transform = transform;
 }
 
-static unsigned int TextureFromFile(const char *path,
-                                    const std::string &directory,
-                                    const aiScene *scene, bool gamma) {
-  stbi_set_flip_vertically_on_load(true);
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-
-  std::string texturePath(path);
-
-  if (texturePath[0] == '*') {
-    // Handle embedded texture
-    int texIndex = std::stoi(texturePath.substr(1)); // removes '*'
-    const aiTexture *tex = scene->mTextures[texIndex];
-
-    if (tex) {
-      if (tex->mHeight == 0) {
-        // Compressed format like PNG or JPG
-        int width, height, nrComponents;
-        unsigned char *data = stbi_load_from_memory(
-            reinterpret_cast<unsigned char *>(tex->pcData), tex->mWidth, &width,
-            &height, &nrComponents, 0);
-
-        if (data) {
-          GLenum format = (nrComponents == 1)   ? GL_RED
-                          : (nrComponents == 3) ? GL_RGB
-                                                : GL_RGBA;
-
-          glBindTexture(GL_TEXTURE_2D, textureID);
-          glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                       GL_UNSIGNED_BYTE, data);
-          glGenerateMipmap(GL_TEXTURE_2D);
-
-          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                          GL_LINEAR_MIPMAP_LINEAR);
-          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-          stbi_image_free(data);
-        } else {
-          Logger::model->error(
-              "Failed to load embedded texture from memory: {}", path);
-        }
-      } else {
-        Logger::model->warn(
-            "Uncompressed embedded texture not supported (height > 0)");
-      }
+const char *Model::getImportProfileName(ImportProfile profile) {
+  switch (profile) {
+  case ImportProfile::EditorFast:
+    return "editor-fast";
+  case ImportProfile::RuntimeOptimized:
+    return "runtime-optimized";
+  }
+  return "unknown";
+}
+
+const char *Model::getResidencyName(GeometryResidency residency) {
+  switch (residency) {
+  case GeometryResidency::GpuOnly:
+    return "gpu";
+  case GeometryResidency::GpuAndPositions:
+    return "positions";
+  case GeometryResidency::Full:
+    return "full";
+  }
+  return "unknown";
+}
+
+bool Model::parseResidency(const char *name, GeometryResidency &residency) {
+  const GeometryResidency residencies[] = {GeometryResidency::GpuOnly,
+                                           GeometryResidency::GpuAndPositions,
+                                           GeometryResidency::Full};
+
+  for (GeometryResidency candidate : residencies) {
+    if (std::strcmp(name, getResidencyName(candidate)) == 0) {
+      residency = candidate;
+      return true;
     }
-  } else {
-    // External texture file
-    std::string filename = directory + '/' + path;
-    int width, height, nrComponents;
-    unsigned char *data =
-        stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-      GLenum format = (nrComponents == 1)   ? GL_RED
-                      : (nrComponents == 3) ? GL_RGB
-                                            : GL_RGBA;
-
-      glBindTexture(GL_TEXTURE_2D, textureID);
-      glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                   GL_UNSIGNED_BYTE, data);
-      glGenerateMipmap(GL_TEXTURE_2D);
-
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                      GL_LINEAR_MIPMAP_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-      stbi_image_free(data);
-    } else {
-      Logger::model->error("Texture failed to load at path: {}", filename);
-      stbi_image_free(data);
+  }
+  return false;
+}
+
+bool Model::parseImportProfile(const char *name, ImportProfile &profile) {
+  const ImportProfile profiles[] = {ImportProfile::EditorFast,
+                                    ImportProfile::RuntimeOptimized};
+
+  for (ImportProfile candidate : profiles) {
+    if (std::strcmp(name, getImportProfileName(candidate)) == 0) {
+      profile = candidate;
+      return true;
     }
   }
+  return false;
+}
+
+unsigned int Model::getImportFlags() const {
+  unsigned int flags = BASE_IMPORT_FLAGS;
+  if (importProfile == ImportProfile::RuntimeOptimized) {
+    flags |= aiProcess_RemoveRedundantMaterials | aiProcess_OptimizeMeshes |
+             aiProcess_OptimizeGraph;
+    // MeshOptimizer reorders for the cache again, better than Assimp does
+    if (!(optimizeFlags & MeshOptimizer::VertexCache))
+      flags |= aiProcess_ImproveCacheLocality;
+  }
+  return flags;
+}
+
+static const aiTexture *findEmbeddedTexture(const std::string &path,
+                                            const aiScene *scene) {
+  if (path.empty() || path[0] != '*')
+    return nullptr;
+
+  int texIndex = std::stoi(path.substr(1)); // removes '*'
+  if (texIndex < 0 ||
+      static_cast<unsigned int>(texIndex) >= scene->mNumTextures)
+    return nullptr;
+
+  const aiTexture *tex = scene->mTextures[texIndex];
+  if (tex && tex->mHeight != 0) {
+    Logger::model->warn(
+        "Uncompressed embedded texture not supported (height > 0)");
+    return nullptr;
+  }
+  return tex;
+}
+
+static size_t countIndices(const aiMesh *mesh) {
+  if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+    return static_cast<size_t>(mesh->mNumFaces) * 3;
 
-  return textureID;
+  size_t count = 0;
+  for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    count += mesh->mFaces[i].mNumIndices;
+  return count;
+}
+
+static size_t countNodes(const aiNode *node) {
+  size_t count = 1;
+  for (unsigned int i = 0; i < node->mNumChildren; i++)
+    count += countNodes(node->mChildren[i]);
+  return count;
+}
+
+static size_t getCpuBytes(const Mesh &mesh) {
+  return mesh.vertices.capacity() * sizeof(Vertex) +
+         mesh.indices.capacity() * sizeof(unsigned int) +
+         mesh.packedVertices.capacity();
 }
 
 static glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 &from) {
@@ -306,3 +924,32 @@ static glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 &from) {
                    from.c2, from.d2, from.a3, from.b3, from.c3, from.d3,
                    from.a4, from.b4, from.c4, from.d4);
 }
+
+// Optionally remove this, only used for soft body physics
+static void writeFlatGeometry(const std::vector<Vertex> &vertices,
+                              const unsigned int *indices, size_t indexCount,
+                              int vertexOffset, float *flatVertex,
+                              int *flatIndex) {
+  for (const Vertex &vertex : vertices) {
+    *flatVertex++ = vertex.Position.x;
+    *flatVertex++ = vertex.Position.y;
+    *flatVertex++ = vertex.Position.z;
+
+    *flatVertex++ = vertex.Normal.x;
+    *flatVertex++ = vertex.Normal.y;
+    *flatVertex++ = vertex.Normal.z;
+
+    *flatVertex++ = vertex.TexCoords.x;
+    *flatVertex++ = vertex.TexCoords.y;
+
+    *flatVertex++ = vertex.Tangent.x;
+    *flatVertex++ = vertex.Tangent.y;
+    *flatVertex++ = vertex.Tangent.z;
+
+    *flatVertex++ = vertex.Bitangent.x;
+    *flatVertex++ = vertex.Bitangent.y;
+    *flatVertex++ = vertex.Bitangent.z;
+  }
+  for (size_t i = 0; i < indexCount; i++)
+    *flatIndex++ = static_cast<int>(indices[i]) + vertexOffset;
+}
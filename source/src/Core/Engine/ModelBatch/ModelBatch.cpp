@@ -0,0 +1,328 @@
+#include "ModelBatch.h"
+#include "ElementBuffer.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+// GL 4.3 names missing from the 3.3 GLAD loader
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+typedef void(APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode,
+                                                      GLenum type,
+                                                      const void *indirect,
+                                                      GLsizei drawCount,
+                                                      GLsizei stride);
+
+static bool sameTextures(const Mesh &first, const Mesh &second);
+static bool lessTextures(const Mesh &first, const Mesh &second);
+
+// Match main.glsl
+static constexpr GLuint DRAW_ID_LOCATION = 5;
+static constexpr GLuint DRAW_BUFFER_BINDING = 0;
+
+static MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+
+ModelBatch::ModelBatch()
+    : vao(0), vbo(0), ebo(0), drawIdBuffer(0), commandBuffer(0),
+      drawBuffer(0), layout(VertexLayout::Float), indexType(GL_UNSIGNED_INT),
+      meshCapacity(0), vertexCapacity(0), indexCapacity(0), vertexCount(0),
+      indexCount(0), materialsDirty(false) {}
+
+ModelBatch::~ModelBatch() { free(); }
+
+ModelBatch::ModelBatch(ModelBatch &&other) noexcept : ModelBatch() {
+  *this = std::move(other);
+}
+
+ModelBatch &ModelBatch::operator=(ModelBatch &&other) noexcept {
+  if (this == &other)
+    return *this;
+
+  free();
+  // The GL objects change hands, other no longer deletes them
+  vao = std::exchange(other.vao, 0);
+  vbo = std::exchange(other.vbo, 0);
+  ebo = std::exchange(other.ebo, 0);
+  drawIdBuffer = std::exchange(other.drawIdBuffer, 0);
+  commandBuffer = std::exchange(other.commandBuffer, 0);
+  drawBuffer = std::exchange(other.drawBuffer, 0);
+  layout = other.layout;
+  indexType = other.indexType;
+  meshCapacity = std::exchange(other.meshCapacity, 0);
+  vertexCapacity = std::exchange(other.vertexCapacity, 0);
+  indexCapacity = std::exchange(other.indexCapacity, 0);
+  vertexCount = std::exchange(other.vertexCount, 0);
+  indexCount = std::exchange(other.indexCount, 0);
+  entries = std::move(other.entries);
+  materials = std::move(other.materials);
+  materialsDirty = std::exchange(other.materialsDirty, false);
+  return *this;
+}
+
+void ModelBatch::loadFunctions(GLADloadproc loader) {
+  multiDrawElementsIndirect = nullptr;
+  if (GLVersion.major < 4 || (GLVersion.major == 4 && GLVersion.minor < 3)) {
+    Logger::modelBatch->warn("GL {}.{} has no multi-draw indirect, merged "
+                             "model draws disabled.",
+                             GLVersion.major, GLVersion.minor);
+    return;
+  }
+
+  multiDrawElementsIndirect = reinterpret_cast<MultiDrawElementsIndirectProc>(
+      loader("glMultiDrawElementsIndirect"));
+  if (!multiDrawElementsIndirect)
+    Logger::modelBatch->warn("glMultiDrawElementsIndirect not found, merged "
+                             "model draws disabled.");
+}
+
+bool ModelBatch::isSupported() { return multiDrawElementsIndirect; }
+
+void ModelBatch::allocate(VertexLayout layout, size_t meshCount,
+                          size_t vertexCount, size_t indexCount,
+                          unsigned int indexType) {
+  free();
+  this->layout = layout;
+  this->indexType = indexType;
+  meshCapacity = meshCount;
+  vertexCapacity = vertexCount;
+  indexCapacity = indexCount;
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &ebo);
+  glGenBuffers(1, &drawIdBuffer);
+  glGenBuffers(1, &commandBuffer);
+  glGenBuffers(1, &drawBuffer);
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * Mesh::getVertexStride(layout),
+               nullptr, GL_STATIC_DRAW);
+  Mesh::setupAttributes(layout);
+
+  // One id per instance; a command's base instance picks its draw's id, as
+  // GL 4.3 has no gl_DrawID
+  std::vector<uint32_t> drawIds(meshCount);
+  std::iota(drawIds.begin(), drawIds.end(), 0u);
+  glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+  glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(uint32_t),
+               drawIds.data(), GL_STATIC_DRAW);
+  glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT,
+                         sizeof(uint32_t), (void *)0);
+  glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+  glEnableVertexAttribArray(DRAW_ID_LOCATION);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               indexCount * ElementBuffer::getTypeSize(indexType), nullptr,
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool ModelBatch::isAllocated() const { return vao != 0; }
+
+bool ModelBatch::add(Mesh &mesh, size_t meshIndex, const void *vertexData,
+                     size_t vertexCount, const unsigned int *indexData,
+                     size_t indexCount) {
+  if (!vao || mesh.vertexLayout != layout || entries.size() == meshCapacity ||
+      this->vertexCount + vertexCount > vertexCapacity ||
+      this->indexCount + indexCount > indexCapacity)
+    return false;
+
+  GLenum meshIndexType = ElementBuffer::chooseType(indexData, indexCount);
+  if (ElementBuffer::getTypeSize(meshIndexType) >
+      ElementBuffer::getTypeSize(indexType))
+    return false;
+
+  PROFILE_FUNCTION();
+
+  // The copy target leaves the VAO's element buffer binding alone
+  size_t stride = Mesh::getVertexStride(layout);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, this->vertexCount * stride,
+                  vertexCount * stride, vertexData);
+
+  size_t indexStride = ElementBuffer::getTypeSize(indexType);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+  if (indexType == GL_UNSIGNED_INT) {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, this->indexCount * indexStride,
+                    indexCount * indexStride, indexData);
+  } else {
+    std::vector<unsigned char> narrowed =
+        ElementBuffer::narrow(indexData, indexCount, indexType);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, this->indexCount * indexStride,
+                    narrowed.size(), narrowed.data());
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  entries.push_back(Entry{meshIndex, static_cast<uint32_t>(this->indexCount),
+                          static_cast<int32_t>(this->vertexCount)});
+  this->vertexCount += vertexCount;
+  this->indexCount += indexCount;
+  mesh.attach(indexType, indexCount);
+  materialsDirty = true;
+  return true;
+}
+
+void ModelBatch::draw(Shader &shader, std::vector<Mesh> &meshes,
+                      const glm::mat4 &transform, const glm::vec3 &ambient,
+                      float shininess, const CullView *cullView,
+                      const LodView *lodView) {
+  if (entries.empty() || !multiDrawElementsIndirect)
+    return;
+
+  PROFILE_FUNCTION();
+
+  if (materialsDirty)
+    groupMaterials(meshes);
+
+  // LODs and culling are picked per mesh as without the batch; each pick
+  // becomes one command, a clustered mesh one per visible range
+  size_t indexStride = ElementBuffer::getTypeSize(indexType);
+  commands.clear();
+  drawData.resize(entries.size());
+  materialCommands.resize(materials.size() + 1);
+  for (size_t m = 0; m < materials.size(); m++) {
+    materialCommands[m] = commands.size();
+    const Material &material = materials[m];
+    for (size_t e = material.firstEntry;
+         e < material.firstEntry + material.entryCount; e++) {
+      const Entry &entry = entries[e];
+      Mesh &mesh = meshes[entry.meshIndex];
+      glm::mat4 model = transform * mesh.transform;
+      drawData[e] = DrawData{model, glm::vec4(mesh.positionOffset, 0.0f),
+                             glm::vec4(mesh.positionScale, 0.0f)};
+
+      bool clustered;
+      size_t firstIndex;
+      size_t drawCount;
+      if (!mesh.selectDraw(model, cullView, lodView, clustered, firstIndex,
+                           drawCount))
+        continue;
+
+      uint32_t drawId = static_cast<uint32_t>(e);
+      if (!clustered) {
+        commands.push_back(DrawCommand{
+            static_cast<uint32_t>(drawCount), 1,
+            entry.firstIndex + static_cast<uint32_t>(firstIndex),
+            entry.baseVertex, drawId});
+        continue;
+      }
+      const ClusterCuller &culler = mesh.getClusterCuller();
+      const std::vector<int> &counts = culler.getCounts();
+      const std::vector<const void *> &offsets = culler.getOffsets();
+      for (size_t r = 0; r < counts.size(); r++) {
+        uint32_t rangeFirst = static_cast<uint32_t>(
+            reinterpret_cast<uintptr_t>(offsets[r]) / indexStride);
+        commands.push_back(DrawCommand{static_cast<uint32_t>(counts[r]), 1,
+                                       entry.firstIndex + rangeFirst,
+                                       entry.baseVertex, drawId});
+      }
+    }
+  }
+  materialCommands[materials.size()] = commands.size();
+  if (commands.empty())
+    return;
+
+  // Respecified every frame, so a frame still in flight keeps its copy
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData),
+               drawData.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, drawBuffer);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand),
+               commands.data(), GL_STREAM_DRAW);
+
+  shader.setInt("u_Batched", 1);
+  shader.setInt("u_VertexLayout", static_cast<int>(layout));
+  shader.setVec3("material.ambient", ambient);
+  shader.setFloat("material.shininess", shininess);
+
+  glBindVertexArray(vao);
+  for (size_t m = 0; m < materials.size(); m++) {
+    size_t count = materialCommands[m + 1] - materialCommands[m];
+    if (count == 0)
+      continue;
+    meshes[entries[materials[m].firstEntry].meshIndex].bindTextures(shader);
+    multiDrawElementsIndirect(
+        GL_TRIANGLES, indexType,
+        reinterpret_cast<const void *>(materialCommands[m] *
+                                       sizeof(DrawCommand)),
+        static_cast<GLsizei>(count), 0);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  // Resets the active texture unit
+  glActiveTexture(GL_TEXTURE0);
+  shader.setInt("u_Batched", 0);
+}
+
+void ModelBatch::free() {
+  if (vao)
+    glDeleteVertexArrays(1, &vao);
+  unsigned int buffers[] = {vbo, ebo, drawIdBuffer, commandBuffer,
+                            drawBuffer};
+  for (unsigned int buffer : buffers) {
+    if (buffer)
+      glDeleteBuffers(1, &buffer);
+  }
+  vao = vbo = ebo = drawIdBuffer = commandBuffer = drawBuffer = 0;
+  meshCapacity = vertexCapacity = indexCapacity = 0;
+  vertexCount = indexCount = 0;
+  entries.clear();
+  materials.clear();
+  materialsDirty = false;
+}
+
+size_t ModelBatch::getMeshCount() const { return entries.size(); }
+
+size_t ModelBatch::getMaterialCount() const { return materials.size(); }
+
+// Sorting by texture ids puts meshes with the same textures next to each
+// other, each run is drawn by one call
+void ModelBatch::groupMaterials(const std::vector<Mesh> &meshes) {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [&meshes](const Entry &first, const Entry &second) {
+                     return lessTextures(meshes[first.meshIndex],
+                                         meshes[second.meshIndex]);
+                   });
+
+  materials.clear();
+  for (size_t e = 0; e < entries.size(); e++) {
+    if (materials.empty() ||
+        !sameTextures(meshes[entries[materials.back().firstEntry].meshIndex],
+                      meshes[entries[e].meshIndex]))
+      materials.push_back(Material{e, 0});
+    materials.back().entryCount++;
+  }
+  materialsDirty = false;
+}
+
+static bool sameTextures(const Mesh &first, const Mesh &second) {
+  if (first.textures.size() != second.textures.size())
+    return false;
+  for (size_t i = 0; i < first.textures.size(); i++) {
+    if (first.textures[i].id != second.textures[i].id ||
+        first.textures[i].type != second.textures[i].type)
+      return false;
+  }
+  return true;
+}
+
+static bool lessTextures(const Mesh &first, const Mesh &second) {
+  return std::lexicographical_compare(
+      first.textures.begin(), first.textures.end(), second.textures.begin(),
+      second.textures.end(), [](const Texture &a, const Texture &b) {
+        return a.id != b.id ? a.id < b.id : a.type < b.type;
+      });
+}
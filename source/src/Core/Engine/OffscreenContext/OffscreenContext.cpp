@@ -0,0 +1,200 @@
+#include "OffscreenContext.h"
+#include "Logger.h"
+#include <glad/glad.h>
+
+#ifdef SHADER_ENGINE_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+OffscreenContext::OffscreenContext()
+    : display(nullptr), context(nullptr), framebuffer(0), colorRenderbuffer(0),
+      depthRenderbuffer(0), width(0), height(0) {}
+
+OffscreenContext::~OffscreenContext() { free(); }
+
+bool OffscreenContext::isSupported() {
+#ifdef SHADER_ENGINE_HAS_EGL
+  return true;
+#else
+  return false;
+#endif
+}
+
+void *OffscreenContext::getProcAddress(const char *name) {
+#ifdef SHADER_ENGINE_HAS_EGL
+  return reinterpret_cast<void *>(eglGetProcAddress(name));
+#else
+  (void)name;
+  return nullptr;
+#endif
+}
+
+bool OffscreenContext::createContext() {
+#ifdef SHADER_ENGINE_HAS_EGL
+  Logger::offscreenContext->info("Creating EGL surfaceless context...");
+
+  EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+
+  // Prefer the surfaceless platform so no X11/Wayland server is required
+  auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (getPlatformDisplay)
+    eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                    EGL_DEFAULT_DISPLAY, nullptr);
+  if (eglDisplay == EGL_NO_DISPLAY)
+    eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  EGLint major, minor;
+  if (eglDisplay == EGL_NO_DISPLAY ||
+      !eglInitialize(eglDisplay, &major, &minor)) {
+    Logger::offscreenContext->error("Failed to initialize EGL display.");
+    return false;
+  }
+  Logger::offscreenContext->info("EGL {}.{} initialized.", major, minor);
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    Logger::offscreenContext->error("EGL does not support desktop OpenGL.");
+    eglTerminate(eglDisplay);
+    return false;
+  }
+
+  const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE,
+                                     EGL_OPENGL_BIT,
+                                     EGL_SURFACE_TYPE,
+                                     EGL_PBUFFER_BIT,
+                                     EGL_RED_SIZE,
+                                     8,
+                                     EGL_GREEN_SIZE,
+                                     8,
+                                     EGL_BLUE_SIZE,
+                                     8,
+                                     EGL_DEPTH_SIZE,
+                                     24,
+                                     EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1,
+                       &configCount) ||
+      configCount == 0) {
+    Logger::offscreenContext->error("No suitable EGL config found.");
+    eglTerminate(eglDisplay);
+    return false;
+  }
+
+  // Same version and profile the windowed path requests from SDL
+  const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                      4,
+                                      EGL_CONTEXT_MINOR_VERSION,
+                                      3,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+  EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT,
+                                           contextAttributes);
+  if (eglContext == EGL_NO_CONTEXT) {
+    Logger::offscreenContext->error("Failed to create EGL context: 0x{:x}",
+                                    eglGetError());
+    eglTerminate(eglDisplay);
+    return false;
+  }
+
+  if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                      eglContext)) {
+    Logger::offscreenContext->error(
+        "Failed to make surfaceless context current: 0x{:x}", eglGetError());
+    eglDestroyContext(eglDisplay, eglContext);
+    eglTerminate(eglDisplay);
+    return false;
+  }
+
+  display = eglDisplay;
+  context = eglContext;
+
+  Logger::offscreenContext->info(
+      "Successfully created EGL surfaceless context.");
+  return true;
+#else
+  Logger::offscreenContext->error(
+      "Offscreen rendering unavailable: engine built without EGL.");
+  return false;
+#endif
+}
+
+bool OffscreenContext::createFramebuffer(int width, int height) {
+  Logger::offscreenContext->info("Creating {}x{} offscreen framebuffer...",
+                                 width, height);
+
+  this->width = width;
+  this->height = height;
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  glGenRenderbuffers(1, &colorRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, colorRenderbuffer);
+
+  glGenRenderbuffers(1, &depthRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depthRenderbuffer);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    Logger::offscreenContext->error("Offscreen framebuffer incomplete: 0x{:x}",
+                                    status);
+    return false;
+  }
+
+  Logger::offscreenContext->info(
+      "Successfully created offscreen framebuffer.");
+  return true;
+}
+
+void OffscreenContext::bindFramebuffer() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void OffscreenContext::present() const { glFinish(); }
+
+bool OffscreenContext::readPixels(std::vector<unsigned char> &rgba) const {
+  if (framebuffer == 0)
+    return false;
+
+  rgba.resize(static_cast<size_t>(width) * height * 4);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+  return true;
+}
+
+void OffscreenContext::free() {
+  if (framebuffer != 0) {
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = colorRenderbuffer = depthRenderbuffer = 0;
+  }
+
+#ifdef SHADER_ENGINE_HAS_EGL
+  if (display) {
+    Logger::offscreenContext->info("Destroying EGL context...");
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context)
+      eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = nullptr;
+    context = nullptr;
+    Logger::offscreenContext->info("Successfully destroyed EGL context.");
+  }
+#endif
+}
+
+int OffscreenContext::getWidth() const { return width; }
+
+int OffscreenContext::getHeight() const { return height; }
@@ -13,12 +13,16 @@
 #include "LinearMath/btTransform.h"
 #include "LinearMath/btVector3.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include "RigidBody.h"
+#include <cmath>
 #include <vector>
 
 Physics::Physics()
     : collisionConfig(nullptr), dispatcher(nullptr), broadphase(nullptr),
-      solver(nullptr), dynamicsWorld(nullptr) {}
+      solver(nullptr), dynamicsWorld(nullptr),
+      stepSettings{true, 60.0f, 5, false}, accumulator(0.0f),
+      interpolationAlpha(1.0f), lastTickCount(0) {}
 
 const btVector3 Physics::DEFAULT_GRAVITY(0.0f, -9.8f, 0.0f);
 
@@ -31,6 +35,9 @@ bool Physics::init(const btVector3 &gravity) {
   Logger::physics->info("Initializing Bullet Physics...");
 
   primitiveRigidBodies = std::vector<PrimitiveRigidBody>();
+  previousTransforms.clear();
+  accumulator = 0.0f;
+  interpolationAlpha = 1.0f;
 
   collisionConfig = new btDefaultCollisionConfiguration();
   dispatcher = new btCollisionDispatcher(collisionConfig);
@@ -62,6 +69,23 @@ void Physics::setGravity(const btVector3 &gravity) {
   dynamicsWorld->setGravity(gravity);
 }
 
+bool Physics::setStepSettings(const PhysicsStepSettings &settings) {
+  // stepSimulation() divides by the tick rate
+  if (!(settings.tickRate > 0.0f) || settings.maxTicksPerFrame < 1) {
+    Logger::physics->error("Invalid step settings: {} ticks per second, up "
+                           "to {} per frame.",
+                           settings.tickRate, settings.maxTicksPerFrame);
+    return false;
+  }
+
+  stepSettings = settings;
+  accumulator = 0.0f;
+  Logger::physics->info("Stepping at {} Hz, up to {} ticks per frame{}.",
+                        settings.tickRate, settings.maxTicksPerFrame,
+                        settings.deterministic ? ", deterministic" : "");
+  return true;
+}
+
 void Physics::addPrimitiveRigidBody(PrimitiveRigidBody &rigidBody) {
   createRigidBody(rigidBody);
 
@@ -90,6 +114,75 @@ void Physics::addConvexHullRigidBody(ConvexHullRigidBody &rigidBody,
   }
 }
 
+void Physics::stepSimulation(float deltaTime) {
+  PROFILE_FUNCTION();
+  if (!stepSettings.fixedStep) {
+    lastTickCount = dynamicsWorld->stepSimulation(deltaTime, 10);
+    interpolationAlpha = 1.0f;
+    return;
+  }
+
+  const float fixedDelta = 1.0f / stepSettings.tickRate;
+
+  if (stepSettings.deterministic) {
+    storePreviousTransforms();
+    dynamicsWorld->stepSimulation(fixedDelta, 0, fixedDelta);
+    lastTickCount = 1;
+    accumulator = 0.0f;
+    interpolationAlpha = 1.0f;
+    return;
+  }
+
+  accumulator += deltaTime;
+
+  int ticks = 0;
+  while (accumulator >= fixedDelta && ticks < stepSettings.maxTicksPerFrame) {
+    storePreviousTransforms();
+    // maxSubSteps = 0 makes Bullet advance exactly one step of fixedDelta
+    // without its own internal accumulator
+    dynamicsWorld->stepSimulation(fixedDelta, 0, fixedDelta);
+    accumulator -= fixedDelta;
+    ticks++;
+  }
+
+  if (accumulator >= fixedDelta) {
+    Logger::physics->debug(
+        "Catch-up budget of {} ticks exceeded, dropping {:.2f} ms.",
+        stepSettings.maxTicksPerFrame,
+        (accumulator - std::fmod(accumulator, fixedDelta)) * 1000.0f);
+    accumulator = std::fmod(accumulator, fixedDelta);
+  }
+
+  lastTickCount = ticks;
+  interpolationAlpha = accumulator / fixedDelta;
+}
+
+float Physics::getInterpolationAlpha() const { return interpolationAlpha; }
+
+int Physics::getLastTickCount() const { return lastTickCount; }
+
+glm::mat4
+Physics::getInterpolatedTransform(const btCollisionObject *object) const {
+  btTransform current = object->getWorldTransform();
+  btTransform interpolated = current;
+
+  auto previous = previousTransforms.find(object);
+  if (previous != previousTransforms.end() && interpolationAlpha < 1.0f) {
+    interpolated.setOrigin(previous->second.getOrigin().lerp(
+        current.getOrigin(), interpolationAlpha));
+    interpolated.setRotation(previous->second.getRotation().slerp(
+        current.getRotation(), interpolationAlpha));
+  }
+
+  btScalar matrix[16];
+  interpolated.getOpenGLMatrix(matrix);
+
+  glm::mat4 result;
+  for (int i = 0; i < 16; i++)
+    result[i / 4][i % 4] = static_cast<float>(matrix[i]);
+  return result;
+}
+
 btVector3 Physics::getGravity() const { return dynamicsWorld->getGravity(); }
 
 void Physics::free() {
@@ -99,9 +192,19 @@ void Physics::free() {
   delete broadphase;
   delete dispatcher;
   delete collisionConfig;
+  previousTransforms.clear();
   Logger::physics->info("Successfully destroyed physics resources.");
 }
 
+void Physics::storePreviousTransforms() {
+  const btCollisionObjectArray &objects =
+      dynamicsWorld->getCollisionObjectArray();
+
+  previousTransforms.clear();
+  for (int i = 0; i < objects.size(); i++)
+    previousTransforms[objects[i]] = objects[i]->getWorldTransform();
+}
+
 void Physics::createRigidBody(PrimitiveRigidBody &rigidBody) {
   Logger::physics->debug("Identifying rigid body's collision shape...");
   if (dynamic_cast<btBoxShape *>(rigidBody.collisionShape)) {
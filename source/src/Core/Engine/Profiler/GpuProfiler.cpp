@@ -0,0 +1,190 @@
+#include "GpuProfiler.h"
+#include "Logger.h"
+#include <algorithm>
+#include <glad/glad.h>
+
+GpuProfiler::GpuProfiler()
+    : available(false), frameOpen(false), frameIndex(0), skippedFrames(0),
+      passStack{}, passStackSize(0), overflowDepth(0),
+      latestFrame{0, 0.0, {}} {}
+
+GpuProfiler *GpuProfiler::getInstance() {
+  static GpuProfiler instance;
+  return &instance;
+}
+
+bool GpuProfiler::init() {
+  Logger::profiler->info("Initializing GPU profiler...");
+
+  GLint counterBits = 0;
+  glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+  if (counterBits == 0) {
+    Logger::profiler->warn(
+        "GL timestamp queries unsupported, GPU timings disabled.");
+    return false;
+  }
+
+  queries.resize(FRAME_LATENCY * MAX_PASSES * 2);
+  glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+
+  for (int s = 0; s < FRAME_LATENCY; s++) {
+    for (int p = 0; p < MAX_PASSES; p++) {
+      size_t base = (static_cast<size_t>(s) * MAX_PASSES + p) * 2;
+      slots[s].passes[p].beginQuery = queries[base];
+      slots[s].passes[p].endQuery = queries[base + 1];
+    }
+  }
+
+  available = true;
+  Logger::profiler->info(
+      "Successfully initialized GPU profiler ({}-bit timestamps).",
+      counterBits);
+  return true;
+}
+
+void GpuProfiler::free() {
+  if (queries.empty())
+    return;
+
+  Logger::profiler->info("Destroying GPU profiler queries...");
+  glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+  queries.clear();
+  available = false;
+  frameOpen = false;
+  for (FrameSlot &slot : slots)
+    slot.pending = false;
+  Logger::profiler->info("Successfully destroyed GPU profiler queries.");
+}
+
+bool GpuProfiler::isAvailable() const { return available; }
+
+void GpuProfiler::beginFrame() {
+  if (!available)
+    return;
+
+  FrameSlot &slot = slots[frameIndex % FRAME_LATENCY];
+  if (slot.pending)
+    collect(slot);
+
+  slot.passCount = 0;
+  slot.frameIndex = frameIndex;
+
+  // Does not wait for the GPU, only for previous commands to be submitted
+  GLint64 gpuNow = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+  slot.clockOffsetNs = static_cast<int64_t>(Profiler::now()) - gpuNow;
+
+  passStackSize = 0;
+  overflowDepth = 0;
+  frameOpen = true;
+}
+
+void GpuProfiler::endFrame() {
+  if (!frameOpen)
+    return;
+
+  while (passStackSize > 0)
+    endPass();
+
+  FrameSlot &slot = slots[frameIndex % FRAME_LATENCY];
+  slot.pending = slot.passCount > 0;
+  frameIndex++;
+  frameOpen = false;
+}
+
+void GpuProfiler::beginPass(const char *name) {
+  if (!frameOpen)
+    return;
+
+  FrameSlot &slot = slots[frameIndex % FRAME_LATENCY];
+  if (overflowDepth > 0 || slot.passCount == MAX_PASSES ||
+      passStackSize == MAX_PASSES) {
+    overflowDepth++;
+    return;
+  }
+
+  Pass &pass = slot.passes[slot.passCount];
+  pass.name = name;
+  pass.depth = static_cast<uint32_t>(passStackSize);
+  glQueryCounter(pass.beginQuery, GL_TIMESTAMP);
+  slot.lastQuery = pass.beginQuery;
+
+  passStack[passStackSize++] = slot.passCount++;
+}
+
+void GpuProfiler::endPass() {
+  if (!frameOpen)
+    return;
+
+  if (overflowDepth > 0) {
+    overflowDepth--;
+    return;
+  }
+  if (passStackSize == 0)
+    return;
+
+  FrameSlot &slot = slots[frameIndex % FRAME_LATENCY];
+  Pass &pass = slot.passes[passStack[--passStackSize]];
+  glQueryCounter(pass.endQuery, GL_TIMESTAMP);
+  slot.lastQuery = pass.endQuery;
+}
+
+GpuFrameTiming GpuProfiler::getLatestFrame() const {
+  std::lock_guard<std::mutex> lock(latestMutex);
+  return latestFrame;
+}
+
+uint64_t GpuProfiler::getSkippedFrameCount() const {
+  return skippedFrames.load();
+}
+
+void GpuProfiler::collect(FrameSlot &slot) {
+  slot.pending = false;
+
+  // Never wait: if the GPU is more than FRAME_LATENCY frames behind, the
+  // frame is dropped instead
+  GLint resultAvailable = 0;
+  glGetQueryObjectiv(slot.lastQuery, GL_QUERY_RESULT_AVAILABLE,
+                     &resultAvailable);
+  if (!resultAvailable) {
+    skippedFrames++;
+    return;
+  }
+
+  GpuFrameTiming frame;
+  frame.frameIndex = slot.frameIndex;
+  frame.passes.reserve(slot.passCount);
+
+  GLuint64 frameBegin = UINT64_MAX;
+  GLuint64 frameEnd = 0;
+  std::array<GLuint64, MAX_PASSES * 2> timestamps;
+  for (int i = 0; i < slot.passCount; i++) {
+    glGetQueryObjectui64v(slot.passes[i].beginQuery, GL_QUERY_RESULT,
+                          &timestamps[i * 2]);
+    glGetQueryObjectui64v(slot.passes[i].endQuery, GL_QUERY_RESULT,
+                          &timestamps[i * 2 + 1]);
+    frameBegin = std::min(frameBegin, timestamps[i * 2]);
+    frameEnd = std::max(frameEnd, timestamps[i * 2 + 1]);
+  }
+
+  Profiler *profiler = Profiler::getInstance();
+  for (int i = 0; i < slot.passCount; i++) {
+    const Pass &pass = slot.passes[i];
+    GLuint64 begin = timestamps[i * 2];
+    GLuint64 end = std::max(timestamps[i * 2 + 1], begin);
+
+    frame.passes.push_back(GpuPassTiming{pass.name,
+                                         (begin - frameBegin) / 1.0e6,
+                                         (end - begin) / 1.0e6, pass.depth});
+
+    // Mirror into the CPU timeline, converted to the CPU clock
+    profiler->addGpuZone(ProfileZone{
+        pass.name, static_cast<uint64_t>(begin + slot.clockOffsetNs),
+        static_cast<uint64_t>(end + slot.clockOffsetNs),
+        Profiler::GPU_THREAD_INDEX, pass.depth});
+  }
+  frame.totalMs = (frameEnd - frameBegin) / 1.0e6;
+
+  std::lock_guard<std::mutex> lock(latestMutex);
+  latestFrame = std::move(frame);
+}
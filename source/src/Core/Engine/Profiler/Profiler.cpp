@@ -0,0 +1,282 @@
+#include "Profiler.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+static void addZoneStats(std::map<std::pair<const char *, bool>,
+                                  ProfileZoneStats> &statsByName,
+                         const ProfileZone &zone);
+static std::vector<ProfileZoneStats>
+sortZoneStats(const std::map<std::pair<const char *, bool>, ProfileZoneStats>
+                  &statsByName);
+
+Profiler::Profiler()
+    : threadCount(0), droppedZones(0), frames(FRAME_HISTORY), frameIndex(0),
+      frameStart(now()), frameCount(0), paused(false),
+      collectingTotals(false), totalsFirstFrame(0) {}
+
+Profiler *Profiler::getInstance() {
+  static Profiler instance;
+  return &instance;
+}
+
+uint64_t Profiler::now() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void Profiler::beginZone(const char *name) {
+  ThreadBuffer *buffer = getThreadBuffer();
+  if (!buffer)
+    return;
+
+  if (buffer->skippedDepth > 0) {
+    buffer->skippedDepth++;
+    droppedZones.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // Keep room for the end event of every open zone, this one included
+  size_t used = buffer->head.load(std::memory_order_relaxed) -
+                buffer->tail.load(std::memory_order_acquire);
+  if (used + buffer->recordedDepth + 2 > EVENT_BUFFER_SIZE) {
+    buffer->skippedDepth = 1;
+    droppedZones.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  buffer->recordedDepth++;
+  push(*buffer, EventType::Begin, name);
+}
+
+void Profiler::endZone() {
+  ThreadBuffer *buffer = getThreadBuffer();
+  if (!buffer)
+    return;
+
+  if (buffer->skippedDepth > 0) {
+    buffer->skippedDepth--;
+    return;
+  }
+  if (buffer->recordedDepth == 0)
+    return;
+
+  buffer->recordedDepth--;
+  push(*buffer, EventType::End, nullptr);
+}
+
+void Profiler::setThreadName(const char *name) {
+  ThreadBuffer *buffer = getThreadBuffer();
+  if (buffer)
+    buffer->name = name;
+}
+
+void Profiler::markFrame() {
+  uint64_t end = now();
+
+  ProfileFrame *frame = nullptr;
+  if (!paused) {
+    frame = &frames[frameIndex % FRAME_HISTORY];
+    frame->index = frameIndex;
+    frame->startNs = frameStart;
+    frame->endNs = end;
+    frame->zones.clear();
+  }
+
+  // Buffers are drained even while paused so producers never fill up
+  int count = threadCount.load(std::memory_order_acquire);
+  for (int i = 0; i < count; i++)
+    drain(*buffers[i], frame);
+
+  if (frame) {
+    // Only CPU zones so far, GPU zones are counted as they are filed
+    if (collectingTotals && frame->index >= totalsFirstFrame) {
+      for (const ProfileZone &zone : frame->zones)
+        addZoneStats(totals, zone);
+    }
+    frameIndex++;
+    frameCount = std::min(frameCount + 1, FRAME_HISTORY);
+  }
+  frameStart = end;
+
+  fileGpuZones();
+}
+
+void Profiler::addGpuZone(const ProfileZone &zone) {
+  std::lock_guard<std::mutex> lock(gpuZoneMutex);
+  pendingGpuZones.push_back(zone);
+}
+
+void Profiler::setPaused(bool paused) { this->paused = paused; }
+
+bool Profiler::isPaused() const { return paused; }
+
+const ProfileFrame *Profiler::getFrame(int framesAgo) const {
+  if (framesAgo < 0 || framesAgo >= frameCount)
+    return nullptr;
+  return &frames[(frameIndex - 1 - framesAgo) % FRAME_HISTORY];
+}
+
+int Profiler::getFrameCount() const { return frameCount; }
+
+int Profiler::getThreadCount() const {
+  return threadCount.load(std::memory_order_acquire);
+}
+
+const char *Profiler::getThreadName(uint32_t threadIndex) const {
+  if (threadIndex == GPU_THREAD_INDEX)
+    return "GPU";
+  if (static_cast<int>(threadIndex) >= getThreadCount())
+    return nullptr;
+  return buffers[threadIndex]->name;
+}
+
+uint64_t Profiler::getDroppedZoneCount() const {
+  return droppedZones.load(std::memory_order_relaxed);
+}
+
+std::vector<ProfileZoneStats> Profiler::computeStats(int frameCount) const {
+  std::map<ZoneKey, ProfileZoneStats> statsByName;
+
+  for (int i = 0; i < frameCount; i++) {
+    const ProfileFrame *frame = getFrame(i);
+    if (!frame)
+      break;
+
+    for (const ProfileZone &zone : frame->zones)
+      addZoneStats(statsByName, zone);
+  }
+  return sortZoneStats(statsByName);
+}
+
+void Profiler::resetTotals() {
+  totals.clear();
+  totalsFirstFrame = frameIndex;
+  collectingTotals = true;
+}
+
+std::vector<ProfileZoneStats> Profiler::getTotals() const {
+  return sortZoneStats(totals);
+}
+
+Profiler::ThreadBuffer *Profiler::getThreadBuffer() {
+  thread_local ThreadBuffer *localBuffer = nullptr;
+  thread_local bool registrationFailed = false;
+
+  if (localBuffer || registrationFailed)
+    return localBuffer;
+
+  std::lock_guard<std::mutex> lock(registerMutex);
+  int index = threadCount.load(std::memory_order_relaxed);
+  if (index >= MAX_THREADS) {
+    Logger::profiler->warn("More than {} threads, ignoring zones from the "
+                           "new thread.",
+                           MAX_THREADS);
+    registrationFailed = true;
+    return nullptr;
+  }
+
+  // Buffers live as long as the profiler, so events of exited threads can
+  // still be drained
+  buffers[index] = std::make_unique<ThreadBuffer>();
+  buffers[index]->threadIndex = static_cast<uint32_t>(index);
+  threadCount.store(index + 1, std::memory_order_release);
+
+  localBuffer = buffers[index].get();
+  return localBuffer;
+}
+
+void Profiler::push(ThreadBuffer &buffer, EventType type, const char *name) {
+  size_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head % EVENT_BUFFER_SIZE] = Event{name, now(), type};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::fileGpuZones() {
+  {
+    std::lock_guard<std::mutex> lock(gpuZoneMutex);
+    gpuZoneScratch.swap(pendingGpuZones);
+  }
+  if (paused) {
+    gpuZoneScratch.clear();
+    return;
+  }
+
+  for (const ProfileZone &zone : gpuZoneScratch) {
+    for (int i = 0; i < frameCount; i++) {
+      ProfileFrame &frame = frames[(frameIndex - 1 - i) % FRAME_HISTORY];
+      // Clock conversion can land a zone just past the newest frame
+      if (zone.startNs >= frame.startNs &&
+          (zone.startNs < frame.endNs || i == 0)) {
+        frame.zones.push_back(zone);
+        if (collectingTotals && frame.index >= totalsFirstFrame)
+          addZoneStats(totals, zone);
+        break;
+      }
+    }
+  }
+  gpuZoneScratch.clear();
+}
+
+void Profiler::drain(ThreadBuffer &buffer, ProfileFrame *frame) {
+  size_t tail = buffer.tail.load(std::memory_order_relaxed);
+  size_t head = buffer.head.load(std::memory_order_acquire);
+
+  for (; tail != head; tail++) {
+    const Event &event = buffer.events[tail % EVENT_BUFFER_SIZE];
+
+    if (event.type == EventType::Begin) {
+      buffer.openZones.push_back(OpenZone{event.name, event.timestamp});
+      continue;
+    }
+    if (buffer.openZones.empty())
+      continue;
+
+    // Zones belong to the frame they end in
+    OpenZone zone = buffer.openZones.back();
+    buffer.openZones.pop_back();
+    if (frame)
+      frame->zones.push_back(
+          ProfileZone{zone.name, zone.startNs, event.timestamp,
+                      buffer.threadIndex,
+                      static_cast<uint32_t>(buffer.openZones.size())});
+  }
+
+  buffer.tail.store(tail, std::memory_order_release);
+}
+
+static void addZoneStats(std::map<std::pair<const char *, bool>,
+                                  ProfileZoneStats> &statsByName,
+                         const ProfileZone &zone) {
+  double durationMs = (zone.endNs - zone.startNs) / 1.0e6;
+  bool gpu = zone.threadIndex == Profiler::GPU_THREAD_INDEX;
+
+  auto inserted = statsByName.try_emplace(
+      std::make_pair(zone.name, gpu),
+      ProfileZoneStats{zone.name, 0, 0.0, 0.0, durationMs, durationMs, gpu});
+  ProfileZoneStats &stats = inserted.first->second;
+  stats.calls++;
+  stats.totalMs += durationMs;
+  stats.minMs = std::min(stats.minMs, durationMs);
+  stats.maxMs = std::max(stats.maxMs, durationMs);
+}
+
+static std::vector<ProfileZoneStats>
+sortZoneStats(const std::map<std::pair<const char *, bool>, ProfileZoneStats>
+                  &statsByName) {
+  std::vector<ProfileZoneStats> result;
+  result.reserve(statsByName.size());
+  for (const auto &entry : statsByName) {
+    result.push_back(entry.second);
+    result.back().averageMs = entry.second.totalMs / entry.second.calls;
+  }
+
+  std::sort(result.begin(), result.end(),
+            [](const ProfileZoneStats &a, const ProfileZoneStats &b) {
+              return a.totalMs > b.totalMs;
+            });
+  return result;
+}
@@ -0,0 +1,244 @@
+#include "RenderThread.h"
+#include "GpuProfiler.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "backends/imgui_impl_opengl3.h"
+#include <chrono>
+#include <cstring>
+#include <glad/glad.h>
+
+RenderSnapshot::RenderSnapshot()
+    : frameIndex(0), viewportWidth(0), viewportHeight(0),
+      clearColor{0.0f, 0.0f, 0.0f, 1.0f}, hasScene(false) {}
+
+RenderSnapshot::~RenderSnapshot() { releaseDrawLists(); }
+
+void RenderSnapshot::captureDrawData(const ImDrawData *source) {
+  drawData.Clear();
+  if (!source || !source->Valid)
+    return;
+
+  // Keep the cloned lists alive between frames so their buffers keep their
+  // capacity; ImVector::resize never shrinks
+  while (drawLists.size() < static_cast<size_t>(source->CmdListsCount))
+    drawLists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+  for (int i = 0; i < source->CmdListsCount; i++) {
+    const ImDrawList *sourceList = source->CmdLists[i];
+    ImDrawList *copy = drawLists[i];
+
+    copy->CmdBuffer.resize(sourceList->CmdBuffer.Size);
+    std::memcpy(copy->CmdBuffer.Data, sourceList->CmdBuffer.Data,
+                sourceList->CmdBuffer.size_in_bytes());
+    copy->IdxBuffer.resize(sourceList->IdxBuffer.Size);
+    std::memcpy(copy->IdxBuffer.Data, sourceList->IdxBuffer.Data,
+                sourceList->IdxBuffer.size_in_bytes());
+    copy->VtxBuffer.resize(sourceList->VtxBuffer.Size);
+    std::memcpy(copy->VtxBuffer.Data, sourceList->VtxBuffer.Data,
+                sourceList->VtxBuffer.size_in_bytes());
+    copy->Flags = sourceList->Flags;
+
+    drawData.CmdLists.push_back(copy);
+  }
+
+  drawData.Valid = true;
+  drawData.CmdListsCount = source->CmdListsCount;
+  drawData.TotalIdxCount = source->TotalIdxCount;
+  drawData.TotalVtxCount = source->TotalVtxCount;
+  drawData.DisplayPos = source->DisplayPos;
+  drawData.DisplaySize = source->DisplaySize;
+  drawData.FramebufferScale = source->FramebufferScale;
+  drawData.OwnerViewport = source->OwnerViewport;
+  drawData.Textures = source->Textures;
+}
+
+void RenderSnapshot::releaseDrawLists() {
+  drawData.Clear();
+  for (ImDrawList *drawList : drawLists)
+    IM_DELETE(drawList);
+  drawLists.clear();
+}
+
+RenderThread::RenderThread()
+    : window(nullptr), glContext(nullptr), snapshotBusy{false, false},
+      writeIndex(0), pendingIndex(-1), texturesSynced(true), running(false),
+      publishedFrames(0), lastSubmitMs(0.0) {}
+
+RenderThread::~RenderThread() { stop(); }
+
+void RenderThread::setSceneRenderer(
+    std::function<void(const SceneView &)> renderer) {
+  sceneRenderer = std::move(renderer);
+}
+
+void RenderThread::setUploader(std::function<void()> uploader) {
+  this->uploader = std::move(uploader);
+}
+
+bool RenderThread::start(SDL_Window *window, SDL_GLContext glContext) {
+  Logger::renderThread->info("Starting render thread...");
+
+  if (running) {
+    Logger::renderThread->warn("start(): Render thread already running.");
+    return true;
+  }
+
+  if (!window || !glContext) {
+    Logger::renderThread->error("start(): No window or GL context given.");
+    return false;
+  }
+
+  this->window = window;
+  this->glContext = glContext;
+  writeIndex = 0;
+  pendingIndex = -1;
+  texturesSynced = true;
+  snapshotBusy[0] = snapshotBusy[1] = false;
+  publishedFrames = 0;
+  running = true;
+
+  thread = std::thread(&RenderThread::threadLoop, this);
+
+  Logger::renderThread->info("Successfully started render thread.");
+  return true;
+}
+
+void RenderThread::stop() {
+  if (!thread.joinable())
+    return;
+
+  Logger::renderThread->info("Stopping render thread...");
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  condition.notify_all();
+  thread.join();
+
+  // Draw lists reference the ImGui context, free them while it still exists
+  snapshots[0].releaseDrawLists();
+  snapshots[1].releaseDrawLists();
+  Logger::renderThread->info("Successfully stopped render thread.");
+}
+
+bool RenderThread::isRunning() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return running;
+}
+
+RenderSnapshot &RenderThread::acquireSnapshot() {
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock,
+                 [this] { return !snapshotBusy[writeIndex] || !running; });
+  return snapshots[writeIndex];
+}
+
+void RenderThread::publishSnapshot() {
+  std::unique_lock<std::mutex> lock(mutex);
+  // At most one frame may be queued ahead of the one being submitted
+  condition.wait(lock, [this] { return pendingIndex == -1 || !running; });
+
+  snapshots[writeIndex].frameIndex = publishedFrames++;
+  snapshotBusy[writeIndex] = true;
+  pendingIndex = writeIndex;
+  texturesSynced = false;
+  writeIndex ^= 1;
+
+  lock.unlock();
+  condition.notify_all();
+}
+
+void RenderThread::waitForTextureSync() {
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, [this] { return texturesSynced || !running; });
+}
+
+double RenderThread::getLastSubmitMs() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return lastSubmitMs;
+}
+
+void RenderThread::threadLoop() {
+  PROFILE_THREAD_NAME("Render");
+
+  if (SDL_GL_MakeCurrent(window, glContext) != 0) {
+    Logger::renderThread->error("Failed to make GL context current: {}",
+                                SDL_GetError());
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    condition.notify_all();
+    return;
+  }
+
+  while (true) {
+    int index;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return pendingIndex != -1 || !running; });
+      if (!running)
+        break;
+
+      index = pendingIndex;
+      pendingIndex = -1;
+    }
+    condition.notify_all();
+
+    RenderSnapshot &snapshot = snapshots[index];
+    auto start = std::chrono::steady_clock::now();
+
+    // Texture updates read the main thread's ImGui atlas, finish them before
+    // letting the main thread start a new ImGui frame
+    if (snapshot.drawData.Textures != nullptr) {
+      for (ImTextureData *texture : *snapshot.drawData.Textures)
+        if (texture->Status != ImTextureStatus_OK)
+          ImGui_ImplOpenGL3_UpdateTexture(texture);
+      snapshot.drawData.Textures = nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      texturesSynced = true;
+    }
+    condition.notify_all();
+
+    submit(snapshot);
+
+    double submitMs = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      snapshotBusy[index] = false;
+      lastSubmitMs = submitMs;
+    }
+    condition.notify_all();
+  }
+
+  SDL_GL_MakeCurrent(window, nullptr);
+}
+
+void RenderThread::submit(RenderSnapshot &snapshot) {
+  PROFILE_FUNCTION();
+
+  if (uploader)
+    uploader();
+
+  GPU_PROFILE_FRAME_BEGIN();
+  {
+    GPU_PROFILE_SCOPE("Scene");
+    glViewport(0, 0, snapshot.viewportWidth, snapshot.viewportHeight);
+    glClearColor(snapshot.clearColor[0], snapshot.clearColor[1],
+                 snapshot.clearColor[2], snapshot.clearColor[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    if (snapshot.hasScene && sceneRenderer)
+      sceneRenderer(snapshot.sceneView);
+  }
+
+  if (snapshot.drawData.Valid) {
+    GPU_PROFILE_SCOPE("ImGui");
+    ImGui_ImplOpenGL3_RenderDrawData(&snapshot.drawData);
+  }
+  GPU_PROFILE_FRAME_END();
+
+  SDL_GL_SwapWindow(window);
+}
@@ -0,0 +1,547 @@
+#include "Scene.h"
+#include "Logger.h"
+#include "Physics.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <sstream>
+
+static bool isBeforeKeyframe(float time, const CameraKeyframe &keyframe) {
+  return time < keyframe.time;
+}
+
+void CameraPath::addKeyframe(const CameraKeyframe &keyframe) {
+  auto position = std::upper_bound(keyframes.begin(), keyframes.end(),
+                                   keyframe.time, isBeforeKeyframe);
+  keyframes.insert(position, keyframe);
+}
+
+bool CameraPath::isEmpty() const { return keyframes.empty(); }
+
+float CameraPath::getDuration() const {
+  return keyframes.empty() ? 0.0f : keyframes.back().time;
+}
+
+void CameraPath::apply(float time, Camera &camera) const {
+  if (keyframes.empty())
+    return;
+
+  float duration = getDuration();
+  if (loop && duration > 0.0f)
+    time = std::fmod(time, duration);
+
+  if (time <= keyframes.front().time) {
+    const CameraKeyframe &first = keyframes.front();
+    camera.setPose(first.position, first.yaw, first.pitch);
+    return;
+  }
+  if (time >= keyframes.back().time) {
+    const CameraKeyframe &last = keyframes.back();
+    camera.setPose(last.position, last.yaw, last.pitch);
+    return;
+  }
+
+  auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                               isBeforeKeyframe);
+  const CameraKeyframe &to = *next;
+  const CameraKeyframe &from = *(next - 1);
+
+  float t = (time - from.time) / (to.time - from.time);
+  camera.setPose(glm::mix(from.position, to.position, t),
+                 glm::mix(from.yaw, to.yaw, t),
+                 glm::mix(from.pitch, to.pitch, t));
+}
+
+Scene::Scene()
+    : loaded(false), vertexLayout(VertexLayout::Float),
+      importProfile(ImportProfile::RuntimeOptimized),
+      residency(GeometryResidency::GpuOnly), mergedDraws(false),
+      clusterCulling(true),
+      backfaceCulling(false), lodPixelError(1.0f), streamer(nullptr) {}
+
+bool Scene::loadFromFile(const std::string &path) {
+  Logger::scene->info("Loading scene: {}", path);
+
+  std::ifstream stream(path);
+  if (!stream) {
+    Logger::scene->error("Failed to open scene file: {}", path);
+    return false;
+  }
+
+  free();
+  this->path = path;
+  size_t separator = path.find_last_of("/\\");
+  directory = separator == std::string::npos ? "." : path.substr(0, separator);
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(stream, line)) {
+    lineNumber++;
+    if (!parseLine(line, lineNumber))
+      return false;
+  }
+
+  if (!cameraPath.isEmpty())
+    cameraPath.apply(0.0f, camera);
+
+  loaded = true;
+  Logger::scene->info(
+      "Successfully loaded scene: {} models, {} lights, {} bodies, {:.2f} s "
+      "camera path.",
+      models.size(), lights.size(), bodies.size(), cameraPath.getDuration());
+  return true;
+}
+
+void Scene::setVertexLayout(VertexLayout layout) { vertexLayout = layout; }
+
+void Scene::setImportProfile(ImportProfile profile) {
+  importProfile = profile;
+}
+
+void Scene::setGeometryResidency(GeometryResidency residency) {
+  this->residency = residency;
+}
+
+void Scene::setMergedDraws(bool merged) { mergedDraws = merged; }
+
+void Scene::setCulling(bool clusters, bool backfaces) {
+  clusterCulling = clusters;
+  backfaceCulling = backfaces;
+}
+
+void Scene::setLodPixelError(float pixels) { lodPixelError = pixels; }
+
+void Scene::streamModels(AssetStreamer &streamer) {
+  PROFILE_FUNCTION();
+
+  this->streamer = &streamer;
+  for (ModelEntry &entry : models) {
+    std::string modelPath = entry.path;
+    if (!modelPath.empty() && modelPath[0] != '/' &&
+        modelPath.find(':') == std::string::npos)
+      modelPath = directory + '/' + modelPath;
+
+    ModelLoadSettings settings;
+    settings.vertexLayout = vertexLayout;
+    settings.importProfile = importProfile;
+    settings.residency = entry.residency;
+    settings.mergeMeshes = mergedDraws;
+    entry.handle = streamer.loadModel(modelPath, settings);
+  }
+}
+
+void Scene::createRigidBodies() {
+  Physics *physics = Physics::getInstance();
+
+  for (SceneBody &body : bodies) {
+    PrimitiveRigidBody rigidBody{};
+    rigidBody.mass = body.mass;
+    rigidBody.inertia = btVector3(0.0f, 0.0f, 0.0f);
+    rigidBody.initialPosition =
+        btVector3(body.position.x, body.position.y, body.position.z);
+    rigidBody.initialRotation = btQuaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    rigidBody.dimension =
+        btVector3(body.dimension.x, body.dimension.y, body.dimension.z);
+    rigidBody.radius = body.radius;
+    rigidBody.height = body.height;
+    rigidBody.normal = btVector3(body.normal.x, body.normal.y, body.normal.z);
+
+    // Physics picks the final shape from the type of this placeholder
+    switch (body.shape) {
+    case SceneBodyShape::Box:
+      rigidBody.collisionShape = new btBoxShape(rigidBody.dimension);
+      break;
+    case SceneBodyShape::Sphere:
+      rigidBody.collisionShape = new btSphereShape(body.radius);
+      break;
+    case SceneBodyShape::Capsule:
+      rigidBody.collisionShape = new btCapsuleShape(body.radius, body.height);
+      break;
+    case SceneBodyShape::Cylinder:
+      rigidBody.collisionShape = new btCylinderShape(rigidBody.dimension);
+      break;
+    case SceneBodyShape::Cone:
+      rigidBody.collisionShape = new btConeShape(body.radius, body.height);
+      break;
+    case SceneBodyShape::Plane:
+      rigidBody.collisionShape =
+          new btStaticPlaneShape(rigidBody.normal, body.height);
+      break;
+    }
+    btCollisionShape *placeholder = rigidBody.collisionShape;
+
+    physics->addPrimitiveRigidBody(rigidBody);
+    delete placeholder;
+    if (!rigidBody.initialized)
+      continue;
+
+    physics->dynamicsWorld->addRigidBody(rigidBody.rigidBody);
+    body.rigidBody = rigidBody.rigidBody;
+  }
+}
+
+void Scene::free() {
+  Physics *physics = Physics::getInstance();
+  for (SceneBody &body : bodies) {
+    if (body.rigidBody && physics->dynamicsWorld)
+      physics->dynamicsWorld->removeRigidBody(body.rigidBody);
+  }
+
+  models.clear();
+  streamer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(drawStatsMutex);
+    drawStats = DrawStats();
+  }
+  lights.clear();
+  bodies.clear();
+  cameraPath = CameraPath();
+  camera = Camera();
+  path.clear();
+  directory.clear();
+  loaded = false;
+}
+
+bool Scene::isLoaded() const { return loaded; }
+
+const std::string &Scene::getPath() const { return path; }
+
+void Scene::update() {
+  Physics *physics = Physics::getInstance();
+
+  for (const SceneBody &body : bodies) {
+    if (!body.rigidBody || body.model < 0)
+      continue;
+
+    ModelEntry &entry = models[body.model];
+    entry.transform = physics->getInterpolatedTransform(body.rigidBody) *
+                      glm::scale(glm::mat4(1.0f), entry.scale);
+  }
+}
+
+void Scene::captureView(const Camera &camera, float aspectRatio,
+                        int viewportHeight, SceneView &view) const {
+  view.view = camera.getViewMatrix();
+  view.projection = glm::perspective(glm::radians(camera.getFOV()),
+                                     aspectRatio, 0.1f, 1000.0f);
+  view.viewPosition = camera.position;
+  view.pixelScale = viewportHeight * 0.5f * view.projection[1][1];
+
+  view.modelTransforms.resize(models.size());
+  for (size_t i = 0; i < models.size(); i++)
+    view.modelTransforms[i] = models[i].transform;
+}
+
+void Scene::draw(Shader &shader, const SceneView &view) {
+  if (!streamer)
+    return;
+
+  PROFILE_FUNCTION();
+
+  shader.bind();
+  shader.setMat4("u_View", view.view);
+  shader.setMat4("u_Projection", view.projection);
+  shader.setVec3("u_ViewPos", view.viewPosition);
+  applyLights(shader);
+
+  CullView cullView = CullView::fromViewProjection(
+      view.projection * view.view, view.viewPosition, backfaceCulling);
+  const CullView *meshCullView = clusterCulling ? &cullView : nullptr;
+  LodView lodView{view.viewPosition, view.pixelScale, lodPixelError};
+  const LodView *meshLodView = lodPixelError > 0.0f ? &lodView : nullptr;
+
+  glEnable(GL_DEPTH_TEST);
+  if (backfaceCulling)
+    glEnable(GL_CULL_FACE);
+  DrawStats stats;
+  for (size_t i = 0; i < models.size() && i < view.modelTransforms.size();
+       i++) {
+    Model &model = streamer->getModel(models[i].handle);
+    model.Draw(shader, view.modelTransforms[i], meshCullView, meshLodView);
+    stats += model.getDrawStats();
+  }
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_DEPTH_TEST);
+
+  shader.unbind();
+
+  std::lock_guard<std::mutex> lock(drawStatsMutex);
+  drawStats = stats;
+}
+
+Camera &Scene::getCamera() { return camera; }
+
+const CameraPath &Scene::getCameraPath() const { return cameraPath; }
+
+size_t Scene::getModelCount() const { return models.size(); }
+
+size_t Scene::getLightCount() const { return lights.size(); }
+
+size_t Scene::getBodyCount() const { return bodies.size(); }
+
+GeometryMemory Scene::getGeometryMemory() const {
+  GeometryMemory memory;
+  if (!streamer)
+    return memory;
+
+  for (size_t i = 0; i < models.size(); i++) {
+    ModelHandle handle = models[i].handle;
+    auto shared = [handle](const ModelEntry &entry) {
+      return entry.handle.id == handle.id;
+    };
+    // Shared models count once, placeholders not at all
+    if (std::any_of(models.begin(), models.begin() + i, shared) ||
+        streamer->getState(handle) != AssetState::Ready)
+      continue;
+    memory += streamer->getModel(handle).getGeometryMemory();
+  }
+  return memory;
+}
+
+DrawStats Scene::getDrawStats() const {
+  std::lock_guard<std::mutex> lock(drawStatsMutex);
+  return drawStats;
+}
+
+static bool readVec3(std::istringstream &stream, glm::vec3 &value) {
+  return static_cast<bool>(stream >> value.x >> value.y >> value.z);
+}
+
+bool Scene::parseLine(const std::string &line, int lineNumber) {
+  std::istringstream stream(line);
+  std::string keyword;
+  if (!(stream >> keyword) || keyword[0] == '#')
+    return true;
+
+  auto fail = [&](const std::string &reason) {
+    Logger::scene->error("{}:{}: {}", path, lineNumber, reason);
+    return false;
+  };
+
+  if (keyword == "model") {
+    ModelEntry entry;
+    entry.transform = glm::mat4(1.0f);
+    entry.scale = glm::vec3(1.0f);
+    entry.residency = residency;
+    if (!(stream >> entry.path))
+      return fail("model needs a path");
+
+    glm::vec3 position(0.0f);
+    glm::vec3 axis(0.0f, 1.0f, 0.0f);
+    float angle = 0.0f;
+    float scale = 1.0f;
+    std::string property;
+    std::string name;
+    while (stream >> property) {
+      bool ok = true;
+      if (property == "position")
+        ok = readVec3(stream, position);
+      else if (property == "rotation")
+        ok = static_cast<bool>(stream >> angle) && readVec3(stream, axis);
+      else if (property == "scale")
+        ok = static_cast<bool>(stream >> scale);
+      else if (property == "residency")
+        ok = static_cast<bool>(stream >> name) &&
+             Model::parseResidency(name.c_str(), entry.residency);
+      else
+        return fail("unknown model property '" + property + "'");
+      if (!ok)
+        return fail("bad value for model " + property);
+    }
+    entry.scale = glm::vec3(scale);
+    entry.transform = glm::translate(glm::mat4(1.0f), position);
+    entry.transform =
+        glm::rotate(entry.transform, glm::radians(angle), axis);
+    entry.transform = glm::scale(entry.transform, entry.scale);
+    models.push_back(std::move(entry));
+    return true;
+  }
+
+  if (keyword == "light") {
+    SceneLight light{};
+    light.ambient = glm::vec3(0.1f);
+    light.diffuse = glm::vec3(0.8f);
+    light.specular = glm::vec3(1.0f);
+    light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    light.constant = 1.0f;
+    light.linear = 0.09f;
+    light.quadratic = 0.032f;
+    light.innerCutoffDegrees = 12.5f;
+    light.outerCutoffDegrees = 17.5f;
+
+    std::string type;
+    stream >> type;
+    if (type == "directional")
+      light.type = SceneLightType::Directional;
+    else if (type == "point")
+      light.type = SceneLightType::Point;
+    else if (type == "spot")
+      light.type = SceneLightType::Spot;
+    else
+      return fail("unknown light type '" + type + "'");
+
+    std::string property;
+    while (stream >> property) {
+      bool ok = true;
+      if (property == "position")
+        ok = readVec3(stream, light.position);
+      else if (property == "direction")
+        ok = readVec3(stream, light.direction);
+      else if (property == "ambient")
+        ok = readVec3(stream, light.ambient);
+      else if (property == "diffuse")
+        ok = readVec3(stream, light.diffuse);
+      else if (property == "specular")
+        ok = readVec3(stream, light.specular);
+      else if (property == "attenuation")
+        ok = static_cast<bool>(stream >> light.constant >> light.linear >>
+                               light.quadratic);
+      else if (property == "cutoff")
+        ok = static_cast<bool>(stream >> light.innerCutoffDegrees >>
+                               light.outerCutoffDegrees);
+      else
+        return fail("unknown light property '" + property + "'");
+      if (!ok)
+        return fail("bad value for light " + property);
+    }
+    lights.push_back(light);
+    return true;
+  }
+
+  if (keyword == "body") {
+    SceneBody body{};
+    body.dimension = glm::vec3(0.5f);
+    body.radius = 0.5f;
+    body.height = 1.0f;
+    body.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    body.mass = 1.0f;
+    body.model = -1;
+    body.rigidBody = nullptr;
+
+    std::string shape;
+    stream >> shape;
+    if (shape == "box")
+      body.shape = SceneBodyShape::Box;
+    else if (shape == "sphere")
+      body.shape = SceneBodyShape::Sphere;
+    else if (shape == "capsule")
+      body.shape = SceneBodyShape::Capsule;
+    else if (shape == "cylinder")
+      body.shape = SceneBodyShape::Cylinder;
+    else if (shape == "cone")
+      body.shape = SceneBodyShape::Cone;
+    else if (shape == "plane") {
+      body.shape = SceneBodyShape::Plane;
+      body.height = 0.0f;
+      body.mass = 0.0f;
+    } else
+      return fail("unknown body shape '" + shape + "'");
+
+    std::string property;
+    while (stream >> property) {
+      bool ok = true;
+      if (property == "dimension")
+        ok = readVec3(stream, body.dimension);
+      else if (property == "radius")
+        ok = static_cast<bool>(stream >> body.radius);
+      else if (property == "height")
+        ok = static_cast<bool>(stream >> body.height);
+      else if (property == "normal")
+        ok = readVec3(stream, body.normal);
+      else if (property == "mass")
+        ok = static_cast<bool>(stream >> body.mass);
+      else if (property == "position")
+        ok = readVec3(stream, body.position);
+      else if (property == "model")
+        ok = static_cast<bool>(stream >> body.model) && body.model >= 0 &&
+             body.model < static_cast<int>(models.size());
+      else
+        return fail("unknown body property '" + property + "'");
+      if (!ok)
+        return fail("bad value for body " + property);
+    }
+    bodies.push_back(body);
+    return true;
+  }
+
+  if (keyword == "camera") {
+    CameraKeyframe keyframe{};
+    keyframe.yaw = -90.0f;
+    if (!(stream >> keyframe.time))
+      return fail("camera needs a keyframe time");
+
+    std::string property;
+    while (stream >> property) {
+      bool ok = true;
+      if (property == "position")
+        ok = readVec3(stream, keyframe.position);
+      else if (property == "yaw")
+        ok = static_cast<bool>(stream >> keyframe.yaw);
+      else if (property == "pitch")
+        ok = static_cast<bool>(stream >> keyframe.pitch);
+      else
+        return fail("unknown camera property '" + property + "'");
+      if (!ok)
+        return fail("bad value for camera " + property);
+    }
+    cameraPath.addKeyframe(keyframe);
+    return true;
+  }
+
+  if (keyword == "camera_loop") {
+    cameraPath.loop = true;
+    return true;
+  }
+
+  return fail("unknown keyword '" + keyword + "'");
+}
+
+void Scene::applyLights(Shader &shader) const {
+  // main.glsl has one uniform of each light type, the first of each wins
+  bool directionalSet = false, pointSet = false, spotSet = false;
+
+  for (const SceneLight &light : lights) {
+    switch (light.type) {
+    case SceneLightType::Directional:
+      if (directionalSet)
+        break;
+      directionalSet = true;
+      shader.setVec3("dirLight.direction", light.direction);
+      shader.setVec3("dirLight.ambient", light.ambient);
+      shader.setVec3("dirLight.diffuse", light.diffuse);
+      shader.setVec3("dirLight.specular", light.specular);
+      break;
+    case SceneLightType::Point:
+      if (pointSet)
+        break;
+      pointSet = true;
+      shader.setVec3("pointLight.position", light.position);
+      shader.setFloat("pointLight.constant", light.constant);
+      shader.setFloat("pointLight.linear", light.linear);
+      shader.setFloat("pointLight.quadratic", light.quadratic);
+      shader.setVec3("pointLight.ambient", light.ambient);
+      shader.setVec3("pointLight.diffuse", light.diffuse);
+      shader.setVec3("pointLight.specular", light.specular);
+      break;
+    case SceneLightType::Spot:
+      if (spotSet)
+        break;
+      spotSet = true;
+      shader.setVec3("spotLight.position", light.position);
+      shader.setVec3("spotLight.direction", light.direction);
+      shader.setFloat("spotLight.innerCutoff",
+                      std::cos(glm::radians(light.innerCutoffDegrees)));
+      shader.setFloat("spotLight.outerCutoff",
+                      std::cos(glm::radians(light.outerCutoffDegrees)));
+      shader.setVec3("spotLight.ambient", light.ambient);
+      shader.setVec3("spotLight.diffuse", light.diffuse);
+      shader.setVec3("spotLight.specular", light.specular);
+      shader.setFloat("spotLight.constant", light.constant);
+      shader.setFloat("spotLight.linear", light.linear);
+      shader.setFloat("spotLight.quadratic", light.quadratic);
+      break;
+    }
+  }
+}
@@ -9,15 +9,21 @@ Shader::Shader() : usable(false) {}
 Shader::~Shader() { glDeleteProgram(ID); }
 
 void Shader::init(const char *sourcePath) {
-  std::string vertexShaderSource =
-      parseShaderSource(sourcePath, Shader_Type::Vertex);
-  std::string fragmentShaderSource =
-      parseShaderSource(sourcePath, Shader_Type::Fragment);
+  loadSource(sourcePath);
+  compile();
+}
+
+void Shader::loadSource(const char *sourcePath) {
+  vertexSource = parseShaderSource(sourcePath, Shader_Type::Vertex);
+  fragmentSource = parseShaderSource(sourcePath, Shader_Type::Fragment);
+}
 
-  GLuint vertexShader =
-      compileShader(GL_VERTEX_SHADER, vertexShaderSource.c_str());
+void Shader::compile() {
+  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource.c_str());
   GLuint fragmentShader =
-      compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource.c_str());
+      compileShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+  vertexSource.clear();
+  fragmentSource.clear();
 
   if (vertexShader == 0 || fragmentShader == 0) {
     Logger::shader->error("Failed to create shader.");
@@ -127,6 +133,8 @@ int Shader::getUniformLocation(const std::string &name) {
   return location;
 }
 
+bool Shader::isUsable() const { return usable; }
+
 void Shader::bind() const {
   if (usable)
     glUseProgram(ID);
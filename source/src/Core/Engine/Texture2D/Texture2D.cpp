@@ -4,40 +4,46 @@
 #include "stb_image.h"
 
 Texture2D::Texture2D()
-    : rendererID(0), type(TextureType::Texture2D), localBuffer(nullptr),
-      width(0), height(0), bpp(0) {}
+    : rendererID(0), type(TextureType::Texture2D), width(0), height(0),
+      bpp(0) {}
 
 Texture2D::Texture2D(const std::string &path) : Texture2D() { load2D(path); }
 
-Texture2D::~Texture2D() { glDeleteTextures(1, &rendererID); }
+// Shared textures are deleted by the registry once nobody holds them
+Texture2D::~Texture2D() {
+  if (type == TextureType::Cubemap)
+    glDeleteTextures(1, &rendererID);
+}
 
 bool Texture2D::load2D(const std::string &path) {
-  type = TextureType::Texture2D;
+  return decode2D(path) && upload2D();
+}
 
-  stbi_set_flip_vertically_on_load(true);
+bool Texture2D::decode2D(const std::string &path) {
+  type = TextureType::Texture2D;
 
-  glGenTextures(1, &rendererID);
-  glBindTexture(GL_TEXTURE_2D, rendererID);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-  localBuffer = stbi_load(path.c_str(), &width, &height, &bpp, 4);
-  if (localBuffer) {
-    Logger::texture2D->info("Successfully loaded 2D texture: {}", path);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, localBuffer);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(localBuffer);
-  } else {
+  TextureRegistry *registry = TextureRegistry::getInstance();
+  shared = registry->acquire(path);
+  registry->decode(*shared);
+  width = shared->getWidth();
+  height = shared->getHeight();
+  bpp = shared->getComponents();
+  if (shared->hasFailed()) {
     Logger::texture2D->warn("Failed to load 2D texture: {}", path);
     return false;
   }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  Logger::texture2D->info("Successfully loaded 2D texture: {}", path);
+  return true;
+}
+
+// A texture another user already uploaded costs nothing here
+bool Texture2D::upload2D() {
+  if (!shared || shared->hasFailed())
+    return false;
+
+  TextureRegistry::getInstance()->upload(*shared);
+  rendererID = shared->getId();
   return true;
 }
 
@@ -47,7 +53,7 @@ bool Texture2D::loadCubemap(const std::vector<std::string> &faces) {
   glGenTextures(1, &rendererID);
   glBindTexture(GL_TEXTURE_CUBE_MAP, rendererID);
 
-  stbi_set_flip_vertically_on_load(false); // cubemaps should not flip
+  stbi_set_flip_vertically_on_load_thread(false); // cubemaps should not flip
 
   for (unsigned int i = 0; i < faces.size(); i++) {
     unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &bpp, 4);
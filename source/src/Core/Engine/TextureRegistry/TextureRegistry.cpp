@@ -0,0 +1,260 @@
+#include "TextureRegistry.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "glad/glad.h"
+#include "stb_image.h"
+#include <fstream>
+#include <iterator>
+
+static uint64_t hashBytes(const std::vector<unsigned char> &bytes);
+static size_t getGpuBytes(const SharedTexture &texture);
+
+SharedTexture::SharedTexture()
+    : contentHash(0), encodedSize(0), headerWidth(0), headerHeight(0),
+      headerComponents(0), width(0), height(0), components(0), failed(false),
+      id(0) {}
+
+const std::string &SharedTexture::getPath() const { return path; }
+
+uint64_t SharedTexture::getContentHash() const { return contentHash; }
+
+unsigned int SharedTexture::getId() const { return id; }
+
+int SharedTexture::getWidth() const { return width; }
+
+int SharedTexture::getHeight() const { return height; }
+
+int SharedTexture::getComponents() const { return components; }
+
+bool SharedTexture::hasFailed() const { return failed; }
+
+TextureRegistry::TextureRegistry() : textureCount(0), memoryBytes(0) {}
+
+TextureRegistry *TextureRegistry::getInstance() {
+  static TextureRegistry instance;
+  return &instance;
+}
+
+TextureRef TextureRegistry::acquire(const std::string &path) {
+  if (TextureRef texture = find(path))
+    return texture;
+
+  PROFILE_FUNCTION();
+
+  // Read outside the lock; a texture that appeared meanwhile wins in
+  // insert()
+  std::vector<unsigned char> encoded;
+  std::ifstream file(path, std::ios::binary);
+  if (file)
+    encoded.assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  else
+    Logger::textureRegistry->warn("Failed to read texture: {}", path);
+  return insert(path, std::move(encoded));
+}
+
+TextureRef TextureRegistry::acquire(const std::string &key,
+                                    const unsigned char *data, size_t size) {
+  if (TextureRef texture = find(key))
+    return texture;
+  return insert(key, std::vector<unsigned char>(data, data + size));
+}
+
+void TextureRegistry::decode(SharedTexture &texture) {
+  std::call_once(texture.decoded, [&texture] {
+    PROFILE_SCOPE("TextureRegistry::decode");
+
+    // Per thread, so decoding on a worker never races a cubemap load
+    stbi_set_flip_vertically_on_load_thread(true);
+    unsigned char *pixels = nullptr;
+    if (!texture.encoded.empty())
+      pixels = stbi_load_from_memory(
+          texture.encoded.data(), static_cast<int>(texture.encoded.size()),
+          &texture.width, &texture.height, &texture.components, 0);
+    texture.pixels.reset(pixels, stbi_image_free);
+    texture.failed = !pixels;
+    std::vector<unsigned char>().swap(texture.encoded);
+
+    if (texture.failed) {
+      texture.width = texture.height = texture.components = 0;
+      Logger::textureRegistry->error("Failed to decode texture: {}",
+                                     texture.path);
+    }
+  });
+}
+
+size_t TextureRegistry::upload(SharedTexture &texture) {
+  decode(texture);
+
+  size_t bytes = 0;
+  std::call_once(texture.uploaded, [&texture, &bytes] {
+    glGenTextures(1, &texture.id);
+    if (texture.failed)
+      return;
+
+    GLenum format = (texture.components == 1)   ? GL_RED
+                    : (texture.components == 2) ? GL_RG
+                    : (texture.components == 3) ? GL_RGB
+                                                : GL_RGBA;
+    GLint internalFormat = (texture.components == 1)   ? GL_R8
+                           : (texture.components == 2) ? GL_RG8
+                           : (texture.components == 3) ? GL_RGB8
+                                                       : GL_RGBA8;
+
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    // Rows of one and three component images are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture.width,
+                 texture.height, 0, format, GL_UNSIGNED_BYTE,
+                 texture.pixels.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Grey and grey-alpha images sample like the RGBA expansion they had
+    // before native channel counts, not as red only
+    if (texture.components == 1) {
+      const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    } else if (texture.components == 2) {
+      const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    bytes = static_cast<size_t>(texture.width) * texture.height *
+            texture.components;
+    texture.pixels.reset();
+  });
+
+  if (bytes)
+    memoryBytes += getGpuBytes(texture);
+  return bytes;
+}
+
+void TextureRegistry::deleteReleased() {
+  std::vector<unsigned int> ids;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.swap(releasedIds);
+  }
+  if (!ids.empty())
+    glDeleteTextures(static_cast<GLsizei>(ids.size()), ids.data());
+}
+
+size_t TextureRegistry::getTextureCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return textureCount;
+}
+
+size_t TextureRegistry::getMemoryBytes() const { return memoryBytes; }
+
+TextureRef TextureRegistry::find(const std::string &path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = paths.find(path);
+  if (found == paths.end())
+    return nullptr;
+
+  TextureRef texture = found->second.lock();
+  // Released under another path this one was an alias of
+  if (!texture)
+    paths.erase(found);
+  return texture;
+}
+
+TextureRef TextureRegistry::insert(const std::string &path,
+                                   std::vector<unsigned char> encoded) {
+  uint64_t contentHash = hashBytes(encoded);
+  // Header only, cheap next to decoding
+  int headerWidth = 0;
+  int headerHeight = 0;
+  int headerComponents = 0;
+  if (!encoded.empty())
+    stbi_info_from_memory(encoded.data(), static_cast<int>(encoded.size()),
+                          &headerWidth, &headerHeight, &headerComponents);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = paths.find(path);
+  if (found != paths.end()) {
+    if (TextureRef texture = found->second.lock())
+      return texture;
+  }
+
+  // Unreadable files all hash alike, they are only shared by path
+  if (!encoded.empty()) {
+    auto same = hashes.find(contentHash);
+    if (same != hashes.end()) {
+      TextureRef texture = same->second.lock();
+      // A hash match alone could bind the wrong image to a material
+      if (texture && texture->encodedSize == encoded.size() &&
+          texture->headerWidth == headerWidth &&
+          texture->headerHeight == headerHeight &&
+          texture->headerComponents == headerComponents) {
+        Logger::textureRegistry->info("Sharing texture {} with {}", path,
+                                      texture->path);
+        paths[path] = texture;
+        return texture;
+      }
+      if (texture)
+        Logger::textureRegistry->warn("Texture {} collides with the hash of "
+                                      "{}, not sharing it",
+                                      path, texture->path);
+    }
+  }
+
+  TextureRef texture(new SharedTexture(),
+                     [this](SharedTexture *released) { release(released); });
+  texture->path = path;
+  texture->contentHash = contentHash;
+  texture->encodedSize = encoded.size();
+  texture->headerWidth = headerWidth;
+  texture->headerHeight = headerHeight;
+  texture->headerComponents = headerComponents;
+  texture->encoded = std::move(encoded);
+  paths[path] = texture;
+  if (!texture->encoded.empty())
+    hashes[contentHash] = texture;
+  textureCount++;
+  return texture;
+}
+
+// Runs on whichever thread drops the last handle, so the GL texture waits
+// for deleteReleased()
+void TextureRegistry::release(SharedTexture *texture) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto path = paths.find(texture->path);
+    if (path != paths.end() && path->second.expired())
+      paths.erase(path);
+    auto hash = hashes.find(texture->contentHash);
+    if (hash != hashes.end() && hash->second.expired())
+      hashes.erase(hash);
+    if (texture->id)
+      releasedIds.push_back(texture->id);
+    textureCount--;
+  }
+  if (texture->id)
+    memoryBytes -= getGpuBytes(*texture);
+  delete texture;
+}
+
+// FNV-1a, like the mesh cache's source hash
+static uint64_t hashBytes(const std::vector<unsigned char> &bytes) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char byte : bytes) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// The base level plus a third for the mipmaps
+static size_t getGpuBytes(const SharedTexture &texture) {
+  return static_cast<size_t>(texture.getWidth()) * texture.getHeight() *
+         texture.getComponents() * 4 / 3;
+}
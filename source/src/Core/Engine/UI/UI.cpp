@@ -1,12 +1,21 @@
 #include "UI.h"
+#include "FrameArena.h"
+#include "GpuHeap.h"
+#include "GpuProfiler.h"
 #include "Logger.h"
+#include "Model.h"
+#include "Profiler.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "backends/imgui_impl_sdl2.h"
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "nfd.h"
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
 #include <glad/glad.h>
+#include <vector>
 
 const static constexpr char *OPENGL_VERSION = "#version 410";
 
@@ -14,7 +23,7 @@ bool UI::willResetLayout = true;
 const char *UI::rootDockSpace = "RootDockSpace";
 UIVisibility UI::uiVisibility;
 
-UI::UI() {}
+UI::UI() : headless(false) {}
 
 UI *UI::getInstance() {
   static UI instance;
@@ -70,6 +79,29 @@ bool UI::init(SDL_Window *window, SDL_GLContext glContext) const {
   return initSuccess;
 }
 
+bool UI::initHeadless(const int &width, const int &height) {
+  Logger::ui->info("Initializing headless ImGui ({}x{})...", width, height);
+
+  IMGUI_CHECKVERSION();
+  ImGui::CreateContext();
+  ImGuiIO &io = ImGui::GetIO();
+  io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+  io.DisplaySize =
+      ImVec2(static_cast<float>(width), static_cast<float>(height));
+  io.IniFilename = nullptr;
+
+  ImGui::StyleColorsDark();
+
+  if (!ImGui_ImplOpenGL3_Init(OPENGL_VERSION)) {
+    Logger::ui->error("Failed to initialize ImGui OpenGL3 backend.");
+    return false;
+  }
+
+  headless = true;
+  Logger::ui->info("Successfully initialized headless ImGui.");
+  return true;
+}
+
 void UI::createRootDockSpace() {
   // Get the ImGui IO object and assert that docking is enabled
   ImGuiIO &io = ImGui::GetIO();
@@ -211,6 +243,7 @@ void UI::resetLayout() {
   ImGui::DockBuilderDockWindow("Right Panel", dock_right_id);
   ImGui::DockBuilderDockWindow("Right Panel 2", dock_right_id);
   ImGui::DockBuilderDockWindow("Log", dock_bottom_id);
+  ImGui::DockBuilderDockWindow("Profiler", dock_bottom_id);
 
   ImGui::DockBuilderFinish(dockspace_id);
 }
@@ -224,24 +257,47 @@ void UI::resetBitFieldsValues() {
   uiVisibility.right_panel = 1;
   uiVisibility.right_panel_2 = 1;
   uiVisibility.bottom_panel = 1;
+  uiVisibility.profiler = 1;
 }
 
 void UI::render() {
+  buildFrame();
+  submitFrame();
+}
+
+void UI::buildFrame() {
+  PROFILE_FUNCTION();
+
   ImGui_ImplOpenGL3_NewFrame();
-  ImGui_ImplSDL2_NewFrame();
+  if (headless)
+    ImGui::GetIO().DeltaTime = 1.0f / 60.0f;
+  else
+    ImGui_ImplSDL2_NewFrame();
   ImGui::NewFrame();
   createRootDockSpace();
   createMainMenuBar();
 
-  ImGuiIO &io = ImGui::GetIO();
-
   // ImGui::ShowDemoWindow();
   renderImGuiWindows();
 
   ImGui::Render();
-  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+void UI::submitFrame() {
+  PROFILE_FUNCTION();
+
+  ImGuiIO &io = ImGui::GetIO();
+
+  {
+    GPU_PROFILE_SCOPE("ImGui");
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  }
 
   if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+    // Platform windows draw with their own shared contexts; the timestamps
+    // are taken on the main context around them, which on a single GPU
+    // queue brackets their work
+    GPU_PROFILE_SCOPE("Platform Windows");
     SDL_Window *backup_current_window = SDL_GL_GetCurrentWindow();
     SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
     ImGui::UpdatePlatformWindows();
@@ -250,6 +306,30 @@ void UI::render() {
   }
 }
 
+void UI::prepareForRenderThread() {
+  Logger::ui->info("Preparing ImGui for the render thread...");
+
+  // Device objects are normally created lazily by the first NewFrame, which
+  // needs a current GL context; create them while the main thread still has
+  // one
+  ImGui_ImplOpenGL3_CreateDeviceObjects();
+
+  // Platform windows create SDL windows and GL contexts of their own, which
+  // must stay on the main thread
+  ImGuiIO &io = ImGui::GetIO();
+  if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+    Logger::ui->warn("Multi-viewport disabled while rendering on a separate "
+                     "thread.");
+    io.ConfigFlags &= ~ImGuiConfigFlags_ViewportsEnable;
+  }
+
+  Logger::ui->info("Successfully prepared ImGui for the render thread.");
+}
+
+void UI::setDrawStatsSource(std::function<DrawStats()> source) {
+  drawStatsSource = std::move(source);
+}
+
 void UI::renderImGuiWindows() {
   // TODO: Separate and bundle window names instead of hardcoding each
 
@@ -314,13 +394,291 @@ void UI::renderImGuiWindows() {
       ImGui::End();
       uiVisibility.bottom_panel = open;
     }
+
+    if (uiVisibility.profiler) {
+      open = uiVisibility.profiler;
+      ImGui::Begin("Profiler", &open);
+      renderProfilerWindow();
+      ImGui::End();
+      uiVisibility.profiler = open;
+    }
+  }
+}
+
+static ImU32 getZoneColor(const char *name) {
+  // FNV-1a, so a zone keeps its colour across frames and runs
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c; c++)
+    hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+  return ImColor::HSV((hash % 360) / 360.0f, 0.45f, 0.75f);
+}
+
+void UI::renderProfilerWindow() {
+  // Allocator and draw stats do not need zones, they show in every build
+  renderMemoryStats();
+  renderDrawStats();
+
+#ifndef SHADER_ENGINE_PROFILING
+  ImGui::TextDisabled("Built without SHADER_ENGINE_PROFILING, no zones are "
+                      "recorded.");
+#else
+
+  Profiler *profiler = Profiler::getInstance();
+
+  static int selectedFrame = 0; // frames ago
+  static int statsFrameCount = 60;
+
+  bool paused = profiler->isPaused();
+  if (ImGui::Checkbox("Pause", &paused))
+    profiler->setPaused(paused);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(150.0f);
+  ImGui::SliderInt("Stats frames", &statsFrameCount, 1,
+                   Profiler::FRAME_HISTORY);
+  ImGui::SameLine();
+  ImGui::TextDisabled("Dropped zones: %llu",
+                      static_cast<unsigned long long>(
+                          profiler->getDroppedZoneCount()));
+
+  GpuProfiler *gpuProfiler = GpuProfiler::getInstance();
+
+  int frameCount = profiler->getFrameCount();
+  if (frameCount == 0) {
+    ImGui::TextUnformatted("No frames recorded yet.");
+    return;
+  }
+
+  { // Frame history, oldest on the left, click a bar to inspect that frame
+    float frameTimes[Profiler::FRAME_HISTORY];
+    for (int i = 0; i < frameCount; i++) {
+      const ProfileFrame *frame = profiler->getFrame(frameCount - 1 - i);
+      frameTimes[i] = (frame->endNs - frame->startNs) / 1.0e6f;
+    }
+    ImGui::PlotHistogram("##FrameTimes", frameTimes, frameCount, 0,
+                         "Frame time (ms)", 0.0f, FLT_MAX,
+                         ImVec2(-1.0f, 60.0f));
+
+    if (ImGui::IsItemHovered() &&
+        ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+      float t = (ImGui::GetIO().MousePos.x - ImGui::GetItemRectMin().x) /
+                ImGui::GetItemRectSize().x;
+      int clicked = static_cast<int>(t * frameCount);
+      selectedFrame = frameCount - 1 - std::clamp(clicked, 0, frameCount - 1);
+      profiler->setPaused(true);
+    }
+    // Live view trails a few frames so the GPU results are already in
+    if (!profiler->isPaused())
+      selectedFrame = gpuProfiler->isAvailable()
+                          ? GpuProfiler::FRAME_LATENCY + 1
+                          : 0;
+    selectedFrame = std::min(selectedFrame, frameCount - 1);
+  }
+
+  const ProfileFrame *frame = profiler->getFrame(selectedFrame);
+  double frameNs = static_cast<double>(frame->endNs - frame->startNs);
+  ImGui::Text("Frame %llu: %.3f ms",
+              static_cast<unsigned long long>(frame->index), frameNs / 1.0e6);
+
+  if (gpuProfiler->isAvailable()) {
+    GpuFrameTiming gpuFrame = gpuProfiler->getLatestFrame();
+    ImGui::SameLine();
+    ImGui::Text("| GPU %.3f ms", gpuFrame.totalMs);
+    // A GPU busy for most of the frame is what holds the frame back
+    ImGui::SameLine();
+    if (gpuFrame.totalMs > 0.9 * frameNs / 1.0e6)
+      ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.3f, 1.0f), "GPU-bound");
+    else
+      ImGui::TextColored(ImVec4(0.4f, 0.8f, 1.0f, 1.0f), "CPU-bound");
+    ImGui::SameLine();
+    ImGui::TextDisabled("(GPU frames skipped: %llu)",
+                        static_cast<unsigned long long>(
+                            gpuProfiler->getSkippedFrameCount()));
+  }
+
+  { // Flame graph, one lane per thread, nested zones stacked downwards
+    // The last lane holds the GPU passes
+    int laneCount = profiler->getThreadCount() + 1;
+    auto getLaneThread = [laneCount](int lane) {
+      return lane == laneCount - 1 ? Profiler::GPU_THREAD_INDEX
+                                   : static_cast<uint32_t>(lane);
+    };
+    auto getLane = [laneCount](uint32_t threadIndex) {
+      return threadIndex == Profiler::GPU_THREAD_INDEX
+                 ? laneCount - 1
+                 : static_cast<int>(threadIndex);
+    };
+
+    FrameVector<uint32_t> laneDepths(laneCount, 0);
+    for (const ProfileZone &zone : frame->zones) {
+      int lane = getLane(zone.threadIndex);
+      laneDepths[lane] = std::max(laneDepths[lane], zone.depth + 1);
+    }
+
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+    const float labelWidth = 90.0f;
+
+    ImGui::BeginChild("FlameGraph", ImVec2(0.0f, 160.0f),
+                      ImGuiChildFlags_Borders | ImGuiChildFlags_ResizeY);
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float graphWidth =
+        std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+
+    float laneTop = origin.y;
+    for (int lane = 0; lane < laneCount; lane++) {
+      if (laneDepths[lane] == 0)
+        continue;
+
+      uint32_t thread = getLaneThread(lane);
+      const char *threadName = profiler->getThreadName(thread);
+      char fallbackName[32];
+      if (!threadName) {
+        std::snprintf(fallbackName, sizeof(fallbackName), "Thread %u", thread);
+        threadName = fallbackName;
+      }
+      drawList->AddText(ImVec2(origin.x, laneTop + 2.0f), textColor,
+                        threadName);
+
+      for (const ProfileZone &zone : frame->zones) {
+        if (zone.threadIndex != thread)
+          continue;
+
+        // Zones that began in an earlier frame are clipped to this one
+        uint64_t start = std::max(zone.startNs, frame->startNs);
+        uint64_t end = std::min(zone.endNs, frame->endNs);
+        float x0 = origin.x + labelWidth +
+                   static_cast<float>((start - frame->startNs) / frameNs) *
+                       graphWidth;
+        float x1 = origin.x + labelWidth +
+                   static_cast<float>((end - frame->startNs) / frameNs) *
+                       graphWidth;
+        x1 = std::max(x1, x0 + 1.0f);
+        float y0 = laneTop + zone.depth * rowHeight;
+        ImVec2 min(x0, y0);
+        ImVec2 max(x1, y0 + rowHeight - 1.0f);
+
+        drawList->AddRectFilled(min, max, getZoneColor(zone.name));
+        if (x1 - x0 > 20.0f) {
+          drawList->PushClipRect(min, max, true);
+          drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_BLACK,
+                            zone.name);
+          drawList->PopClipRect();
+        }
+
+        if (ImGui::IsWindowHovered() && mouse.x >= min.x &&
+            mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+          ImGui::SetTooltip("%s\n%.3f ms", zone.name,
+                            (zone.endNs - zone.startNs) / 1.0e6);
+      }
+
+      laneTop += laneDepths[lane] * rowHeight + 4.0f;
+    }
+
+    ImGui::Dummy(ImVec2(labelWidth + graphWidth, laneTop - origin.y));
+    ImGui::EndChild();
+  }
+
+  { // Per-zone statistics over the last frames
+    int statsFrames = std::min(statsFrameCount, frameCount);
+    std::vector<ProfileZoneStats> stats =
+        profiler->computeStats(statsFrames);
+
+    ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders |
+                            ImGuiTableFlags_Resizable |
+                            ImGuiTableFlags_ScrollY;
+    if (ImGui::BeginTable("ZoneStats", 6, flags)) {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("Zone");
+      ImGui::TableSetupColumn("Calls/frame");
+      ImGui::TableSetupColumn("ms/frame");
+      ImGui::TableSetupColumn("Avg ms");
+      ImGui::TableSetupColumn("Min ms");
+      ImGui::TableSetupColumn("Max ms");
+      ImGui::TableHeadersRow();
+
+      for (const ProfileZoneStats &zone : stats) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (zone.gpu)
+          ImGui::Text("%s [GPU]", zone.name);
+        else
+          ImGui::TextUnformatted(zone.name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", static_cast<float>(zone.calls) / statsFrames);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", zone.totalMs / statsFrames);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", zone.averageMs);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", zone.minMs);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", zone.maxMs);
+      }
+      ImGui::EndTable();
+    }
+  }
+#endif
+}
+
+void UI::renderMemoryStats() {
+  FrameArenaStats arena = FrameArena::getInstance()->getStats();
+  ImGui::Text("Frame arena: %.1f KB last frame, %.1f KB peak of %.1f KB",
+              arena.lastFrameBytes / 1024.0, arena.highWaterBytes / 1024.0,
+              arena.capacity / 1024.0);
+  if (arena.overflowAllocations > 0) {
+    ImGui::SameLine();
+    ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.3f, 1.0f),
+                       "(%llu heap fallbacks, %.1f KB last frame)",
+                       static_cast<unsigned long long>(
+                           arena.overflowAllocations),
+                       arena.lastFrameOverflowBytes / 1024.0);
+  }
+
+  GpuHeapStats heap = GpuHeap::getInstance()->getStats();
+  ImGui::Text("GPU heap: %.2f MB used of %.2f MB in %zu blocks, %zu "
+              "allocations",
+              heap.usedBytes / (1024.0 * 1024.0),
+              heap.reservedBytes / (1024.0 * 1024.0), heap.blockCount,
+              heap.allocationCount);
+  ImGui::SameLine();
+  ImGui::TextDisabled("(%zu free ranges, largest %.2f MB, %.2f MB "
+                      "compacted)",
+                      heap.freeRangeCount,
+                      heap.largestFreeBytes / (1024.0 * 1024.0),
+                      heap.movedBytes / (1024.0 * 1024.0));
+}
+
+// With a render thread these trail the UI by the frames in flight
+void UI::renderDrawStats() {
+  if (!drawStatsSource)
+    return;
+
+  DrawStats stats = drawStatsSource();
+  ImGui::Text("Meshes: %zu drawn, %zu in batches with %zu materials",
+              stats.meshes, stats.batchedMeshes, stats.batchMaterials);
+
+  ImGui::Text("LODs:");
+  for (size_t lod = 0; lod < MeshOptimizer::MAX_LODS; lod++) {
+    ImGui::SameLine();
+    ImGui::Text("%zu: %zu", lod, stats.lodMeshes[lod]);
+  }
+
+  if (stats.meshlets > 0) {
+    ImGui::Text("Meshlets: %zu of %zu visible (%.1f%%)",
+                stats.visibleMeshlets, stats.meshlets,
+                100.0 * stats.visibleMeshlets / stats.meshlets);
+  } else {
+    ImGui::TextDisabled("Meshlets: no full-detail meshes culled");
   }
 }
 
 void UI::free() {
   Logger::ui->info("Destroying ImGUI resources...");
   ImGui_ImplOpenGL3_Shutdown();
-  ImGui_ImplSDL2_Shutdown();
+  if (!headless)
+    ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
   Logger::ui->info("Successfully destroyed ImGUI resources.");
 }
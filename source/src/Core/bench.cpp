@@ -0,0 +1,327 @@
+#define SDL_MAIN_HANDLED
+#include "CommandLine.h"
+#include "Engine.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+// windows.h must come first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static constexpr int TOP_ZONE_COUNT = 16;
+
+struct BenchOptions {
+  int frames = 600;
+  int warmupFrames = 60;
+  std::string outputPath;
+};
+
+struct SampleStats {
+  size_t count;
+  double mean;
+  double min;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+};
+
+// stdout may carry the JSON report, so help and errors go to stderr
+static void printUsage(const char *program) {
+  std::fprintf(
+      stderr,
+      "Usage: %s --scene <file> [options]\n"
+      "  --frames <n>                Measured frames (default 600)\n"
+      "  --warmup <n>                Frames run before measuring (default "
+      "60)\n"
+      "  --output <file>             Write the JSON report here instead of\n"
+      "                              stdout\n"
+      "Engine options, the benchmark defaults to uncapped pacing, --dt 1/60\n"
+      "and deterministic physics:\n",
+      program);
+  printEngineUsage(stderr);
+  std::fprintf(stderr, "  --help                      Show this message\n");
+}
+
+static bool parseArguments(int argc, char *argv[], EngineConfig &config,
+                           BenchOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string argument(argv[i]);
+
+    if (argument == "--frames" && i + 1 < argc) {
+      options.frames = std::atoi(argv[++i]);
+    } else if (argument == "--warmup" && i + 1 < argc) {
+      options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+    } else if (argument == "--output" && i + 1 < argc) {
+      options.outputPath = argv[++i];
+    } else if (argument == "--help") {
+      printUsage(argv[0]);
+      return false;
+    } else {
+      ArgumentResult result = parseEngineArgument(argc, argv, i, config);
+      if (result == ArgumentResult::Invalid)
+        return false;
+      if (result == ArgumentResult::Unknown) {
+        Logger::engine->error("Unknown argument '{}'.", argument);
+        printUsage(argv[0]);
+        return false;
+      }
+    }
+  }
+
+  if (config.scenePath.empty()) {
+    Logger::engine->error("No scene given.");
+    printUsage(argv[0]);
+    return false;
+  }
+  if (options.frames <= 0) {
+    Logger::engine->error("Frame count must be positive.");
+    return false;
+  }
+  return true;
+}
+
+static SampleStats computeStats(std::vector<double> samples) {
+  SampleStats stats{samples.size(), 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  if (samples.empty())
+    return stats;
+
+  std::sort(samples.begin(), samples.end());
+
+  // Nearest-rank percentile
+  auto percentile = [&samples](double p) {
+    size_t rank = static_cast<size_t>(p / 100.0 * samples.size() + 0.5);
+    return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+  };
+
+  double total = 0.0;
+  for (double sample : samples)
+    total += sample;
+
+  stats.mean = total / samples.size();
+  stats.min = samples.front();
+  stats.p50 = percentile(50.0);
+  stats.p95 = percentile(95.0);
+  stats.p99 = percentile(99.0);
+  stats.max = samples.back();
+  return stats;
+}
+
+static uint64_t getPeakMemoryBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  // Linux reports kilobytes
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static std::string escapeJson(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+static const char *getRunModeName(RunMode mode) {
+  switch (mode) {
+  case RunMode::Windowed:
+    return "windowed";
+  case RunMode::HeadlessSimulation:
+    return "sim";
+  case RunMode::HeadlessOffscreen:
+    return "offscreen";
+  }
+  return "unknown";
+}
+
+static void writeStats(FILE *file, const char *name,
+                       const SampleStats &stats) {
+  std::fprintf(file,
+               "  \"%s\": {\"samples\": %zu, \"mean\": %.4f, \"min\": %.4f, "
+               "\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+               "\"max\": %.4f},\n",
+               name, stats.count, stats.mean, stats.min, stats.p50, stats.p95,
+               stats.p99, stats.max);
+}
+
+static std::vector<double>
+selectSamples(const std::vector<FrameSample> &samples, size_t first,
+              double FrameSample::*member) {
+  std::vector<double> values;
+  for (size_t i = first; i < samples.size(); i++)
+    values.push_back(samples[i].*member);
+  return values;
+}
+
+int main(int argc, char *argv[]) {
+  // stdout may carry the JSON report
+  Logger::init(true);
+
+  EngineConfig config;
+  config.pacingMode = FramePacingMode::Uncapped;
+  config.fixedDeltaTime = 1.0f / 60.0f;
+  // Physics work per frame must not depend on how fast frames run
+  config.physicsStep.deterministic = true;
+  config.collectFrameStats = true;
+
+  BenchOptions options;
+  if (!parseArguments(argc, argv, config, options))
+    return 1;
+  config.maxFrames = options.warmupFrames + options.frames;
+  config.statsWarmupFrames = options.warmupFrames;
+
+  Engine *engine = Engine::getInstance();
+  engine->run(config);
+
+  const std::vector<FrameSample> &samples = engine->getFrameSamples();
+  if (samples.size() < static_cast<size_t>(config.maxFrames)) {
+    Logger::engine->error("Benchmark stopped after {} of {} frames.",
+                          samples.size(), config.maxFrames);
+    return 1;
+  }
+
+  size_t warmup = static_cast<size_t>(options.warmupFrames);
+  SampleStats frameStats =
+      computeStats(selectSamples(samples, warmup, &FrameSample::frameMs));
+  SampleStats cpuStats =
+      computeStats(selectSamples(samples, warmup, &FrameSample::cpuMs));
+  SampleStats updateStats =
+      computeStats(selectSamples(samples, warmup, &FrameSample::updateMs));
+  SampleStats renderStats =
+      computeStats(selectSamples(samples, warmup, &FrameSample::renderMs));
+
+  // GPU results arrive a few frames late, so warm-up is trimmed by count
+  const std::vector<double> &gpuSamples = engine->getGpuFrameSamples();
+  SampleStats gpuStats = computeStats(std::vector<double>(
+      gpuSamples.begin() + std::min(warmup, gpuSamples.size()),
+      gpuSamples.end()));
+
+  double totalMs = 0.0;
+  for (size_t i = warmup; i < samples.size(); i++)
+    totalMs += samples[i].frameMs;
+
+  std::vector<ProfileZoneStats> zones = Profiler::getInstance()->getTotals();
+  if (zones.size() > TOP_ZONE_COUNT)
+    zones.resize(TOP_ZONE_COUNT);
+
+  FILE *file = stdout;
+  if (!options.outputPath.empty()) {
+    file = std::fopen(options.outputPath.c_str(), "w");
+    if (!file) {
+      Logger::engine->error("Failed to open report file: {}",
+                            options.outputPath);
+      return 1;
+    }
+  }
+
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"scene\": \"%s\",\n",
+               escapeJson(config.scenePath).c_str());
+  std::fprintf(file, "  \"runMode\": \"%s\",\n",
+               getRunModeName(config.runMode));
+  std::fprintf(file, "  \"pipelined\": %s,\n",
+               config.pipelinedRendering ? "true" : "false");
+  std::fprintf(file, "  \"pacing\": \"%s\",\n",
+               FramePacer::getModeName(config.pacingMode));
+  std::fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", config.width,
+               config.height);
+  std::fprintf(file, "  \"fixedDeltaTime\": %.6f,\n", config.fixedDeltaTime);
+  std::fprintf(file, "  \"physicsTickRate\": %.3f,\n",
+               config.physicsStep.tickRate);
+  std::fprintf(file, "  \"physicsDeterministic\": %s,\n",
+               config.physicsStep.deterministic ? "true" : "false");
+  std::fprintf(file, "  \"replay\": \"%s\",\n",
+               escapeJson(config.replayInputPath).c_str());
+  std::fprintf(file, "  \"uploadBudgetMs\": %.3f,\n", config.uploadBudgetMs);
+  std::fprintf(file, "  \"vertexLayout\": \"%s\",\n",
+               Mesh::getLayoutName(config.vertexLayout));
+  std::fprintf(file, "  \"importProfile\": \"%s\",\n",
+               Model::getImportProfileName(config.importProfile));
+  std::fprintf(file, "  \"residency\": \"%s\",\n",
+               Model::getResidencyName(config.geometryResidency));
+  std::fprintf(file, "  \"mergedDraws\": %s,\n",
+               config.mergedDraws ? "true" : "false");
+  std::fprintf(file, "  \"clusterCulling\": %s,\n",
+               config.clusterCulling ? "true" : "false");
+  std::fprintf(file, "  \"backfaceCulling\": %s,\n",
+               config.backfaceCulling ? "true" : "false");
+  std::fprintf(file, "  \"lodPixelError\": %.3f,\n", config.lodPixelError);
+  std::fprintf(file, "  \"warmupFrames\": %d,\n  \"frames\": %d,\n",
+               options.warmupFrames, options.frames);
+  std::fprintf(file, "  \"timeToFirstFrameMs\": %.3f,\n",
+               engine->getTimeToFirstFrameMs());
+  std::fprintf(file, "  \"totalMs\": %.3f,\n", totalMs);
+  std::fprintf(file, "  \"averageFps\": %.2f,\n",
+               totalMs > 0.0 ? options.frames * 1000.0 / totalMs : 0.0);
+  std::fprintf(file, "  \"peakMemoryBytes\": %llu,\n",
+               static_cast<unsigned long long>(getPeakMemoryBytes()));
+  writeStats(file, "frameMs", frameStats);
+  writeStats(file, "cpuMs", cpuStats);
+  writeStats(file, "updateMs", updateStats);
+  writeStats(file, "renderMs", renderStats);
+  writeStats(file, "gpuMs", gpuStats);
+
+  const std::vector<TaskTiming> &startup = engine->getStartupTimings();
+  std::fprintf(file, "  \"startup\": [");
+  for (size_t i = 0; i < startup.size(); i++) {
+    std::fprintf(file,
+                 "%s\n    {\"name\": \"%s\", \"startMs\": %.3f, "
+                 "\"durationMs\": %.3f, \"mainThread\": %s}",
+                 i == 0 ? "" : ",", escapeJson(startup[i].name).c_str(),
+                 startup[i].startMs, startup[i].durationMs,
+                 startup[i].workerIndex < 0 ? "true" : "false");
+  }
+  std::fprintf(file, "%s],\n", startup.empty() ? "" : "\n  ");
+
+  // Zones of the measured frames, GPU zones of the last few may be missing
+  std::fprintf(file, "  \"zones\": [");
+  for (size_t i = 0; i < zones.size(); i++) {
+    const ProfileZoneStats &zone = zones[i];
+    std::fprintf(file,
+                 "%s\n    {\"name\": \"%s\", \"gpu\": %s, \"calls\": %d, "
+                 "\"averageMs\": %.4f, \"maxMs\": %.4f, \"totalMs\": %.4f}",
+                 i == 0 ? "" : ",", escapeJson(zone.name).c_str(),
+                 zone.gpu ? "true" : "false", zone.calls, zone.averageMs,
+                 zone.maxMs, zone.totalMs);
+  }
+  std::fprintf(file, "%s]\n}\n", zones.empty() ? "" : "\n  ");
+
+  if (file != stdout) {
+    std::fclose(file);
+    Logger::engine->info("Wrote benchmark report to {}.",
+                         options.outputPath);
+  }
+  return 0;
+}
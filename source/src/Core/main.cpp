@@ -1,9 +1,50 @@
 #define SDL_MAIN_HANDLED
+#include "CommandLine.h"
 #include "Engine.h"
 #include "Logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void printUsage(const char *program) {
+  std::printf("Usage: %s [options]\n"
+              "  --frames <n>                Quit after n frames\n",
+              program);
+  printEngineUsage(stdout);
+  std::printf("  --help                      Show this message\n");
+}
+
+static bool parseArguments(int argc, char *argv[], EngineConfig &config) {
+  for (int i = 1; i < argc; i++) {
+    std::string argument(argv[i]);
+
+    if (argument == "--frames" && i + 1 < argc) {
+      config.maxFrames = std::atoi(argv[++i]);
+    } else if (argument == "--help") {
+      printUsage(argv[0]);
+      return false;
+    } else {
+      ArgumentResult result = parseEngineArgument(argc, argv, i, config);
+      if (result == ArgumentResult::Invalid)
+        return false;
+      if (result == ArgumentResult::Unknown) {
+        Logger::engine->error("Unknown argument '{}'.", argument);
+        printUsage(argv[0]);
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
 int main(int argc, char *argv[]) {
   Logger::init();
-  Engine::getInstance()->run();
+
+  EngineConfig config;
+  if (!parseArguments(argc, argv, config))
+    return 1;
+
+  Engine::getInstance()->run(config);
   return 0;
 }